@@ -60,14 +60,15 @@ int main(int argc, char **argv) try
 
 	dom.AddBoxLength(1 ,Vec3_t ( 0.0 , -24.0*dx , 0.0 ), 20.0*dx + dx/10.0 , 48.0*dx + dx/10.0,  0 , dx/2.0 ,Rho, h, 1 , 0 , false, false );
 
+	// Water, all particles refer to the first material (Particle::MatID = 0)
+	SPH::MaterialProps Water(1);
+	Water.Cs		= Cs;
+	Water.PresEq	= 0;
+	Water.MuRef	= Mu;
+	dom.AddMaterial(Water);
+
 	for (size_t a=0; a<dom.Particles.Size(); a++)
 	{
-		dom.Particles[a]->Cs				= Cs;
-		dom.Particles[a]->PresEq		= 0;
-		dom.Particles[a]->Mu				= Mu;
-		dom.Particles[a]->MuRef			= Mu;
-		dom.Particles[a]->Material	= 1;
-
 		yb=dom.Particles[a]->x(1);
 		if (yb>=20.0*dx || yb<=-20.0*dx)
 		{
@@ -57,17 +57,17 @@ int main(int argc, char **argv) try
 
 	dom.AddBoxLength(1 ,Vec3_t ( 0.0 , -4.0*dx , 0.0 ), 20.0*dx + dx/10.0 , 48.0*dx + dx/10.0,  0 , dx/2.0 ,Rho, h, 1 , 0 , false, false );
 
+	// Water, all particles refer to the first material (Particle::MatID = 0)
+	SPH::MaterialProps Water(1);
+	Water.Cs		= Cs;
+	Water.PresEq	= 0;
+	Water.MuRef	= Mu;
+	Water.LES	= true; //Just used to activate ShearRate calculation
+	Water.CSmag	= 0.0;  //To deactive LES for the above purpose (No LES used for this simulation)
+	dom.AddMaterial(Water);
+
 	for (size_t a=0; a<dom.Particles.Size(); a++)
 	{
-		dom.Particles[a]->LES			= true; //Just used to activate ShearRate calculation
-		dom.Particles[a]->CSmag		= 0.0;  //To deactive LES for the above purpose (No LES used for this simulation)
-
-		dom.Particles[a]->Cs			= Cs;
-		dom.Particles[a]->PresEq	= 0;
-		dom.Particles[a]->Mu			= Mu;
-		dom.Particles[a]->MuRef		= Mu;
-		dom.Particles[a]->Material= 1;
-
 		yb=dom.Particles[a]->x(1);
 		if (yb>=40.0*dx)
 		{
@@ -55,17 +55,19 @@ int main(int argc, char **argv) try
 
 	dom.AddBoxLength(1 ,Vec3_t ( -3.0*dx , -3.0*dx , -3.0*dx ), 7.0*dx + TL + dx/10.0 , 3.0*dx + TH + dx/10.0,  6.0*dx + TW + dx/10.0 , dx/2.0 ,Rho, h, 1 , 0 , false, false );
 
+	// Water, all particles refer to the first material (Particle::MatID = 0)
+	SPH::MaterialProps Water(1);
+	Water.Cs		= Cs;
+	Water.PresEq	= 1;
+	Water.MuRef	= Mu;
+	dom.AddMaterial(Water);
+
   for (size_t a=0; a<dom.Particles.Size(); a++)
   {
     xb=dom.Particles[a]->x(0);
     yb=dom.Particles[a]->x(1);
     zb=dom.Particles[a]->x(2);
 
-    dom.Particles[a]->Cs      = Cs;
-		dom.Particles[a]->PresEq	= 1;
-		dom.Particles[a]->Mu			= Mu;
-		dom.Particles[a]->MuRef		= Mu;
-		dom.Particles[a]->Material= 1;
     dom.Particles[a]->Shepard = true;
 
 
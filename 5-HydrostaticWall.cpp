@@ -0,0 +1,100 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#include "Domain.h"
+
+// Still water in a tank: the pressure of the wall particles extrapolated from the fluid must follow the
+// hydrostatic profile rho*g*(H-y), whichever particle of a fluid-wall pair is the wall.
+// Returns 1 if the mean error of the wall pressure exceeds 5% of rho*g*H.
+
+double WallError (bool StaticBoundary)
+{
+  SPH::Domain		dom;
+
+  dom.Dimension   = 2;
+  dom.Nproc       = 1;
+  dom.Scheme			= 0;
+  dom.StaticBoundary	= StaticBoundary;
+	dom.Viscosity_Eq_Set(Morris);
+	dom.Kernel_Set(Qubic_Spline);
+	dom.Gradient_Approach_Set(Squared_density);
+
+  double xb,yb,dx,Cs,h,Rho,H,TL,t,g;
+
+  H   = 0.3;
+  TL  = 0.6;
+  g   = 9.81;
+  Rho = 1000.0;
+  dx  = H/15.0;
+  h   = dx*1.2;
+  Cs	= 10.0 * sqrt(g*H);
+  t   = (0.2*h/Cs);
+
+  dom.InitialDist 	= dx;
+  dom.Gravity	      = 0.0, -g ,0.0 ;
+
+	dom.AddBoxLength(1 ,Vec3_t ( -3.0*dx , -3.0*dx , 0.0 ), 6.0*dx + TL + dx/10.0 , 3.0*dx + H + dx/10.0,  0 , dx/2.0 ,Rho, h, 1 , 0 , false, false );
+
+	SPH::MaterialProps Water(1);
+	Water.Cs		= Cs;
+	Water.PresEq	= 1;
+	Water.MuRef	= 1.0e-3;
+	dom.AddMaterial(Water);
+
+  for (size_t a=0; a<dom.Particles.Size(); a++)
+  {
+    xb=dom.Particles[a]->x(0);
+    yb=dom.Particles[a]->x(1);
+    if (xb<0.0 || yb<0.0 || xb>TL)
+    {
+			dom.Particles[a]->ID			= 2;
+			dom.Particles[a]->IsFree	= false;
+    }
+    else
+    {
+      dom.Particles[a]->Density	  = Rho*pow((1+7.0*g*(H-yb)/(Cs*Cs)),(1.0/7.0));
+      dom.Particles[a]->Densityb	= dom.Particles[a]->Density;
+    }
+  }
+
+  dom.Solve(/*tf*/50*t,/*dt*/t,/*dtOut*/1.0,"test_hydrostatic",999);
+
+  // Bottom wall particles below the middle of the tank, away from the corners
+  double Err = 0.0;
+  size_t n = 0;
+  for (size_t a=0; a<dom.Particles.Size(); a++)
+  {
+    xb=dom.Particles[a]->x(0);
+    yb=dom.Particles[a]->x(1);
+    if (dom.Particles[a]->IsFree || yb>0.0 || xb<0.2*TL || xb>0.8*TL || dom.Particles[a]->SumKernel==0.0) continue;
+    Err += fabs(dom.Particles[a]->Pressure - Rho*g*(H-yb));
+    n++;
+  }
+  return Err/(n*Rho*g*H);
+}
+
+int main(int argc, char **argv) try
+{
+  double E1 = WallError(true);
+  double E2 = WallError(false);
+  std::cout << "\nMean error of the wall pressure / (rho*g*H): static list = " << E1 << ", per step list = " << E2 << std::endl;
+  return (E1<0.05 && E2<0.05) ? 0 : 1;
+}
+MECHSYS_CATCH
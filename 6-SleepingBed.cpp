@@ -0,0 +1,113 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#include "Domain.h"
+
+// A soil bed at rest goes to sleep and is hit by a falling soil particle, with the default neighbour search
+// (no Verlet skin). The bed particles around the impact must be woken by the moving particle.
+// Returns 1 if the bed never sleeps or is never woken.
+
+size_t		NBed		= 0;	// Bed particles are the first NBed particles
+size_t		MaxSleeping	= 0;	// Max No of sleeping bed particles
+size_t		Woken		= 0;	// No of bed particles woken up
+std::vector<bool>	WasSleeping;
+
+void CountWakeUps (SPH::Domain & dom)
+{
+  size_t Sleeping = 0;
+  for (size_t a=0; a<NBed; a++)
+  {
+    if (WasSleeping[a] && !dom.Particles[a]->Sleeping) Woken++;
+    WasSleeping[a] = dom.Particles[a]->Sleeping;
+    if (dom.Particles[a]->Sleeping) Sleeping++;
+  }
+  MaxSleeping = std::max(MaxSleeping, Sleeping);
+}
+
+int main(int argc, char **argv) try
+{
+  SPH::Domain		dom;
+
+  dom.Dimension   = 2;
+  dom.Nproc       = 1;
+  dom.Scheme			= 0;
+  dom.Gravity	      = 0.0, -9.81 ,0.0 ;
+
+  // Loose thresholds, so the bed sleeps during the first steps
+  dom.SleepSteps		= 10;
+  dom.SleepVelocity		= 0.05;
+  dom.SleepAcceleration	= 50.0;
+  dom.SleepStrainRate	= 100.0;
+  dom.GeneralAfter		= &CountWakeUps;
+
+  double H, L, dx, h, Cs, K, Nu, E, t;
+
+  H   = 0.05;
+  L   = 0.1;
+  dx  = 0.01;
+  h   = dx*1.2;
+  Cs  = 150.0;
+  K   = 0.7e6;
+  Nu  = 0.3;
+  E   = (3.0*(1.0-2.0*Nu))*K;
+  t   = (0.2*h/Cs);
+
+  dom.InitialDist	= dx;
+
+	dom.AddBoxLength(1 ,Vec3_t ( -3.0*dx , -3.0*dx , 0.0 ), L + 6.0*dx + dx/10.0 , H + 3.0*dx + dx/10.0,  0 , dx/2.0 ,2650.0, h, 1 , 0 , false, false );
+
+	SPH::MaterialProps Soil(3);
+	Soil.Cs		= Cs;
+	Soil.K		= K;
+	Soil.G		= E/(2.0*(1.0+Nu));
+	Soil.Alpha	= 0.1;
+	Soil.Beta	= 0.1;
+	Soil.Fail	= 3;
+	Soil.c		= 100.0;
+	Soil.phi	= 25.0/180.0*M_PI;
+	dom.AddMaterial(Soil);
+
+  for (size_t a=0; a<dom.Particles.Size(); a++)
+  {
+    SPH::Particle * P = dom.Particles[a];
+    if (P->x(1)<0.0 || P->x(0)<0.0 || P->x(0)>L)
+    {
+      P->ID		= 2;
+      P->IsFree	= false;
+      P->NoSlip	= true;
+    }
+  }
+
+  // The free bed particles are moved to the front, the impactor is added last above the middle of the bed
+  Array<SPH::Particle*> Old(dom.Particles);
+  size_t n = 0;
+  for (size_t a=0; a<Old.Size(); a++) if ( Old[a]->IsFree) dom.Particles[n++] = Old[a];
+  NBed = n;
+  for (size_t a=0; a<Old.Size(); a++) if (!Old[a]->IsFree) dom.Particles[n++] = Old[a];
+  dom.AddSingleParticle(1, Vec3_t(L/2.0, H + 3.0*dx, 0.0), 2650.0*dx*dx, 2650.0, h, false);
+  dom.Particles[dom.Particles.Size()-1]->v = 0.0, -1.0, 0.0;
+  WasSleeping.assign(NBed, false);
+
+  dom.Solve(/*tf*/0.02,/*dt*/t,/*dtOut*/1.0,"test_sleeping",999);
+
+  std::cout << "\nMax No of sleeping bed particles = " << MaxSleeping << " of " << NBed << ", No of woken bed particles = " << Woken << std::endl;
+  return (MaxSleeping>0 && Woken>0) ? 0 : 1;
+}
+MECHSYS_CATCH
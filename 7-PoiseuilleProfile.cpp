@@ -0,0 +1,112 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#include "Domain.h"
+
+// Start-up of the flow of 1-Poiseuille between two no-slip walls. The velocity of the fluid particles is compared with
+// the series solution of Morris et al. (1997) at the end of the run. The test is built twice by CMake, in double and
+// with USE_MIXED_PRECISION (7-PoiseuilleProfileMixed), so both precisions of the packed particle state are checked.
+// Returns 1 if the mean error of the velocity exceeds 5% of the analytic velocity at the centre of the channel.
+
+double	g	= 0.002;	// Body force along x
+
+void UserAcc(SPH::Domain & domi)
+{
+	#pragma omp parallel for schedule (static) num_threads(domi.Nproc)
+	for (size_t i=0; i<domi.Particles.Size(); i++)
+		if (domi.Particles[i]->IsFree)
+			domi.Particles[i]->a += Vec3_t(g,0.0,0.0);
+}
+
+// Series solution of the start-up flow in a channel of width L, y from the lower wall
+double Analytic (double y, double t, double L, double Nu)
+{
+	double u = g/(2.0*Nu)*y*(L-y);
+	for (size_t n=0; n<50; n++)
+	{
+		double m = 2.0*n+1.0;
+		u -= 4.0*g*L*L/(Nu*M_PI*M_PI*M_PI*m*m*m)*sin(M_PI*y*m/L)*exp(-m*m*M_PI*M_PI*Nu*t/(L*L));
+	}
+	return u;
+}
+
+int main(int argc, char **argv) try
+{
+	SPH::Domain				dom;
+
+	dom.Dimension			= 2;
+	dom.BC.Periodic[0]= true;
+	dom.Nproc					= 1;
+	dom.Scheme				= 0;
+	dom.Kernel_Set(Quintic_Spline);
+	dom.Viscosity_Eq_Set(Takeda);
+	dom.Gradient_Approach_Set(Squared_density);
+
+	double yb,h,Rho,dx,t,Cs,Mu,tf;
+
+	Rho	= 998.21;
+	Mu	= 1.002e-3;
+	dx	= 2.5e-5;
+	h		= dx*1.1;
+	Cs	= 0.07;
+	t		= (0.2*h/(Cs));
+	tf	= 0.2;
+
+	dom.GeneralBefore	= & UserAcc;
+	dom.InitialDist 	= dx;
+
+	dom.AddBoxLength(1 ,Vec3_t ( 0.0 , -24.0*dx , 0.0 ), 20.0*dx + dx/10.0 , 48.0*dx + dx/10.0,  0 , dx/2.0 ,Rho, h, 1 , 0 , false, false );
+
+	SPH::MaterialProps Water(1);
+	Water.Cs		= Cs;
+	Water.PresEq	= 0;
+	Water.MuRef	= Mu;
+	dom.AddMaterial(Water);
+
+	for (size_t a=0; a<dom.Particles.Size(); a++)
+	{
+		yb=dom.Particles[a]->x(1);
+		if (yb>=20.0*dx || yb<=-20.0*dx)
+		{
+			dom.Particles[a]->ID			= 2;
+			dom.Particles[a]->IsFree	= false;
+			dom.Particles[a]->NoSlip	= true;
+		}
+	}
+
+	dom.Solve(/*tf*/tf,/*dt*/t,/*dtOut*/tf,NULL,999);
+
+	// The walls are half way between the last fluid and the first wall particles
+	double L	= 40.0*dx;
+	double Nu	= Mu/Rho;
+	double Umax	= Analytic(L/2.0, tf, L, Nu);
+	double Err	= 0.0;
+	size_t n	= 0;
+	for (size_t a=0; a<dom.Particles.Size(); a++)
+	{
+		if (!dom.Particles[a]->IsFree) continue;
+		Err += fabs(dom.Particles[a]->v(0) - Analytic(dom.Particles[a]->x(1)+L/2.0, tf, L, Nu));
+		n++;
+	}
+	Err /= n*Umax;
+	std::cout << "\nMean error of the velocity / analytic centre velocity (" << sizeof(SPH::Real_t)*8 << " bit packed state) = " << Err << std::endl;
+	return (Err<0.05) ? 0 : 1;
+}
+MECHSYS_CATCH
@@ -0,0 +1,67 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#include "Domain.h"
+
+// The tabulated kernel (Domain::KernelTableSize) against the analytic kernels, for all kernel types in 2D and 3D.
+// The error is relative to the largest absolute value of each function over the support. The largest q below the
+// support is sampled too, with 17 intervals of the quintic spline it rounds to the last node of the table.
+// Returns 1 if the error of the kernel or of its gradient exceeds 1e-5 with 1000 intervals or 1e-2 with 17.
+
+template <typename KP> double TableError (KP const & Ker, size_t Dim, size_t KT, size_t N)
+{
+	SPH::TabulatedKernel Table;
+	Table.Build(Dim, KT, N);
+	double Support	= (KT == 2) ? 3.0 : 2.0;
+	double h	= 0.7;
+	size_t M	= 20000;
+	double EW = 0.0, EG = 0.0, MW = 0.0, MG = 0.0;
+	for (size_t i=1; i<=M; i++)
+	{
+		// The last sample is the largest q below the support
+		double q = (i == M) ? nextafter(Support, 0.0) : Support*i/M;
+		MW = std::max(MW, fabs(Ker.Kernel(q,h)));
+		MG = std::max(MG, fabs(Ker.GradKernel(q,h)));
+		EW = std::max(EW, fabs(Table.Kernel(q,h)     - Ker.Kernel(q,h)));
+		EG = std::max(EG, fabs(Table.GradKernel(q,h) - Ker.GradKernel(q,h)));
+	}
+	return std::max(EW/MW, EG/MG);
+}
+
+int main(int argc, char **argv) try
+{
+	size_t const N = 1000;
+	double E[6] = {	TableError(SPH::QubicSplineKernel<2>(),   2, 0, N),	TableError(SPH::QubicSplineKernel<3>(),   3, 0, N),
+			TableError(SPH::QuinticKernel<2>(),       2, 1, N),	TableError(SPH::QuinticKernel<3>(),       3, 1, N),
+			TableError(SPH::QuinticSplineKernel<2>(), 2, 2, N),	TableError(SPH::QuinticSplineKernel<3>(), 3, 2, N)};
+	char const * Name[3] = {"Qubic_Spline", "Quintic", "Quintic_Spline"};
+
+	double Max = 0.0;
+	for (size_t k=0; k<6; k++)
+	{
+		std::cout << "Max relative error of the table (" << N << " intervals), " << Name[k/2] << " " << (k%2)+2 << "D = " << E[k] << std::endl;
+		Max = std::max(Max, E[k]);
+	}
+
+	double Coarse = TableError(SPH::QuinticSplineKernel<2>(), 2, 2, 17);
+	std::cout << "Max relative error of the table (17 intervals), Quintic_Spline 2D = " << Coarse << std::endl;
+	return (Max<1.0e-5 && Coarse<1.0e-2) ? 0 : 1;
+}
+MECHSYS_CATCH
@@ -0,0 +1,410 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#include <fstream>
+#include <set>
+
+#include "Domain.h"
+
+// Same answer tests of the optional code paths. A small dam break is solved with the reference settings and with
+// the settings under test, and the final states of the particles are compared (the particles are matched by their
+// tags, which are unique here). Usage: 9-SameAnswer <test>, with the tests listed in main.
+// Returns 1 if the largest difference of the position, velocity or density exceeds the tolerance of the test.
+// The CellList test compares the pairs of the neighbour search with a brute force search instead.
+// The output tests write the initial condition and 4 outputs to the working directory and compare the files as well.
+
+double	H	= 0.3;		// Height of the water column
+double	g	= 9.81;
+double	Rho	= 998.21;
+double	dx	= H/10.0;
+
+typedef void (*PtSetup) (SPH::Domain & dom);
+
+struct State
+{
+	Array<Vec3_t>	x;
+	Array<Vec3_t>	v;
+	Array<double>	Density;
+};
+
+// Builds the dam break and returns its time step
+double DamBreakModel (SPH::Domain & dom)
+{
+	dom.Dimension	= 2;
+	dom.Nproc	= 2;
+	dom.Scheme	= 0;
+	dom.Viscosity_Eq_Set(Morris);
+	dom.Kernel_Set(Qubic_Spline);
+	dom.Gradient_Approach_Set(Squared_density);
+
+	double L	= 2.0*H;
+	double TL	= 5.366*H;
+	double TH	= 1.5*H;
+	double h	= dx*1.2;
+	double Cs	= 10.0*sqrt(g*H);
+	double t	= 0.2*h/Cs;
+
+	dom.InitialDist	= dx;
+	dom.Gravity	= 0.0, -g, 0.0;
+
+	dom.AddBoxLength(1 ,Vec3_t ( -3.0*dx , -3.0*dx , 0.0 ), 7.0*dx + TL + dx/10.0 , 3.0*dx + TH + dx/10.0,  0 , dx/2.0 ,Rho, h, 1 , 0 , false, false );
+
+	SPH::MaterialProps Water(1);
+	Water.Cs	= Cs;
+	Water.PresEq	= 1;
+	Water.MuRef	= 1.002e-3;
+	Water.Alpha	= 0.1;
+	dom.AddMaterial(Water);
+
+	for (size_t a=0; a<dom.Particles.Size(); a++)
+	{
+		double xb = dom.Particles[a]->x(0);
+		double yb = dom.Particles[a]->x(1);
+		if (xb<0.0 || yb<0.0 || xb>TL)
+		{
+			dom.Particles[a]->ID		= 2;
+			dom.Particles[a]->IsFree	= false;
+			dom.Particles[a]->NoSlip	= true;
+		}
+		else if (yb>H || xb>L)	dom.Particles[a]->ID = 3;
+		else
+		{
+			dom.Particles[a]->Density	= Rho*pow((1+7.0*g*(H-yb)/(Cs*Cs)),(1.0/7.0));
+			dom.Particles[a]->Densityb	= dom.Particles[a]->Density;
+		}
+	}
+	dom.DelParticles(3);
+
+	// Unique tags
+	for (size_t a=0; a<dom.Particles.Size(); a++) dom.Particles[a]->ID = a;
+	return t;
+}
+
+// With a FileKey, the initial condition and 4 outputs are written
+void DamBreak (PtSetup Setup, size_t Steps, State & S, char const * FileKey=NULL)
+{
+	SPH::Domain		dom;
+	double t = DamBreakModel(dom);
+	Setup(dom);
+	dom.Solve(/*tf*/Steps*t,/*dt*/t,/*dtOut*/(FileKey==NULL ? Steps*t : Steps*t/4.0),FileKey,999);
+
+	// Tag, position, velocity and density of the particles of all of the ranks
+	Array<double> Data(8*dom.Particles.Size());
+	for (size_t a=0; a<dom.Particles.Size(); a++)
+	{
+		double * d = &Data[8*a];
+		d[0] = dom.Particles[a]->ID;
+		for (size_t k=0; k<3; k++) {d[1+k] = dom.Particles[a]->x(k); d[4+k] = dom.Particles[a]->v(k);}
+		d[7] = dom.Particles[a]->Density;
+	}
+#ifdef USE_MPI
+	Array<int> Count(dom.NRanks), Start(dom.NRanks);
+	int Local = Data.Size();
+	MPI_Allgather(&Local, 1, MPI_INT, Count.GetPtr(), 1, MPI_INT, MPI_COMM_WORLD);
+	int Total = 0;
+	for (int r=0; r<dom.NRanks; r++) {Start[r] = Total; Total += Count[r];}
+	Array<double> All(Total);
+	MPI_Allgatherv(Data.GetPtr(), Local, MPI_DOUBLE, All.GetPtr(), Count.GetPtr(), Start.GetPtr(), MPI_DOUBLE, MPI_COMM_WORLD);
+	Data = All;
+#endif
+
+	size_t N = Data.Size()/8;
+	S.x.Resize(N);
+	S.v.Resize(N);
+	S.Density.Resize(N);
+	for (size_t a=0; a<N; a++)
+	{
+		double const * d = &Data[8*a];
+		size_t n	= static_cast<size_t>(d[0]);
+		if (n>=N) throw new Fatal("9-SameAnswer: The tag %zd is out of range, the tags of the particles must be unique", n);
+		S.x[n]		= d[1], d[2], d[3];
+		S.v[n]		= d[4], d[5], d[6];
+		S.Density[n]	= d[7];
+	}
+}
+
+// Largest difference of the position (/dx), velocity (/sqrt(g*H)) and density (/Rho) of the particles
+double Difference (State const & A, State const & B)
+{
+	if (A.x.Size() != B.x.Size()) return 1.0e30;
+	double D = 0.0;
+	for (size_t n=0; n<A.x.Size(); n++)
+	{
+		D = std::max(D, norm(A.x[n]-B.x[n])/dx);
+		D = std::max(D, norm(A.v[n]-B.v[n])/sqrt(g*H));
+		D = std::max(D, fabs(A.Density[n]-B.Density[n])/Rho);
+	}
+	return D;
+}
+
+// Dataset Name of the output k (0 => initial condition) of FileKey, read as floats from the per-file outputs or
+// from the rows Offset to Offset+NP of the time series
+void ReadOutput (String const & FileKey, bool Series, size_t k, char const * Name, Array<float> & V)
+{
+	String fn;
+	if (Series)	fn.Printf("%s.hdf5", FileKey.CStr());
+	else if (k==0)	fn.Printf("%s_Initial.hdf5", FileKey.CStr());
+	else		fn.Printf("%s_%04d.hdf5", FileKey.CStr(), k);
+	hid_t File = H5Fopen(fn.CStr(), H5F_ACC_RDONLY, H5P_DEFAULT);
+	if (File<0) throw new Fatal("9-SameAnswer: Output file %s could not be opened", fn.CStr());
+
+	hsize_t Dims[2] = {0, 1};
+	H5T_class_t Class;
+	size_t Size;
+	H5LTget_dataset_info(File, Name, Dims, &Class, &Size);
+	int Rank;
+	H5LTget_dataset_ndims(File, Name, &Rank);
+	size_t Cols = (Rank>1) ? Dims[1] : 1;
+	Array<float> All(Dims[0]*Cols);
+	H5LTread_dataset(File, Name, H5T_NATIVE_FLOAT, All.GetPtr());
+
+	size_t First = 0, Count = All.Size();
+	if (Series)
+	{
+		H5LTget_dataset_info(File, "NP", Dims, &Class, &Size);
+		if (k>=Dims[0]) throw new Fatal("9-SameAnswer: The time series %s has no frame %zd", fn.CStr(), k);
+		Array<unsigned long long> NP(Dims[0]), Offset(Dims[0]);
+		H5LTread_dataset(File, "NP",     H5T_NATIVE_ULLONG, NP.GetPtr());
+		H5LTread_dataset(File, "Offset", H5T_NATIVE_ULLONG, Offset.GetPtr());
+		First	= Offset[k]*Cols;
+		Count	= NP[k]*Cols;
+	}
+	H5Fclose(File);
+
+	V.Resize(Count);
+	for (size_t i=0; i<Count; i++) V[i] = All[First+i];
+}
+
+// Largest difference of the position, velocity, pressure and density of the initial condition and 4 outputs of two
+// runs, relative to the largest value of each field
+double OutputDifference (String const & A, bool SeriesA, String const & B, bool SeriesB)
+{
+	char const * Fields[4] = {"Position", "Velocity", "Pressure", "Density"};
+	double D = 0.0;
+	for (size_t k=0; k<5; k++)
+	for (size_t f=0; f<4; f++)
+	{
+		Array<float> a, b;
+		ReadOutput(A, SeriesA, k, Fields[f], a);
+		ReadOutput(B, SeriesB, k, Fields[f], b);
+		if (a.Size()!=b.Size() || a.Size()==0) return 1.0e30;
+		double Max = 0.0, Diff = 0.0;
+		for (size_t i=0; i<a.Size(); i++)
+		{
+			Max	= std::max(Max, fabs(static_cast<double>(b[i])));
+			Diff	= std::max(Diff, fabs(static_cast<double>(a[i])-b[i]));
+		}
+		D = std::max(D, Diff/std::max(Max, 1.0e-12));
+	}
+	return D;
+}
+
+// Pairs of the cell list search (user-003) against all of the pairs closer than the kernel support, found by brute
+// force. Returns the No of missing and repeated pairs
+size_t CellPairs (SPH::Domain & dom)
+{
+	dom.CellInitiate();
+	dom.ListGenerate();
+	dom.MainNeighbourSearch();
+
+	size_t Bad = 0;
+	std::set< std::pair<size_t,size_t> > Found;
+	for (size_t k=0; k<dom.SMPairs.Size(); k++)
+	{
+		SPH::PairList * Lists[3] = {&dom.SMPairs[k], &dom.FSMPairs[k], &dom.NSMPairs[k]};
+		for (size_t l=0; l<3; l++)
+		for (size_t a=0; a<Lists[l]->Size(); a++)
+		{
+			size_t i = (*Lists[l])[a].first;
+			size_t j = (*Lists[l])[a].second;
+			if (!Found.insert(std::make_pair(std::min(i,j), std::max(i,j))).second) Bad++;
+		}
+	}
+
+	for (size_t i=0; i<dom.Particles.Size(); i++)
+	for (size_t j=i+1; j<dom.Particles.Size(); j++)
+	{
+		SPH::Particle const * Pi = dom.Particles[i];
+		SPH::Particle const * Pj = dom.Particles[j];
+		if (!(Pi->IsFree || Pj->IsFree)) continue;
+		if (norm(Pi->x-Pj->x) < 2.0*std::max(Pi->h,Pj->h) && Found.count(std::make_pair(i,j))==0) Bad++;
+	}
+	return Bad;
+}
+
+void Reference (SPH::Domain & dom) {}
+
+// Verlet lists (user-002) against a neighbour search at every step
+void Verlet (SPH::Domain & dom) { dom.VerletSkin = 0.2*dx; }
+
+// Space filling curve reordering of the particles every 10 steps (user-004)
+void Reorder (SPH::Domain & dom) { dom.ReorderStep = 10; }
+
+// Gather mode without locks (user-005) against the pair mode
+void Gather (SPH::Domain & dom) { dom.Interaction_Mode_Set(Gather_Mode); }
+
+// Scalar CalcForce11 against the SIMD blocks of the free fluid pairs (user-009), which the reference uses by default
+void Scalar (SPH::Domain & dom) { dom.FluidBatch = false; }
+
+// Cost balanced ranges of cells and pair slices (user-010) split among 3 threads instead of 2
+void Threads (SPH::Domain & dom) { dom.Nproc = 3; }
+
+// Static cell list of the fixed particles (user-014) against binning them at every step
+void Static (SPH::Domain & dom) { dom.StaticBoundary = true; }
+
+#ifdef USE_MPI
+// Model built by the rank 0 only (user-021), the other ranks start without particles and receive theirs in Solve
+void Distributed (SPH::Domain & dom)
+{
+	dom.Distributed = true;
+	if (dom.Rank == 0) return;
+	for (size_t a=0; a<dom.Particles.Size(); a++) dom.Particles[a]->ID = -1;
+	dom.DelParticles(-1);
+}
+#endif
+
+// Output files written by the calling thread against the background writer (user-023), which the reference uses by default
+void Sync (SPH::Domain & dom) { dom.AsyncOutput = false; }
+
+// All of the outputs appended to one time series file (user-024) against one file per output
+void Series (SPH::Domain & dom) { dom.TimeSeries = true; }
+
+// Fixed point positions, 16 bit velocity, pressure and density and gzip (user-025) against the float outputs
+void Quantized (SPH::Domain & dom)
+{
+	dom.Output.PositionBits	= 16;
+	dom.Output.Half		= SPH::Out_Velocity | SPH::Out_Pressure | SPH::Out_Density;
+	dom.Output.Deflate	= 6;
+	dom.Output.Shuffle	= true;
+}
+
+int main(int argc, char **argv) try
+{
+	if (argc<2) throw new Fatal("Usage: 9-SameAnswer <test>");
+	String Test(argv[1]);
+
+	if (Test == "CellList")
+	{
+		// The dam break and a random 3D block, both with 2 threads
+		SPH::Domain D2, D3;
+		DamBreakModel(D2);
+		D3.Dimension	= 3;
+		D3.Nproc	= 2;
+		D3.Kernel_Set(Qubic_Spline);
+		D3.AddBoxLength(1 ,Vec3_t ( 0.0 , 0.0 , 0.0 ), 12.0*dx , 10.0*dx , 8.0*dx , dx/2.0 ,Rho, 1.2*dx, 1 , 0 , true, false );
+		size_t Bad = CellPairs(D2) + CellPairs(D3);
+		std::cout << "\nCellList: missing or repeated pairs = " << Bad << std::endl;
+		return (Bad==0) ? 0 : 1;
+	}
+
+	if (Test == "Ranks")
+	{
+#ifdef USE_MPI
+		// The run with one rank writes the reference to SameAnswer_Ranks.dat, the runs with more ranks (user-021)
+		// compare the replicated and the distributed models with it
+		State A, B, C;
+		DamBreak(&Reference, 400, B);
+		int Rank, NRanks;
+		MPI_Comm_rank(MPI_COMM_WORLD, &Rank);
+		MPI_Comm_size(MPI_COMM_WORLD, &NRanks);
+		if (NRanks == 1)
+		{
+			std::ofstream File("SameAnswer_Ranks.dat");
+			File.precision(17);
+			File << B.x.Size() << "\n";
+			for (size_t n=0; n<B.x.Size(); n++)
+				File << B.x[n](0) << " " << B.x[n](1) << " " << B.x[n](2) << " " << B.v[n](0) << " " << B.v[n](1) << " " << B.v[n](2) << " " << B.Density[n] << "\n";
+			std::cout << "\nRanks: reference of one rank written to SameAnswer_Ranks.dat" << std::endl;
+			return 0;
+		}
+
+		std::ifstream File("SameAnswer_Ranks.dat");
+		if (!File.good()) throw new Fatal("9-SameAnswer: SameAnswer_Ranks.dat not found, run the Ranks test with one rank first");
+		size_t N;
+		File >> N;
+		A.x.Resize(N);
+		A.v.Resize(N);
+		A.Density.Resize(N);
+		for (size_t n=0; n<N; n++)
+			File >> A.x[n](0) >> A.x[n](1) >> A.x[n](2) >> A.v[n](0) >> A.v[n](1) >> A.v[n](2) >> A.Density[n];
+		if (!File.good()) throw new Fatal("9-SameAnswer: SameAnswer_Ranks.dat could not be read");
+
+		DamBreak(&Distributed, 400, C);
+		double D = std::max(Difference(A, B), Difference(A, C));
+		if (Rank == 0) std::cout << "\nRanks: largest difference of " << NRanks << " ranks from one rank = " << D << " (tolerance 1e-8)" << std::endl;
+		return (D<=1.0e-8) ? 0 : 1;
+#else
+		throw new Fatal("9-SameAnswer: The Ranks test needs USE_MPI");
+#endif
+	}
+
+	if (Test == "Async")
+	{
+		// The same run written with and without the background writer
+		State A, B;
+		DamBreak(&Sync,      400, A, "SameAnswer_Async_ref");
+		DamBreak(&Reference, 400, B, "SameAnswer_Async");
+		double D = std::max(Difference(A, B), OutputDifference("SameAnswer_Async", false, "SameAnswer_Async_ref", false));
+		std::cout << "\nAsync: largest difference of the outputs = " << D << " (tolerance 1e-8)" << std::endl;
+		return (D<=1.0e-8) ? 0 : 1;
+	}
+
+	if (Test == "TimeSeries")
+	{
+		// Each frame of the time series against the per-file output of the same run
+		State A, B;
+		DamBreak(&Reference, 400, A, "SameAnswer_TimeSeries_ref");
+		DamBreak(&Series,    400, B, "SameAnswer_TimeSeries");
+		double D = std::max(Difference(A, B), OutputDifference("SameAnswer_TimeSeries", true, "SameAnswer_TimeSeries_ref", false));
+		std::cout << "\nTimeSeries: largest difference of the outputs = " << D << " (tolerance 1e-8)" << std::endl;
+		return (D<=1.0e-8) ? 0 : 1;
+	}
+
+	if (Test == "Quantized")
+	{
+		// The quantized outputs read back within the 16 bit rounding of the float outputs (2^-11 of the value)
+		State A, B;
+		DamBreak(&Reference, 400, A, "SameAnswer_Quantized_ref");
+		DamBreak(&Quantized, 400, B, "SameAnswer_Quantized");
+		double D = Difference(A, B);
+		double Q = OutputDifference("SameAnswer_Quantized", false, "SameAnswer_Quantized_ref", false);
+		std::cout << "\nQuantized: largest difference of the states = " << D << " (tolerance 1e-8)";
+		std::cout << ", of the outputs = " << Q << " (tolerance 1e-3)" << std::endl;
+		return (D<=1.0e-8 && Q<=1.0e-3) ? 0 : 1;
+	}
+
+	PtSetup	Setup	= NULL;
+	double	Tol	= 0.0;
+	if (Test == "Verlet")	{Setup = &Verlet;	Tol = 1.0e-8;}
+	if (Test == "Reorder")	{Setup = &Reorder;	Tol = 1.0e-8;}
+	if (Test == "Gather")	{Setup = &Gather;	Tol = 1.0e-8;}
+	if (Test == "Scalar")	{Setup = &Scalar;	Tol = 1.0e-8;}
+	if (Test == "Threads")	{Setup = &Threads;	Tol = 1.0e-8;}
+	if (Test == "Static")	{Setup = &Static;	Tol = 1.0e-8;}
+	if (Setup == NULL) throw new Fatal("9-SameAnswer: Unknown test %s", argv[1]);
+
+	State A, B;
+	DamBreak(&Reference, 400, A);
+	DamBreak(Setup, 400, B);
+	double D = Difference(A, B);
+	std::cout << "\n" << Test << ": largest difference from the reference = " << D << " (tolerance " << Tol << ")" << std::endl;
+	return (D<=Tol) ? 0 : 1;
+}
+MECHSYS_CATCH
@@ -22,6 +22,8 @@ OPTION(A_MAKE_VERBOSE       "Show additional messages during compilation/linking
 OPTION(A_MAKE_ALL_WARNINGS  "Make with all warnings (-Wall)"                       ON )
 OPTION(A_MAKE_DEBUG_SYMBOLS "Make with debug symbols (-g)"                         OFF)
 OPTION(A_MAKE_OPTIMIZED     "Make optimized (-O3)"                                 ON )
+OPTION(A_USE_MIXED_PRECISION "Store the packed particle state in float"              OFF)
+OPTION(A_USE_MPI            "Domain decomposition among MPI processes"              OFF)
 
 SET (FLAGS   "${FLAGS}")
 SET (LIBS     ${LIBS})
@@ -47,6 +49,22 @@ ENDIF(A_MAKE_OPTIMIZED)
 ADD_DEFINITIONS(-fmessage-length=0) # Each error message will appear on a single line; no line-wrapping will be done.
 #ADD_DEFINITIONS(-std=c++11)         # New C++ standard
 ADD_DEFINITIONS(-fpermissive)       # New C++ standard
+ADD_DEFINITIONS(-fno-math-errno)    # sqrt without errno, lets the batched eigensolver loops vectorise
+
+IF(A_USE_MIXED_PRECISION)
+	ADD_DEFINITIONS (-DUSE_MIXED_PRECISION)
+ENDIF(A_USE_MIXED_PRECISION)
+
+IF(A_USE_MPI)
+	FIND_PACKAGE (MPI)
+	if(MPI_CXX_FOUND)
+		ADD_DEFINITIONS (-DUSE_MPI)
+		INCLUDE_DIRECTORIES (${MPI_CXX_INCLUDE_PATH})
+		SET (LIBS ${LIBS} ${MPI_CXX_LIBRARIES})
+	else(MPI_CXX_FOUND)
+		SET (MISSING "${MISSING} MPI")
+	endif(MPI_CXX_FOUND)
+ENDIF(A_USE_MPI)
 
 INCLUDE      ($ENV{SPH}/Modules/FindHDF5.cmake)
 INCLUDE      (FindOpenMP)
@@ -79,6 +97,10 @@ else(OPENMP_FOUND)
 endif(OPENMP_FOUND)
 
 
+# Background output thread
+FIND_PACKAGE (Threads)
+SET (LIBS ${LIBS} ${CMAKE_THREAD_LIBS_INIT})
+
 if(LAPACK_FOUND)
     SET (LIBS ${LIBS} ${LAPACK_LIBRARIES})
 else(LAPACK_FOUND)
@@ -0,0 +1,351 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#include "Domain.h"
+
+namespace SPH {
+
+// Finalises MPI at the exit of the program if the domain initialised it
+inline void FinalizeMPI ()
+{
+	int Done;
+	MPI_Finalized(&Done);
+	if (!Done) MPI_Finalize();
+}
+
+inline void Domain::InitMPI ()
+{
+	int Init;
+	MPI_Initialized(&Init);
+	if (!Init)
+	{
+		// Only the master thread of each rank calls MPI, the OpenMP loops do not communicate
+		int Provided;
+		MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &Provided);
+		atexit(&FinalizeMPI);
+	}
+	MPI_Comm_rank(MPI_COMM_WORLD, &Rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &NRanks);
+}
+
+inline int Domain::SubdomainOf (Vec3_t const & x) const
+{
+	// The subdomains are half open boxes covering the whole space, the outer ones extend to infinity
+	for (int r=0; r<NRanks; r++)
+		if (x(0)>=SubMin[r](0) && x(0)<SubMax[r](0) &&
+		    x(1)>=SubMin[r](1) && x(1)<SubMax[r](1) &&
+		    x(2)>=SubMin[r](2) && x(2)<SubMax[r](2)) return r;
+	return Rank;
+}
+
+inline void Domain::Bisect (int R0, int R1, Vec3_t const & Min, Vec3_t const & Max)
+{
+	if (R1-R0 == 1)
+	{
+		SubMin[R0] = Min;
+		SubMax[R0] = Max;
+		return;
+	}
+
+	// The box is cut along its longest non periodic direction inside the domain, the periodic directions are
+	// never cut so the periodic neighbours of a particle are always found in the cells of its own rank
+	int Axis	= -1;
+	double Lo	= 0.0;
+	double Hi	= 0.0;
+	for (int d=0; d<Dimension; d++)
+	{
+		if (BC.Periodic[d]) continue;
+		double L = std::max(Min(d),BLPF(d));
+		double H = std::min(Max(d),TRPR(d));
+		if (Axis<0 || H-L > Hi-Lo) {Axis = d; Lo = L; Hi = H;}
+	}
+	if (Axis<0) throw new Fatal("Domain::Decompose: The domain is periodic in all of the directions, it cannot be split among %d ranks", NRanks);
+
+	// The cut leaves the share of the ranks [R0,RM) of the particles of the box on its low side, it is found with
+	// two levels of global histograms along the axis (bin 0 and bin NBins+1 hold the particles outside [Lo,Hi))
+	int RM		= R0 + (R1-R0)/2;
+	size_t const NBins = 256;
+	Array<long> Hist(NBins+2);
+	double Target	= 0.0;
+	double Below	= 0.0;
+	size_t Bin	= 1;
+	for (size_t Pass=0; Pass<2; Pass++)
+	{
+		double w = (Hi-Lo)/NBins;
+		Hist.SetValues(0);
+		for (size_t i=0; i<Particles.Size(); i++)
+		{
+			Vec3_t const & x = Particles[i]->x;
+			if (x(0)<Min(0) || x(0)>=Max(0) || x(1)<Min(1) || x(1)>=Max(1) || x(2)<Min(2) || x(2)>=Max(2)) continue;
+			if	(x(Axis)<Lo)	Hist[0]++;
+			else if	(x(Axis)>=Hi)	Hist[NBins+1]++;
+			else			Hist[1 + std::min(size_t((x(Axis)-Lo)/w), NBins-1)]++;
+		}
+		MPI_Allreduce(MPI_IN_PLACE, Hist.GetPtr(), NBins+2, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+		if (Pass == 0)
+		{
+			long Total = 0;
+			for (size_t b=0; b<NBins+2; b++) Total += Hist[b];
+			Target	= double(Total)*(RM-R0)/(R1-R0);
+		}
+
+		// Bin of the cut, the next pass refines it
+		double Acc = Hist[0];
+		for (Bin=1; Bin<=NBins; Bin++)
+		{
+			if (Acc+Hist[Bin] >= Target) break;
+			Acc += Hist[Bin];
+		}
+		if (Bin > NBins)
+		{
+			Below	= Acc;
+			Lo	= Hi;
+			break;
+		}
+		Below	= Acc;
+		Lo	= Lo + (Bin-1)*w;
+		Hi	= Lo + w;
+	}
+
+	// Linear interpolation inside the last bin
+	double Cut = Lo;
+	if (Hi>Lo && Bin<=NBins && Hist[Bin]>0) Cut = Lo + (Hi-Lo)*std::min(1.0, (Target-Below)/Hist[Bin]);
+
+	Vec3_t LowMax	= Max;
+	Vec3_t HighMin	= Min;
+	LowMax(Axis)	= Cut;
+	HighMin(Axis)	= Cut;
+	Bisect(R0, RM, Min, LowMax);
+	Bisect(RM, R1, HighMin, Max);
+}
+
+inline void Domain::Decompose ()
+{
+	// Recursive coordinate bisection of the particles, all ranks compute all of the cuts from the global counts so
+	// they agree on the boxes. If all ranks hold the whole model the counts are scaled by NRanks and the cuts are the same,
+	// if only some of them hold particles (Distributed) the counts are those of the whole model
+	double Big = std::numeric_limits<double>::max();
+	SubMin.Resize(NRanks);
+	SubMax.Resize(NRanks);
+	Bisect(0, NRanks, Vec3_t(-Big,-Big,-Big), Vec3_t(Big,Big,Big));
+}
+
+inline void Domain::Exchange (Array< Array<double> > const & Send, Array<double> & Recv, Array<int> & RecvCount)
+{
+	Array<int> SendCount(NRanks), SendStart(NRanks), RecvStart(NRanks);
+	RecvCount.Resize(NRanks);
+	for (int r=0; r<NRanks; r++) SendCount[r] = Send[r].Size();
+	MPI_Alltoall(SendCount.GetPtr(), 1, MPI_INT, RecvCount.GetPtr(), 1, MPI_INT, MPI_COMM_WORLD);
+
+	int NS = 0, NR = 0;
+	for (int r=0; r<NRanks; r++)
+	{
+		SendStart[r]	= NS;
+		RecvStart[r]	= NR;
+		NS		+= SendCount[r];
+		NR		+= RecvCount[r];
+	}
+	Array<double> Buf(NS);
+	for (int r=0; r<NRanks; r++)
+		for (int i=0; i<SendCount[r]; i++) Buf[SendStart[r]+i] = Send[r][i];
+	Recv.Resize(NR);
+	MPI_Alltoallv(Buf.GetPtr(), SendCount.GetPtr(), SendStart.GetPtr(), MPI_DOUBLE,
+			Recv.GetPtr(), RecvCount.GetPtr(), RecvStart.GetPtr(), MPI_DOUBLE, MPI_COMM_WORLD);
+}
+
+inline void Domain::Migrate (bool Replicated)
+{
+	// The particles outside the own subdomain are sent to their owners, if all ranks hold the whole model
+	// (initial distribution) they are only deleted. At most Chunk particles are sent by each rank in a round and
+	// they are deleted as they are packed, so a rank holding the whole model (Distributed) never holds a second
+	// copy of it in the buffers
+	size_t const Chunk = 65536;
+	Array<Particle*> Old(Particles);
+	Array<Particle*> New;
+	size_t k = 0;
+	size_t i = 0;
+	int More = 1;
+	while (More)
+	{
+		Array< Array<double> > Send(NRanks);
+		size_t NSent = 0;
+		for (; i<Old.Size() && NSent<Chunk; i++)
+		{
+			int r = SubdomainOf(Old[i]->x);
+			if (r == Rank)
+			{
+				Old[k++] = Old[i];
+				continue;
+			}
+			if (!Replicated)
+			{
+				Old[i]->Pack(Send[r]);
+				NSent++;
+			}
+			omp_destroy_lock(&Old[i]->my_lock);
+			delete Old[i];
+		}
+		if (Replicated) break;
+
+		Array<double> Recv;
+		Array<int> RecvCount;
+		Exchange(Send, Recv, RecvCount);
+
+		double const * Buf = Recv.GetPtr();
+		double const * End = Buf + Recv.Size();
+		while (Buf < End)
+		{
+			Particle * P = new Particle(0, Vec3_t(0.0,0.0,0.0), Vec3_t(0.0,0.0,0.0), 1.0, 1.0, 1.0);
+			P->Unpack(Buf);
+			New.Push(P);
+		}
+
+		More = (i < Old.Size());
+		MPI_Allreduce(MPI_IN_PLACE, &More, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+	}
+
+	Particles.Resize(k+New.Size());
+	for (size_t j=0; j<k; j++)		Particles[j]	= Old[j];
+	for (size_t j=0; j<New.Size(); j++)	Particles[k+j]	= New[j];
+
+	if (Replicated)
+	{
+		// Every rank must have built the same model
+		long N[2] = {long(Old.Size()), -long(Old.Size())};
+		MPI_Allreduce(MPI_IN_PLACE, N, 2, MPI_LONG, MPI_MIN, MPI_COMM_WORLD);
+		if (N[0] != -N[1]) throw new Fatal("Domain::Migrate: All of the ranks must build the same particles before Solve, or set Domain::Distributed if each rank built only a part of them");
+	}
+	VerletRebuild = true;
+	StaticRebuild = true;
+}
+
+inline void Domain::HaloExchange ()
+{
+	// The owned particles within the cut-off of the other subdomains are copied to them and appended as ghosts
+	double Halo	= Cellfac*hmax;
+	size_t NOwned	= Particles.Size();
+	Array< Array<double> > Send(NRanks);
+	HaloList.Resize(NRanks);
+	for (int r=0; r<NRanks; r++) HaloList[r].Clear();
+
+	for (size_t i=0; i<NOwned; i++)
+	{
+		Vec3_t const & x = Particles[i]->x;
+		for (int r=0; r<NRanks; r++)
+		{
+			if (r == Rank) continue;
+			double d2 = 0.0;
+			for (size_t d=0; d<3; d++)
+			{
+				double e = std::max(std::max(SubMin[r](d)-x(d), x(d)-SubMax[r](d)), 0.0);
+				d2 += e*e;
+			}
+			if (d2 > Halo*Halo) continue;
+			HaloList[r].Push(i);
+			Particles[i]->Pack(Send[r]);
+		}
+	}
+
+	Array<double> Recv;
+	Array<int> RecvCount;
+	Exchange(Send, Recv, RecvCount);
+
+	HaloCount.Resize(NRanks);
+	double const * Buf = Recv.GetPtr();
+	for (int r=0; r<NRanks; r++)
+	{
+		HaloCount[r] = 0;
+		double const * End = Buf + RecvCount[r];
+		while (Buf < End)
+		{
+			Particle * P = new Particle(0, Vec3_t(0.0,0.0,0.0), Vec3_t(0.0,0.0,0.0), 1.0, 1.0, 1.0);
+			P->Unpack(Buf);
+			Particles.Push(P);
+			HaloCount[r]++;
+		}
+	}
+	NGhost = Particles.Size() - NOwned;
+	VerletRebuild = true;
+	StaticRebuild = true;
+}
+
+inline void Domain::HaloUpdate ()
+{
+	// The values of the fixed particles (boundary conditions) and the saturation of the soil particles are computed
+	// by PrimaryComputeAcceleration from all of the neighbours, only the owner has them all
+	Array< Array<double> > Send(NRanks);
+	for (int r=0; r<NRanks; r++)
+		for (size_t i=0; i<HaloList[r].Size(); i++)
+		{
+			Particle const * P = Particles[HaloList[r][i]];
+			PackState(Send[r], P->Pressure);	PackState(Send[r], P->FSIPressure);
+			PackState(Send[r], P->SumKernel);	PackState(Send[r], P->FSISumKernel);
+			PackState(Send[r], P->NSv);		PackState(Send[r], P->FSINSv);
+			PackState(Send[r], P->Mass);		PackState(Send[r], P->Density);
+			PackState(Send[r], P->RefDensity);	PackState(Send[r], P->IsSat);
+			if (P->Solid != NULL)
+			{
+				PackState(Send[r], P->Solid->Sigma);
+				PackState(Send[r], P->Solid->TIR);
+			}
+		}
+
+	Array<double> Recv;
+	Array<int> RecvCount;
+	Exchange(Send, Recv, RecvCount);
+
+	// The ghosts of each rank are in the order of its halo list
+	double const * Buf = Recv.GetPtr();
+	size_t g = Particles.Size() - NGhost;
+	for (int r=0; r<NRanks; r++)
+		for (int i=0; i<HaloCount[r]; i++)
+		{
+			Particle * P = Particles[g++];
+			UnpackState(Buf, P->Pressure);		UnpackState(Buf, P->FSIPressure);
+			UnpackState(Buf, P->SumKernel);		UnpackState(Buf, P->FSISumKernel);
+			UnpackState(Buf, P->NSv);		UnpackState(Buf, P->FSINSv);
+			UnpackState(Buf, P->Mass);		UnpackState(Buf, P->Density);
+			UnpackState(Buf, P->RefDensity);	UnpackState(Buf, P->IsSat);
+			if (P->Solid != NULL)
+			{
+				UnpackState(Buf, P->Solid->Sigma);
+				UnpackState(Buf, P->Solid->TIR);
+			}
+		}
+}
+
+inline void Domain::HaloClear ()
+{
+	size_t NOwned = Particles.Size() - NGhost;
+	for (size_t i=NOwned; i<Particles.Size(); i++)
+	{
+		omp_destroy_lock(&Particles[i]->my_lock);
+		delete Particles[i];
+	}
+	Array<Particle*> Old(Particles);
+	Particles.Resize(NOwned);
+	for (size_t i=0; i<NOwned; i++) Particles[i] = Old[i];
+	NGhost = 0;
+	VerletRebuild = true;
+	StaticRebuild = true;
+}
+
+}; // namespace SPH
@@ -25,6 +25,11 @@ void General(Domain & dom)
 {
 }
 
+size_t KeepLevel(Domain & dom, Particle * P)
+{
+	return P->Level;
+}
+
 void OutPut(Particle * Particles, double & Prop1, double & Prop2,  double & Prop3)
 {
 	Prop1 = 0.0;
@@ -71,15 +76,62 @@ inline Domain::Domain ()
     VisEq	= 0;
     Scheme	= 0;
 		GradientType = 0;
+    InteractionMode = 0;
 
     XSPH	= 0.0;
     InitialDist = 0.0;
 
+    CellBuffer	= NULL;
+    CellStart	= CellCount = CellHist = CellCost = SearchCells = SearchCost = NULL;
+    PartBuffer	= NULL;
+    CellPart	= PartCell = NULL;
+    PartCapacity = 0;
+    StaticBuffer	= NULL;
+    StaticStart	= StaticCount = StaticPart = NULL;
+    StaticRebuild = true;
+    NeighStart	= NeighFill = NULL;
+    NeighCapacity = 0;
+    NeighPairs	= NULL;
+    NeighPairsCapacity = 0;
+
+    VerletSkin	= 0.0;
+    ReorderStep	= 0;
+    KernelTableSize = 0;
+    FluidBatch	= true;
+    StaticBoundary = false;
+    CFLFactor	= 0.0;
+    TimeBins	= 0;
+    TimeSub	= 0;
+    BlockUpdates = BlockFullUpdates = 0;
+    SleepSteps	= 0;
+    SleepVelocity	= 1.0e-4;
+    SleepAcceleration	= 1.0e-2;
+    SleepStrainRate	= 1.0e-3;
+    SleepUpdates = SleepFullUpdates = 0;
+    PackTime = ForceTime = 0.0;
+    RefineStep	= 0;
+    RefineMax	= 2;
+    RefineSplits = RefineMerges = 0;
+    Families.Push(0);
+    VerletRebuild = true;
+    VerletBuilds = 0;
+
     AvgVelocity = 0.0;
     hmax	= 0.0;
 
     omp_init_lock (&dom_lock);
     Nproc	= 1;
+    NUMA	= false;
+    AsyncOutput	= true;
+    TimeSeries	= false;
+    Rank	= 0;
+    NRanks	= 1;
+    BalanceStep	= 100;
+    Distributed	= false;
+    NGhost	= 0;
+#ifdef USE_MPI
+    InitMPI();
+#endif
 
     deltat	= 0.0;
     deltatint	= 0.0;
@@ -94,6 +146,7 @@ inline Domain::Domain ()
     AllCon = & AllFlowCon;
     GeneralBefore = & General;
     GeneralAfter = & General;
+    RefineLevel = & KeepLevel;
     UserOutput = & OutPut;
 
     DomMax = -100000000000.0;
@@ -105,13 +158,25 @@ inline Domain::~Domain ()
 {
 	size_t Max = Particles.Size();
 	for (size_t i=1; i<=Max; i++)  Particles.DelItem(Max-i);
+
+	if (CellBuffer!=NULL) delete [] CellBuffer;
+	if (PartBuffer!=NULL) delete [] PartBuffer;
+	if (StaticBuffer!=NULL) delete [] StaticBuffer;
+	if (NeighStart!=NULL) delete [] NeighStart;
+	if (NeighFill!=NULL)  delete [] NeighFill;
+	if (NeighPairs!=NULL) delete [] NeighPairs;
 }
 
 	inline void Domain::Periodic_X_Correction(Vec3_t & x, double const & h, Particle * P1, Particle * P2)
 	{
-		if (DomSize(0)>0.0) {if (x(0)>2*Cellfac*h || x(0)<-2*Cellfac*h) {(P1->CC[0]>P2->CC[0]) ? x(0) -= DomSize(0) : x(0) += DomSize(0);}}
-		if (DomSize(1)>0.0) {if (x(1)>2*Cellfac*h || x(1)<-2*Cellfac*h) {(P1->CC[1]>P2->CC[1]) ? x(1) -= DomSize(1) : x(1) += DomSize(1);}}
-		if (DomSize(2)>0.0) {if (x(2)>2*Cellfac*h || x(2)<-2*Cellfac*h) {(P1->CC[2]>P2->CC[2]) ? x(2) -= DomSize(2) : x(2) += DomSize(2);}}
+		Periodic_X_Correction(x, h, P1->CC, P2->CC);
+	}
+
+	inline void Domain::Periodic_X_Correction(Vec3_t & x, double const & h, int const * CC1, int const * CC2)
+	{
+		if (DomSize(0)>0.0) {if (x(0)>2*Cellfac*h || x(0)<-2*Cellfac*h) {(CC1[0]>CC2[0]) ? x(0) -= DomSize(0) : x(0) += DomSize(0);}}
+		if (DomSize(1)>0.0) {if (x(1)>2*Cellfac*h || x(1)<-2*Cellfac*h) {(CC1[1]>CC2[1]) ? x(1) -= DomSize(1) : x(1) += DomSize(1);}}
+		if (DomSize(2)>0.0) {if (x(2)>2*Cellfac*h || x(2)<-2*Cellfac*h) {(CC1[2]>CC2[2]) ? x(2) -= DomSize(2) : x(2) += DomSize(2);}}
 	}
 
 	inline void Domain::Kernel_Set(Kernels_Type const & KT)
@@ -130,9 +195,15 @@ inline Domain::~Domain ()
 		GradientType = GT;
 	}
 
+	inline void Domain::Interaction_Mode_Set(Interaction_Mode_Type const & IM)
+	{
+		InteractionMode = IM;
+	}
+
 	inline void Domain::AdaptiveTimeStep()
 	{
-		if (deltatint>deltatmin)
+		// The time step controller follows deltatmin even above the user time step
+		if (deltatint>deltatmin || CFLFactor>0.0)
 		{
 			if (deltat<deltatmin)
 				deltat		= 2.0*deltat*deltatmin/(deltat+deltatmin);
@@ -151,6 +222,16 @@ inline Domain::~Domain ()
 			throw new Fatal("Too small time step, please choose a smaller time step initially to make the simulation more stable");
 	}
 
+inline size_t Domain::AddMaterial(MaterialProps const & M)
+{
+	if (M.Type<1 || M.Type>3)
+		throw new Fatal("Domain::AddMaterial: Material type %d is out of range (1 => Fluid, 2 => Solid, 3 => Soil)", M.Type);
+
+	Materials.Push(M);
+	Materials[Materials.Size()-1].Init();
+	return Materials.Size()-1;
+}
+
 inline void Domain::AddSingleParticle(int tag, Vec3_t const & x, double Mass, double Density, double h, bool Fixed)
 {
    	Particles.Push(new Particle(tag,x,Vec3_t(0,0,0),Mass,Density,h,Fixed));
@@ -510,6 +591,8 @@ inline void Domain::DelParticles (int const & Tags)
     }
     if (idxs.Size()<1) throw new Fatal("Domain::DelParticles: Could not find any particles to delete");
     Particles.DelItems (idxs);
+    VerletRebuild = true;
+    StaticRebuild = true;
 
     std::cout << "\n" << "Particle(s) with Tag No. " << Tags << " has been deleted" << std::endl;
 }
@@ -543,6 +626,8 @@ inline void Domain::CheckParticleLeave ()
 			std::cout<<"a = "<<Particles[DelParticles[i]]->a<<std::endl;
 		}
 		Particles.DelItems(DelParticles);
+		VerletRebuild = true;
+		StaticRebuild = true;
 	}
 }
 
@@ -551,10 +636,11 @@ inline void Domain::CellInitiate ()
 	if (!(norm(TRPR)>0.0) && !(norm(BLPF)>0.0))
 	{
 		// Calculate Domain Size
-		BLPF = Particles[0]->x;
-		TRPR = Particles[0]->x;
-		hmax = Particles[0]->h;
-		rhomax = Particles[0]->Density;
+		double Big = std::numeric_limits<double>::max();
+		BLPF = Vec3_t( Big, Big, Big);
+		TRPR = Vec3_t(-Big,-Big,-Big);
+		hmax = 0.0;
+		rhomax = 0.0;
 
 		for (size_t i=0; i<Particles.Size(); i++)
 		{
@@ -569,8 +655,19 @@ inline void Domain::CellInitiate ()
 			if (Particles[i]->h > hmax) hmax=Particles[i]->h;
 			if (Particles[i]->Density > rhomax) rhomax=Particles[i]->Density;
 			if (Particles[i]->Mu > MuMax) MuMax=Particles[i]->Mu;
-			if (Particles[i]->Cs > CsMax) CsMax=Particles[i]->Cs;
 		}
+#ifdef USE_MPI
+		// The ranks may hold different parts of the model (Distributed), they all take the whole domain
+		double Ext[9] = {-BLPF(0), -BLPF(1), -BLPF(2), TRPR(0), TRPR(1), TRPR(2), hmax, rhomax, MuMax};
+		MPI_Allreduce(MPI_IN_PLACE, Ext, 9, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+		BLPF	= Vec3_t(-Ext[0], -Ext[1], -Ext[2]);
+		TRPR	= Vec3_t( Ext[3],  Ext[4],  Ext[5]);
+		hmax	= Ext[6];
+		rhomax	= Ext[7];
+		MuMax	= Ext[8];
+#endif
+		for (size_t i=0; i<Materials.Size(); i++)
+			if (Materials[i].Cs > CsMax) CsMax=Materials[i].Cs;
 	}
 
 	// Override the calculated domain size
@@ -587,18 +684,19 @@ inline void Domain::CellInitiate ()
 	if (!BC.Periodic[1]) {TRPR(1) += hmax/2;	BLPF(1) -= hmax/2;}else{TRPR(1) += R; BLPF(1) -= R;}
 	if (!BC.Periodic[2]) {TRPR(2) += hmax/2;	BLPF(2) -= hmax/2;}else{TRPR(2) += R; BLPF(2) -= R;}
 
-    // Calculate Cells Properties
+    // Calculate Cells Properties (cells must hold the whole neighbour cut-off, including the Verlet skin)
+	double CellMin = Cellfac*hmax + VerletSkin;
 	switch (Dimension)
 	{case 2:
-		if (double (ceil(((TRPR(0)-BLPF(0))/(Cellfac*hmax)))-((TRPR(0)-BLPF(0))/(Cellfac*hmax)))<(hmax/10.0))
-			CellNo[0] = int(ceil((TRPR(0)-BLPF(0))/(Cellfac*hmax)));
+		if (double (ceil(((TRPR(0)-BLPF(0))/CellMin))-((TRPR(0)-BLPF(0))/CellMin))<(hmax/10.0))
+			CellNo[0] = int(ceil((TRPR(0)-BLPF(0))/CellMin));
 		else
-			CellNo[0] = int(floor((TRPR(0)-BLPF(0))/(Cellfac*hmax)));
+			CellNo[0] = int(floor((TRPR(0)-BLPF(0))/CellMin));
 
-		if (double (ceil(((TRPR(1)-BLPF(1))/(Cellfac*hmax)))-((TRPR(1)-BLPF(1))/(Cellfac*hmax)))<(hmax/10.0))
-			CellNo[1] = int(ceil((TRPR(1)-BLPF(1))/(Cellfac*hmax)));
+		if (double (ceil(((TRPR(1)-BLPF(1))/CellMin))-((TRPR(1)-BLPF(1))/CellMin))<(hmax/10.0))
+			CellNo[1] = int(ceil((TRPR(1)-BLPF(1))/CellMin));
 		else
-			CellNo[1] = int(floor((TRPR(1)-BLPF(1))/(Cellfac*hmax)));
+			CellNo[1] = int(floor((TRPR(1)-BLPF(1))/CellMin));
 
 		CellNo[2] = 1;
 
@@ -606,20 +704,20 @@ inline void Domain::CellInitiate ()
 		break;
 
 	case 3:
-		if (double (ceil(((TRPR(0)-BLPF(0))/(Cellfac*hmax)))-((TRPR(0)-BLPF(0))/(Cellfac*hmax)))<(hmax/10.0))
-			CellNo[0] = int(ceil((TRPR(0)-BLPF(0))/(Cellfac*hmax)));
+		if (double (ceil(((TRPR(0)-BLPF(0))/CellMin))-((TRPR(0)-BLPF(0))/CellMin))<(hmax/10.0))
+			CellNo[0] = int(ceil((TRPR(0)-BLPF(0))/CellMin));
 		else
-			CellNo[0] = int(floor((TRPR(0)-BLPF(0))/(Cellfac*hmax)));
+			CellNo[0] = int(floor((TRPR(0)-BLPF(0))/CellMin));
 
-		if (double (ceil(((TRPR(1)-BLPF(1))/(Cellfac*hmax)))-((TRPR(1)-BLPF(1))/(Cellfac*hmax)))<(hmax/10.0))
-			CellNo[1] = int(ceil((TRPR(1)-BLPF(1))/(Cellfac*hmax)));
+		if (double (ceil(((TRPR(1)-BLPF(1))/CellMin))-((TRPR(1)-BLPF(1))/CellMin))<(hmax/10.0))
+			CellNo[1] = int(ceil((TRPR(1)-BLPF(1))/CellMin));
 		else
-			CellNo[1] = int(floor((TRPR(1)-BLPF(1))/(Cellfac*hmax)));
+			CellNo[1] = int(floor((TRPR(1)-BLPF(1))/CellMin));
 
-		if (double (ceil(((TRPR(2)-BLPF(2))/(Cellfac*hmax)))-((TRPR(2)-BLPF(2))/(Cellfac*hmax)))<(hmax/10.0))
-			CellNo[2] = int(ceil((TRPR(2)-BLPF(2))/(Cellfac*hmax)));
+		if (double (ceil(((TRPR(2)-BLPF(2))/CellMin))-((TRPR(2)-BLPF(2))/CellMin))<(hmax/10.0))
+			CellNo[2] = int(ceil((TRPR(2)-BLPF(2))/CellMin));
 		else
-			CellNo[2] = int(floor((TRPR(2)-BLPF(2))/(Cellfac*hmax)));
+			CellNo[2] = int(floor((TRPR(2)-BLPF(2))/CellMin));
 
 		CellSize  = Vec3_t ((TRPR(0)-BLPF(0))/CellNo[0],(TRPR(1)-BLPF(1))/CellNo[1],(TRPR(2)-BLPF(2))/CellNo[2]);
 		break;
@@ -639,128 +737,213 @@ inline void Domain::CellInitiate ()
     if (BC.Periodic[1]) DomSize[1] = (TRPR(1)-BLPF(1));
     if (BC.Periodic[2]) DomSize[2] = (TRPR(2)-BLPF(2));
 
-    // Initiate Head of Chain array for Linked-List
-    HOC = new int**[(int) CellNo[0]];
-    for(int i =0; i<CellNo[0]; i++){
-       HOC[i] = new int*[CellNo[1]];
-       for(int j =0; j<CellNo[1]; j++){
-           HOC[i][j] = new int[CellNo[2]];
-           for(int k = 0; k<CellNo[2];k++){
-              HOC[i][j][k] = -1;
-           }
-       }
-    }
+    // Initiate the cell list, start & count of each cell and the counters of each thread in one block
+    size_t NCells = CellNo[0]*CellNo[1]*CellNo[2];
+    if (CellBuffer!=NULL) delete [] CellBuffer;
+    CellBuffer = new int[(5+Nproc)*NCells+1];
+    CellStart	= CellBuffer;
+    CellCount	= CellBuffer + NCells;
+    CellCost	= CellBuffer + 2*NCells;
+    SearchCells	= CellBuffer + 3*NCells;
+    SearchCost	= CellBuffer + 4*NCells;
+    CellHist	= CellBuffer + 5*NCells + 1;
+    for (size_t c=0; c<NCells; c++) CellStart[c] = CellCount[c] = CellCost[c] = 0;
+    StaticRebuild = true;
     // Initiate Pairs array for neibour searching
     for(size_t i=0 ; i<Nproc ; i++)
     {
 	SMPairs.Push(Initial);
 	NSMPairs.Push(Initial);
 	FSMPairs.Push(Initial);
+	// The geometry is only kept for the fixed particle pairs and the same material pairs of the pair mode
+	FSMPairs[FSMPairs.Size()-1].KeepGeom(true);
+	SMPairs[SMPairs.Size()-1].KeepGeom(InteractionMode != Gather_Mode);
     }
 }
 
 inline void Domain::ListGenerate ()
 {
-	int i, j, k, temp=0;
-	switch (Dimension)
-	{case 2:
-		for (size_t a=0; a<Particles.Size(); a++)
+	if (Dimension!=2 && Dimension!=3)
+	{
+    	std::cout << "Please correct the dimension (2=>2D or 3=>3D) and run again" << std::endl;
+		abort();
+	}
+
+	int N		= Particles.Size();
+	int NCells	= CellNo[0]*CellNo[1]*CellNo[2];
+
+	// Particle sized buffers only grow
+	if (N > PartCapacity)
+	{
+		if (PartBuffer!=NULL) delete [] PartBuffer;
+		PartCapacity	= N + N/4 + 16;
+		PartBuffer	= new int[2*PartCapacity];
+		CellPart	= PartBuffer;
+		PartCell	= PartBuffer + PartCapacity;
+	}
+
+	// Counting sort of the particles into the cells, the particles of each thread are a contiguous range
+	#pragma omp parallel num_threads(Nproc)
+	{
+		int T		= omp_get_thread_num();
+		int NT		= omp_get_num_threads();
+		int First	= (N*T)/NT;
+		int Last	= (N*(T+1))/NT;
+		int * Hist	= CellHist + T*NCells;
+
+		for (int c=0; c<NCells; c++) Hist[c] = 0;
+
+		for (int a=First; a<Last; a++)
 		{
-			i= (int) (floor((Particles[a]->x(0) - BLPF(0)) / CellSize(0)));
-			j= (int) (floor((Particles[a]->x(1) - BLPF(1)) / CellSize(1)));
-
-			if (i<0)
-            {
-                    if ((BLPF(0) - Particles[a]->x(0)) <= hmax) i=0;
-                            else std::cout<<"Leaving i<0"<<std::endl;
-            }
-            if (j<0)
-            {
-                    if ((BLPF(1) - Particles[a]->x(1)) <= hmax) j=0;
-                            else std::cout<<"Leaving j<0"<<std::endl;
-            }
-			if (i>=CellNo[0])
+			if (StaticBoundary && !Particles[a]->IsFree) continue;
+			PartCell[a] = ParticleCell(a);
+			Hist[PartCell[a]]++;
+		}
+
+		#pragma omp barrier
+
+		// Offset of each thread inside the cells and the total No of particles of each cell
+		#pragma omp for schedule (static)
+		for (int c=0; c<NCells; c++)
+		{
+			int sum = 0;
+			for (int t=0; t<NT; t++)
 			{
-					if ((Particles[a]->x(0) - TRPR(0)) <= hmax) i=CellNo[0]-1;
-							else std::cout<<"Leaving i>=CellNo"<<std::endl;
+				int temp = CellHist[t*NCells+c];
+				CellHist[t*NCells+c] = sum;
+				sum += temp;
 			}
-            if (j>=CellNo[1])
-            {
-                    if ((Particles[a]->x(1) - TRPR(1)) <= hmax) j=CellNo[1]-1;
-                            else std::cout<<"Leaving j>=CellNo"<<std::endl;
-            }
-
-			temp = HOC[i][j][0];
-			HOC[i][j][0] = a;
-			Particles[a]->LL = temp;
-			Particles[a]->CC[0] = i;
-			Particles[a]->CC[1] = j;
-			Particles[a]->CC[2] = 0;
-			if (!Particles[a]->IsFree) FixedParticles.Push(a);
+			CellCount[c] = sum;
 		}
-		break;
 
-	case 3:
-		for (size_t a=0; a<Particles.Size(); a++)
+		#pragma omp single
 		{
-			i= (int) (floor((Particles[a]->x(0) - BLPF(0)) / CellSize(0)));
-			j= (int) (floor((Particles[a]->x(1) - BLPF(1)) / CellSize(1)));
-			k= (int) (floor((Particles[a]->x(2) - BLPF(2)) / CellSize(2)));
-
-            if (i<0)
-            {
-                    if ((BLPF(0) - Particles[a]->x(0))<=hmax) i=0;
-                            else std::cout<<"Leaving"<<std::endl;
-            }
-            if (j<0)
-            {
-                    if ((BLPF(1) - Particles[a]->x(1))<=hmax) j=0;
-                            else std::cout<<"Leaving"<<std::endl;
-            }
-            if (k<0)
-            {
-                    if ((BLPF(2) - Particles[a]->x(2))<=hmax) k=0;
-                            else std::cout<<"Leaving"<<std::endl;
-            }
-			if (i>=CellNo[0])
+			int sum = 0;
+			for (int c=0; c<NCells; c++)
 			{
-					if ((Particles[a]->x(0) - TRPR(0))<=hmax) i=CellNo[0]-1;
-							else std::cout<<"Leaving"<<std::endl;
+				CellStart[c] = sum;
+				sum += CellCount[c];
 			}
-            if (j>=CellNo[1])
-            {
-                    if ((Particles[a]->x(1) - TRPR(1))<=hmax) j=CellNo[1]-1;
-                            else std::cout<<"Leaving"<<std::endl;
-            }
-            if (k>=CellNo[2])
-            {
-                    if ((Particles[a]->x(2) - TRPR(2))<=hmax) k=CellNo[2]-1;
-                            else std::cout<<"Leaving"<<std::endl;
-            }
-
-            temp = HOC[i][j][k];
-			HOC[i][j][k] = a;
-			Particles[a]->LL = temp;
-			Particles[a]->CC[0] = i;
-			Particles[a]->CC[1] = j;
-			Particles[a]->CC[2] = k;
-			if (!Particles[a]->IsFree) FixedParticles.Push(a);
 		}
-		break;
 
-	default:
-    	std::cout << "Please correct the dimension (2=>2D or 3=>3D) and run again" << std::endl;
-		abort();
-		break;
+		// Particles of a cell are stored with decreasing index, the same order as the old linked list
+		for (int a=First; a<Last; a++)
+		{
+			if (StaticBoundary && !Particles[a]->IsFree) continue;
+			int c = PartCell[a];
+			CellPart[CellStart[c] + CellCount[c] - 1 - Hist[c]] = a;
+			Hist[c]++;
+		}
+	}
+
+	// The fixed particles are only sorted once if they are kept in the static cell list
+	if (StaticBoundary)
+	{
+		if (StaticRebuild) StaticListGenerate();
+	}
+	else
+		for (size_t a=0; a<Particles.Size(); a++)
+			if (!Particles[a]->IsFree) FixedParticles.Push(a);
+
+	PeriodicCells(CellStart, CellCount);
+}
+
+inline void Domain::StaticListGenerate ()
+{
+	int NCells	= CellNo[0]*CellNo[1]*CellNo[2];
+
+	FixedParticles.Clear();
+	for (size_t a=0; a<Particles.Size(); a++)
+		if (!Particles[a]->IsFree) FixedParticles.Push(a);
+
+	int NFixed	= FixedParticles.Size();
+	if (StaticBuffer!=NULL) delete [] StaticBuffer;
+	StaticBuffer	= new int[2*NCells+2*NFixed];
+	StaticStart	= StaticBuffer;
+	StaticCount	= StaticBuffer + NCells;
+	StaticPart	= StaticBuffer + 2*NCells;
+	int * Cell	= StaticBuffer + 2*NCells + NFixed;
+
+	// Counting sort of the fixed particles into the cells, it is only done once so it is serial
+	for (int c=0; c<NCells; c++) StaticCount[c] = 0;
+	for (int n=0; n<NFixed; n++)
+	{
+		Cell[n] = ParticleCell(FixedParticles[n]);
+		StaticCount[Cell[n]]++;
+	}
+
+	int sum = 0;
+	for (int c=0; c<NCells; c++)
+	{
+		StaticStart[c] = sum;
+		sum += StaticCount[c];
+		StaticCount[c] = 0;
+	}
+	for (int n=0; n<NFixed; n++)
+	{
+		StaticPart[StaticStart[Cell[n]] + StaticCount[Cell[n]]] = FixedParticles[n];
+		StaticCount[Cell[n]]++;
 	}
 
+	PeriodicCells(StaticStart, StaticCount);
+	StaticRebuild = false;
+}
+
+inline int Domain::ParticleCell (size_t a)
+{
+	int i= (int) (floor((Particles[a]->x(0) - BLPF(0)) / CellSize(0)));
+	int j= (int) (floor((Particles[a]->x(1) - BLPF(1)) / CellSize(1)));
+	int k= (Dimension == 3) ? (int) (floor((Particles[a]->x(2) - BLPF(2)) / CellSize(2))) : 0;
+
+	if (i<0)
+	{
+		if ((BLPF(0) - Particles[a]->x(0)) <= hmax) i=0;
+			else std::cout<<"Leaving i<0"<<std::endl;
+	}
+	if (j<0)
+	{
+		if ((BLPF(1) - Particles[a]->x(1)) <= hmax) j=0;
+			else std::cout<<"Leaving j<0"<<std::endl;
+	}
+	if (k<0)
+	{
+		if ((BLPF(2) - Particles[a]->x(2)) <= hmax) k=0;
+			else std::cout<<"Leaving k<0"<<std::endl;
+	}
+	if (i>=CellNo[0])
+	{
+		if ((Particles[a]->x(0) - TRPR(0)) <= hmax) i=CellNo[0]-1;
+			else std::cout<<"Leaving i>=CellNo"<<std::endl;
+	}
+	if (j>=CellNo[1])
+	{
+		if ((Particles[a]->x(1) - TRPR(1)) <= hmax) j=CellNo[1]-1;
+			else std::cout<<"Leaving j>=CellNo"<<std::endl;
+	}
+	if (k>=CellNo[2])
+	{
+		if ((Particles[a]->x(2) - TRPR(2)) <= hmax) k=CellNo[2]-1;
+			else std::cout<<"Leaving k>=CellNo"<<std::endl;
+	}
+
+	Particles[a]->CC[0] = i;
+	Particles[a]->CC[1] = j;
+	Particles[a]->CC[2] = k;
+	return CellIndex(i,j,k);
+}
+
+inline void Domain::PeriodicCells (int * Start, int * Count)
+{
+	// Ghost cells of the periodic BC point to the particles of the opposite side
 	if (BC.Periodic[0])
 	{
 	   for(int j =0; j<CellNo[1]; j++)
 	   for(int k =0; k<CellNo[2]; k++)
 	   {
-		  HOC[CellNo[0]-1][j][k] =  HOC[1][j][k];
-		  HOC[CellNo[0]-2][j][k] =  HOC[0][j][k];
+		  Start[CellIndex(CellNo[0]-1,j,k)] = Start[CellIndex(1,j,k)];
+		  Count[CellIndex(CellNo[0]-1,j,k)] = Count[CellIndex(1,j,k)];
+		  Start[CellIndex(CellNo[0]-2,j,k)] = Start[CellIndex(0,j,k)];
+		  Count[CellIndex(CellNo[0]-2,j,k)] = Count[CellIndex(0,j,k)];
 	   }
 	}
 	if (BC.Periodic[1])
@@ -768,8 +951,10 @@ inline void Domain::ListGenerate ()
 	   for(int i =0; i<CellNo[0]; i++)
 	   for(int k =0; k<CellNo[2]; k++)
 	   {
-		  HOC[i][CellNo[1]-1][k] =  HOC[i][1][k];
-		  HOC[i][CellNo[1]-2][k] =  HOC[i][0][k];
+		  Start[CellIndex(i,CellNo[1]-1,k)] = Start[CellIndex(i,1,k)];
+		  Count[CellIndex(i,CellNo[1]-1,k)] = Count[CellIndex(i,1,k)];
+		  Start[CellIndex(i,CellNo[1]-2,k)] = Start[CellIndex(i,0,k)];
+		  Count[CellIndex(i,CellNo[1]-2,k)] = Count[CellIndex(i,0,k)];
 	   }
 	}
 	if (BC.Periodic[2])
@@ -777,213 +962,769 @@ inline void Domain::ListGenerate ()
 	   for(int i =0; i<CellNo[0]; i++)
 	   for(int j =0; j<CellNo[1]; j++)
 	   {
-		  HOC[i][j][CellNo[2]-1] =  HOC[i][j][1];
-		  HOC[i][j][CellNo[2]-2] =  HOC[i][j][0];
+		  Start[CellIndex(i,j,CellNo[2]-1)] = Start[CellIndex(i,j,1)];
+		  Count[CellIndex(i,j,CellNo[2]-1)] = Count[CellIndex(i,j,1)];
+		  Start[CellIndex(i,j,CellNo[2]-2)] = Start[CellIndex(i,j,0)];
+		  Count[CellIndex(i,j,CellNo[2]-2)] = Count[CellIndex(i,j,0)];
 	   }
 	}
 }
 
 inline void Domain::CellReset ()
 {
+	// The cell list is rebuilt from scratch by ListGenerate, the static cell list is kept
+	if (!StaticBoundary) FixedParticles.Clear();
+}
+
+inline int Domain::CellIndex (int i, int j, int k) const
+{
+	return i + CellNo[0]*(j + CellNo[1]*k);
+}
+
+inline void Domain::Reorder ()
+{
+	size_t N = Particles.Size();
+	if (N<2) return;
+
+	// Positions are mapped onto a 2^31 (2D) or 2^21 (3D) grid spanning the domain
+	double Levels = (Dimension == 2) ? 2147483647.0 : 2097151.0;
+	Array< std::pair<unsigned long long,size_t> > Keys(N);
+
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (size_t a=0; a<N; a++)
+	{
+		unsigned int q[3] = {0, 0, 0};
+		for (int d=0; d<Dimension; d++)
+		{
+			double L = TRPR(d) - BLPF(d);
+			if (!(L>0.0)) continue;
+			double f = (Particles[a]->x(d) - BLPF(d))/L;
+			if (f<0.0) f = 0.0;
+			if (f>1.0) f = 1.0;
+			q[d] = (unsigned int) (f*Levels);
+		}
+		Keys[a] = std::make_pair(MortonKey(Dimension, q[0], q[1], q[2]), a);
+	}
+
+	std::sort(Keys.GetPtr(), Keys.GetPtr()+N);
+
+	Array<Particle*>	Old(N);
+	Array<int>				NewIndex(N);
+	for (size_t a=0; a<N; a++) Old[a] = Particles[a];
+	for (size_t a=0; a<N; a++)
+	{
+		Particles[a] = Old[Keys[a].second];
+		NewIndex[Keys[a].second] = a;
+	}
+
+	// Lists of particle indices which are kept between time steps, the fixed particles are listed again by ListGenerate
+	for (size_t i=0; i<BC.InPart.Size(); i++)		BC.InPart[i]		= NewIndex[BC.InPart[i]];
+	for (size_t i=0; i<BC.OutPart.Size(); i++)		BC.OutPart[i]		= NewIndex[BC.OutPart[i]];
+
+	VerletRebuild = true;
+	StaticRebuild = true;
+}
+
+inline void Domain::PinThreads ()
+{
+#ifdef __linux__
+	// An explicit binding of the OpenMP runtime (OMP_PROC_BIND/OMP_PLACES) is kept
+	if (omp_get_proc_bind() != omp_proc_bind_false) return;
+
+	cpu_set_t Allowed;
+	if (sched_getaffinity(0, sizeof(cpu_set_t), &Allowed) != 0) return;
+	Array<int> Cpus;
+	for (int c=0; c<CPU_SETSIZE; c++) if (CPU_ISSET(c, &Allowed)) Cpus.Push(c);
+	if (Cpus.Size()==0) return;
+
+	// The threads are spread over the allowed CPUs in order, so consecutive threads (and the consecutive particle
+	// ranges of the static schedule) share a socket
+	#pragma omp parallel num_threads(Nproc)
+	{
+		size_t T = omp_get_thread_num();
+		cpu_set_t Set;
+		CPU_ZERO(&Set);
+		CPU_SET(Cpus[(T*Cpus.Size())/Nproc], &Set);
+		sched_setaffinity(0, sizeof(cpu_set_t), &Set);
+	}
+#endif
+}
+
+inline void Domain::FirstTouch ()
+{
+	// Each particle is copied by the thread which moves it with the static schedule, the copy is allocated from the
+	// arena of that thread and its pages are touched first on its NUMA node
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (size_t i=0; i<Particles.Size(); i++)
+	{
+		Particle * P = new Particle(*Particles[i]);
+		omp_init_lock(&P->my_lock);
+		omp_destroy_lock(&Particles[i]->my_lock);
+		delete Particles[i];
+		Particles[i] = P;
+	}
+
+	// The packed arrays are reallocated and touched first by the static loop of the next Pack
+	PD.Free();
+}
+
+inline void Domain::NUMAReport ()
+{
+	std::ostringstream oss;
+	if (NRanks>1) oss << "\nRank " << Rank << ":";
+	oss << "\nNUMA placement (thread => CPU, node of the thread and nodes of its particles)\n";
+#ifdef __linux__
+	size_t N = Particles.Size();
+	Array<int> Status(N);
+	Array<void*> Pages(N);
+	long PageSize = sysconf(_SC_PAGESIZE);
+	for (size_t i=0; i<N; i++)
+	{
+		Pages[i]	= (void*)((unsigned long)Particles[i] & ~(unsigned long)(PageSize-1));
+		Status[i]	= -1;
+	}
+	// move_pages without target nodes only returns the node of each page
+	bool Known = (N==0 || syscall(SYS_move_pages, 0, N, Pages.GetPtr(), NULL, Status.GetPtr(), 0) == 0);
+
+	Array<int> Cpu(Nproc), Node(Nproc);
+	#pragma omp parallel num_threads(Nproc)
+	{
+		unsigned int c = 0, n = 0;
+		syscall(SYS_getcpu, &c, &n, NULL);
+		Cpu[omp_get_thread_num()]	= c;
+		Node[omp_get_thread_num()]	= n;
+	}
+
+	for (size_t T=0; T<Nproc; T++)
+	{
+		// Range of the particles of thread T in the static schedule
+		size_t First	= (N/Nproc)*T + std::min(T, N%Nproc);
+		size_t Last	= First + N/Nproc + (T < N%Nproc ? 1 : 0);
+		size_t Local	= 0;
+		for (size_t i=First; i<Last; i++) if (Status[i] == Node[T]) Local++;
+		oss << "Thread " << T << " => CPU " << Cpu[T] << ", node " << Node[T];
+		if (Known && Last>First) oss << ", " << 100.0*Local/(Last-First) << " % of its " << Last-First << " particles on the same node";
+		oss << "\n";
+	}
+	if (!Known) oss << "The nodes of the particle memory are not available (move_pages)\n";
+#else
+	oss << "Not available on this system\n";
+#endif
+	std::cout << oss.str();
+}
+
+inline void Domain::Refine ()
+{
+	size_t NChild	= size_t(1)<<Dimension;
+	size_t N	= Particles.Size();
+
+	// The user criteria is called serially, so it does not have to be thread-safe
+	Array<size_t> Target(N);
+	for (size_t i=0; i<N; i++)
+		Target[i] = std::min(RefineLevel(*this, Particles[i]), RefineMax);
+
+	// Splitting: the particle is replaced by 2^Dimension children at the centres of the sub-cubes of its volume,
+	// each one with the mass / 2^Dimension and h/2, the other properties are copied
+	for (size_t i=0; i<N; i++)
+	{
+		Particle * P = Particles[i];
+		if (Target[i] <= P->Level) continue;
+
+		double dx	= pow(P->Mass/P->Density, 1.0/Dimension);
+		Vec3_t x0	= P->x;
+		P->Mass		/= NChild;
+		P->h		/= 2.0;
+		P->TIInitDist	/= 2.0;
+		P->Level	++;
+		P->Touch();
+		Families.Push(P->Family);
+		P->Family	= Families.Size()-1;
+
+		for (size_t c=0; c<NChild; c++)
+		{
+			Particle * C = P;
+			if (c>0)
+			{
+				C = new Particle(*P);
+				omp_init_lock(&C->my_lock);
+				Particles.Push(C);
+			}
+			C->x = x0 + 0.25*dx*Vec3_t((c&1) ? 1.0 : -1.0, (c&2) ? 1.0 : -1.0, (Dimension == 3) ? ((c&4) ? 1.0 : -1.0) : 0.0);
+		}
+		RefineSplits++;
+	}
+
+	// Merging: the children of a split are merged back if all of them are still there and ask for a coarser level,
+	// mass and momentum are conserved and the other properties are mass weighted averages
+	Array< std::pair<size_t,size_t> > Cand;
+	for (size_t i=0; i<N; i++)
+		if (Particles[i]->Family>0 && Target[i] < Particles[i]->Level) Cand.Push(std::make_pair(Particles[i]->Family, i));
+	std::sort(Cand.GetPtr(), Cand.GetPtr()+Cand.Size());
+
+	size_t Merged = 0;
+	Array<bool> Del(N);
+	for (size_t i=0; i<N; i++) Del[i] = false;
+	for (size_t g=0; g+NChild<=Cand.Size(); g++)
+	{
+		if (Cand[g+NChild-1].first != Cand[g].first || (g>0 && Cand[g-1].first == Cand[g].first)) continue;
+
+		Particle * P = Particles[Cand[g].second];
+		double M = 0.0, Rho = 0.0, Rhoa = 0.0, Rhob = 0.0;
+		Vec3_t X = 0.0, V = 0.0, Va = 0.0, Vb = 0.0;
+		// Solid state n+1 and the history of the scheme (only one of Solida/Solidb is allocated)
+		Sym3_t S, Sh, T, Th, E, Eh;
+		set_to_zero(S);	set_to_zero(Sh);
+		set_to_zero(T);	set_to_zero(Th);
+		set_to_zero(E);	set_to_zero(Eh);
+		for (size_t c=0; c<NChild; c++)
+		{
+			Particle * C = Particles[Cand[g+c].second];
+			double m = C->Mass;
+			// Positions relative to the first child, corrected if the family crosses a periodic boundary
+			Vec3_t d = C->x - P->x;
+			for (size_t k=0; k<3; k++)
+				if (DomSize(k)>0.0 && fabs(d(k))>0.5*DomSize(k)) d(k) -= (d(k)>0.0 ? DomSize(k) : -DomSize(k));
+			M	+= m;
+			X	+= m*d;
+			V	+= m*C->v;	Va	+= m*C->va;	Vb	+= m*C->vb;
+			Rho	+= m*C->Density;	Rhoa	+= m*C->Densitya;	Rhob	+= m*C->Densityb;
+			if (C->Solid != NULL)
+			{
+				StressState const * H = (C->Solida != NULL ? C->Solida : C->Solidb);
+				S	+= m*C->Solid->Sigma;	Sh	+= m*H->Sigma;
+				T	+= m*C->Solid->ShearStress;	Th	+= m*H->ShearStress;
+				E	+= m*C->Solid->Strain;	Eh	+= m*H->Strain;
+			}
+			if (c>0) Del[Cand[g+c].second] = true;
+		}
+		double iM	= 1.0/M;
+		P->x		+= iM*X;
+		P->v		= iM*V;	P->va		= iM*Va;	P->vb		= iM*Vb;
+		P->Density	= iM*Rho;	P->Densitya	= iM*Rhoa;	P->Densityb	= iM*Rhob;
+		if (P->Solid != NULL)
+		{
+			StressState * H = (P->Solida != NULL ? P->Solida : P->Solidb);
+			P->Solid->Sigma		= iM*S;	H->Sigma	= iM*Sh;
+			P->Solid->ShearStress	= iM*T;	H->ShearStress	= iM*Th;
+			P->Solid->Strain	= iM*E;	H->Strain	= iM*Eh;
+		}
+		P->Mass		= M;
+		P->h		*= 2.0;
+		P->TIInitDist	*= 2.0;
+		P->Level	--;
+		P->Touch();
+		P->Family	= Families[P->Family];
+		Merged++;
+		g += NChild-1;
+	}
+
+	// The merged children are deleted and the particle array is compacted in one pass
+	if (Merged>0)
+	{
+		Array<Particle*> Old(Particles);
+		Particles.Resize(Old.Size()-(NChild-1)*Merged);
+		size_t k = 0;
+		for (size_t i=0; i<Old.Size(); i++)
+		{
+			if (i<N && Del[i])
+			{
+				omp_destroy_lock(&Old[i]->my_lock);
+				delete Old[i];
+			}
+			else
+				Particles[k++] = Old[i];
+		}
+	}
+
+	if (Particles.Size()!=N || Merged>0)
+	{
+		VerletRebuild = true;
+		StaticRebuild = true;
+	}
+	RefineMerges += Merged;
+}
+
+inline void Domain::MainNeighbourSearch()
+{
+    // Old Verlet lists are discarded before the new search
+    if (VerletSkin>0.0)
+    	for (size_t i=0 ; i<SMPairs.Size() ; i++)
+    	{
+    		SMPairs[i].Clear();
+    		FSMPairs[i].Clear();
+    		NSMPairs[i].Clear();
+    	}
 
-    #pragma omp parallel for schedule (static) num_threads(Nproc)
-    for(int i =0; i<CellNo[0]; i++)
+    // The non-empty cells are listed in the order of the slab search and split into ranges of equal cost,
+    // the cost of a cell being its particles plus the pairs found in it by the last search
+    int q1b = BC.Periodic[0] ? 1 : 0, q1e = BC.Periodic[0] ? CellNo[0]-1 : CellNo[0];
+    int q2b = BC.Periodic[1] ? 1 : 0, q2e = BC.Periodic[1] ? CellNo[1]-1 : CellNo[1];
+    int q3b = BC.Periodic[2] ? 1 : 0, q3e = BC.Periodic[2] ? CellNo[2]-1 : CellNo[2];
+
+    int NSearch = 0;
+    SearchCost[0] = 0;
+    for (int q1=q1b; q1<q1e; q1++)
+    for (int q3=q3b; q3<q3e; q3++)
+    for (int q2=q2b; q2<q2e; q2++)
     {
-		for(int j =0; j<CellNo[1]; j++)
-		for(int k =0; k<CellNo[2];k++)
+    	int c = CellIndex(q1,q2,q3);
+    	if (CellCount[c]==0) continue;
+    	SearchCells[NSearch]	= c;
+    	SearchCost[NSearch+1]	= SearchCost[NSearch] + CellCount[c] + CellCost[c];
+    	NSearch++;
+    }
+
+    #pragma omp parallel num_threads(Nproc)
+    {
+    	size_t T	= omp_get_thread_num();
+    	size_t NT	= omp_get_num_threads();
+    	long Total	= SearchCost[NSearch];
+    	int Begin	= std::lower_bound(SearchCost, SearchCost+NSearch, int(Total*T/NT))     - SearchCost;
+    	int End		= std::lower_bound(SearchCost, SearchCost+NSearch, int(Total*(T+1)/NT)) - SearchCost;
+    	if (T == NT-1) End = NSearch;
+
+    	for (int n=Begin; n<End; n++)
+    	{
+    		int c = SearchCells[n];
+    		CellNeighbourSearch(c%CellNo[0], (c/CellNo[0])%CellNo[1], c/(CellNo[0]*CellNo[1]), T);
+    	}
+    }
+}
+
+inline void Domain::YZPlaneCellsNeighbourSearch(int q1)
+{
+	int q3,q2;
+	size_t T = omp_get_thread_num();
+
+	for (BC.Periodic[2] ? q3=1 : q3=0;BC.Periodic[2] ? (q3<(CellNo[2]-1)) : (q3<CellNo[2]); q3++)
+	for (BC.Periodic[1] ? q2=1 : q2=0;BC.Periodic[1] ? (q2<(CellNo[1]-1)) : (q2<CellNo[1]); q2++)
+		CellNeighbourSearch(q1, q2, q3, T);
+}
+
+inline void Domain::CellNeighbourSearch(int q1, int q2, int q3, size_t T)
+{
+	int c,c2;
+
+	c = CellIndex(q1,q2,q3);
+	if (CellCount[c]==0) return;
+
+	size_t Found = SMPairs[T].Size() + FSMPairs[T].Size() + NSMPairs[T].Size();
+
+	int temp1, End = CellStart[c] + CellCount[c];
+	for (int a=CellStart[c]; a<End; a++)
+	{
+		temp1 = CellPart[a];
+
+		// The current cell  => self cell interactions
+		for (int b=a+1; b<End; b++)
+			AddPair(temp1, CellPart[b], T);
+
+		// (q1 + 1, q2 , q3)
+		if (q1+1< CellNo[0])
+		{
+			c2 = CellIndex(q1+1,q2,q3);
+			for (int b=CellStart[c2]; b<CellStart[c2]+CellCount[c2]; b++)
+				AddPair(temp1, CellPart[b], T);
+		}
+
+		// (q1 + a, q2 + 1, q3) & a[-1,1]
+		if (q2+1< CellNo[1])
+		{
+			for (int i = q1-1; i <= q1+1; i++)
+			{
+				if (i<CellNo[0] && i>=0)
+				{
+					c2 = CellIndex(i,q2+1,q3);
+					for (int b=CellStart[c2]; b<CellStart[c2]+CellCount[c2]; b++)
+						AddPair(temp1, CellPart[b], T);
+				}
+			}
+		}
+
+		// (q1 + a, q2 + b, q3 + 1) & a,b[-1,1] => all 9 cells above the current cell
+		if (q3+1< CellNo[2])
+		{
+			for (int j=q2-1; j<=q2+1; j++)
+			for (int i=q1-1; i<=q1+1; i++)
+			{
+				if (i<CellNo[0] && i>=0 && j<CellNo[1] && j>=0)
+				{
+					c2 = CellIndex(i,j,q3+1);
+					for (int b=CellStart[c2]; b<CellStart[c2]+CellCount[c2]; b++)
+						AddPair(temp1, CellPart[b], T);
+				}
+			}
+		}
+
+		// Fixed particles of the static cell list in all of the cells around (the cell list has only free particles)
+		if (StaticBoundary)
+		{
+			for (int k=std::max(q3-1,0); k<=std::min(q3+1,CellNo[2]-1); k++)
+			for (int j=std::max(q2-1,0); j<=std::min(q2+1,CellNo[1]-1); j++)
+			for (int i=std::max(q1-1,0); i<=std::min(q1+1,CellNo[0]-1); i++)
+			{
+				c2 = CellIndex(i,j,k);
+				for (int b=StaticStart[c2]; b<StaticStart[c2]+StaticCount[c2]; b++)
+					AddPair(temp1, StaticPart[b], T);
+			}
+		}
+	}
+
+	CellCost[c] = SMPairs[T].Size() + FSMPairs[T].Size() + NSMPairs[T].Size() - Found;
+}
+
+inline void Domain::GatherListGenerate ()
+{
+	int N = Particles.Size();
+
+	if (N+1 > NeighCapacity)
+	{
+		if (NeighStart!=NULL) delete [] NeighStart;
+		if (NeighFill!=NULL)  delete [] NeighFill;
+		NeighCapacity	= N + N/4 + 16;
+		NeighStart	= new int[NeighCapacity];
+		NeighFill	= new int[NeighCapacity];
+	}
+
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (int a=0; a<=N; a++) NeighStart[a] = 0;
+
+	// No of pairs of each particle
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (size_t k=0; k<Nproc; k++)
+	{
+		PairList * Lists[3] = {&SMPairs[k], &FSMPairs[k], &NSMPairs[k]};
+		for (size_t l=0; l<3; l++)
+		for (size_t i=0; i<Lists[l]->Size(); i++)
+		{
+			#pragma omp atomic
+			NeighStart[(*Lists[l])[i].first+1]++;
+			#pragma omp atomic
+			NeighStart[(*Lists[l])[i].second+1]++;
+		}
+	}
+
+	for (int a=0; a<N; a++) NeighStart[a+1] += NeighStart[a];
+
+	if (size_t(NeighStart[N]) > NeighPairsCapacity)
+	{
+		if (NeighPairs!=NULL) delete [] NeighPairs;
+		NeighPairsCapacity	= NeighStart[N] + NeighStart[N]/4 + 16;
+		NeighPairs		= new PairList::Pair_t[NeighPairsCapacity];
+	}
+
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (int a=0; a<N; a++) NeighFill[a] = NeighStart[a];
+
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (size_t k=0; k<Nproc; k++)
+	{
+		PairList * Lists[3] = {&SMPairs[k], &FSMPairs[k], &NSMPairs[k]};
+		int pos;
+		for (size_t l=0; l<3; l++)
+		for (size_t i=0; i<Lists[l]->Size(); i++)
+		{
+			#pragma omp atomic capture
+			pos = NeighFill[(*Lists[l])[i].first]++;
+			NeighPairs[pos] = (*Lists[l])[i];
+			#pragma omp atomic capture
+			pos = NeighFill[(*Lists[l])[i].second]++;
+			NeighPairs[pos] = (*Lists[l])[i];
+		}
+	}
+
+	// Sorting makes the summation order independent of the threads
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (int a=0; a<N; a++)
+		std::sort(NeighPairs+NeighStart[a], NeighPairs+NeighStart[a+1]);
+}
+
+inline void Domain::AddPair(int P1, int P2, size_t T)
+{
+	if (!(Particles[P1]->IsFree || Particles[P2]->IsFree)) return;
+	if (Particles[P1]->Sleeping && Particles[P2]->Sleeping) return;
+	// Pairs of two ghosts (MPI halo) are computed by their owners
+	int NOwned = Particles.Size() - NGhost;
+	if (P1 >= NOwned && P2 >= NOwned) return;
+
+	// Verlet lists only keep the pairs within the kernel support plus the skin distance
+	if (VerletSkin>0.0)
+	{
+		Vec3_t xij	= Particles[P1]->x - Particles[P2]->x;
+		double h	= std::max(Particles[P1]->h,Particles[P2]->h);
+		Periodic_X_Correction(xij, h, Particles[P1], Particles[P2]);
+		if (norm(xij) > (Cellfac*h + VerletSkin)) return;
+	}
+
+	if (Particles[P1]->Material == Particles[P2]->Material)
+	{
+		if (Particles[P1]->IsFree*Particles[P2]->IsFree)
+			SMPairs[T].Push(P1, P2);
+		else
+			FSMPairs[T].Push(P1, P2);
+	}
+	else
+		NSMPairs[T].Push(P1, P2);
+}
+
+inline bool Domain::VerletCheck()
+{
+	if (VerletRebuild || VerletX.Size()!=Particles.Size()) return true;
+
+	// Max displacement of particles since the last neighbour search
+	double MaxDisp = 0.0;
+	#pragma omp parallel for schedule (static) num_threads(Nproc) reduction(max:MaxDisp)
+	for (size_t i=0; i<Particles.Size(); i++)
+	{
+		double disp = norm(Particles[i]->x - VerletX[i]);
+		if (disp > MaxDisp) MaxDisp = disp;
+	}
+
+	return (MaxDisp > 0.5*VerletSkin);
+}
+
+inline void Domain::VerletRecord()
+{
+	VerletX.Resize(Particles.Size());
+
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (size_t i=0; i<Particles.Size(); i++)
+		VerletX[i] = Particles[i]->x;
+
+	VerletRebuild = false;
+	VerletBuilds++;
+}
+
+inline void Domain::PairSlice (size_t N, size_t T, size_t & Begin, size_t & End) const
+{
+	// Each thread takes an equal part of every pair list, whichever thread found the pairs
+	Begin	= N*T/Nproc;
+	End	= N*(T+1)/Nproc;
+}
+
+inline void Domain::BlockActivate ()
+{
+	// A particle of bin b is integrated every 2^(TimeBins-b) sub-steps, all of them at the first sub-step
+	size_t NSub	= size_t(1)<<TimeBins;
+	size_t Updates	= 0;
+	size_t Free	= 0;
+
+	#pragma omp parallel for schedule (static) num_threads(Nproc) reduction(+:Updates,Free)
+	for (size_t i=0; i<Particles.Size(); i++)
+	{
+		Particle * P	= Particles[i];
+		if (P->TimeBin > TimeBins) P->TimeBin = TimeBins;
+		P->Active	= P->IsFree && !P->Sleeping && (TimeSub % (NSub>>P->TimeBin)) == 0;
+		if (P->Active) Updates++;
+		if (P->IsFree) Free++;
+	}
+
+	BlockUpdates		+= Updates;
+	BlockFullUpdates	+= Free;
+}
+
+inline void Domain::BlockMove ()
+{
+	size_t NSub = size_t(1)<<TimeBins;
+
+	// Time step limit of the particles which have new accelerations
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (size_t i=0; i<Particles.Size(); i++)
+		if (Particles[i]->Active) Particles[i]->dtLimit = TimeStepLimit(Particles[i]);
+
+	// The base step only changes when all particles are synchronised, the smallest limit sets the finest bin
+	if (TimeSub == 0)
+	{
+		double Min = (CFLFactor>0.0) ? std::numeric_limits<double>::max() : deltatint;
+		#pragma omp parallel for schedule (static) num_threads(Nproc) reduction(min:Min)
+		for (size_t i=0; i<Particles.Size(); i++)
+			if (Particles[i]->IsFree && Particles[i]->dtLimit < Min) Min = Particles[i]->dtLimit;
+		deltatmin = (Min < std::numeric_limits<double>::max()) ? NSub*Min : deltatint;
+		AdaptiveTimeStep();
+	}
+
+	// Smallest bin which satisfies the limit, a particle only goes to a larger step at a sub-step which is a multiple of it
+	size_t MaxBin = 0;
+	#pragma omp parallel for schedule (static) num_threads(Nproc) reduction(max:MaxBin)
+	for (size_t i=0; i<Particles.Size(); i++)
+	{
+		Particle * P = Particles[i];
+		if (!P->IsFree) continue;
+		if (P->Active)
 		{
-			HOC[i][j][k] = -1;
+			size_t Bin = 0;
+			while (Bin<TimeBins && deltat/(size_t(1)<<Bin) > P->dtLimit) Bin++;
+			while (Bin<P->TimeBin && (TimeSub % (NSub>>Bin)) != 0) Bin++;
+			P->TimeBin = Bin;
 		}
-    }
+		if (P->TimeBin > MaxBin) MaxBin = P->TimeBin;
+	}
 
-    #pragma omp parallel for schedule (static) num_threads(Nproc)
-    for (size_t a=0; a<Particles.Size(); a++)
-    {
-    	Particles[a]->LL = -1;
-    }
+	Move(deltat/NSub);
 
-    FixedParticles.Clear();
+	// The sub-steps without active particles are skipped, the finest bin in use is active at every multiple of its step
+	size_t Stride	= NSub>>MaxBin;
+	size_t Next	= (TimeSub/Stride+1)*Stride;
+	Time	+= (Next-TimeSub)*deltat/NSub;
+	TimeSub	 = Next % NSub;
 }
 
-inline void Domain::MainNeighbourSearch()
+inline bool Domain::Quiet (Particle const * P) const
 {
-    int q1;
-
-    if (BC.Periodic[0])
-    {
-	#pragma omp parallel for schedule (dynamic) num_threads(Nproc)
-	for (q1=1;q1<(CellNo[0]-1); q1++)	YZPlaneCellsNeighbourSearch(q1);
-    }
-    else
-    {
-	#pragma omp parallel for schedule (dynamic) num_threads(Nproc)
-    	for (q1=0;q1<CellNo[0]; q1++)	YZPlaneCellsNeighbourSearch(q1);
-    }
+	double D2 = DoubleDot(P->StrainRate,P->StrainRate);
+	return norm(P->v) < SleepVelocity && norm(P->a) < SleepAcceleration && D2 < SleepStrainRate*SleepStrainRate;
 }
 
-inline void Domain::YZPlaneCellsNeighbourSearch(int q1)
+inline void Domain::SleepCheck ()
 {
-	int q3,q2;
-	size_t T = omp_get_thread_num();
-
-	for (BC.Periodic[2] ? q3=1 : q3=0;BC.Periodic[2] ? (q3<(CellNo[2]-1)) : (q3<CellNo[2]); q3++)
-	for (BC.Periodic[1] ? q2=1 : q2=0;BC.Periodic[1] ? (q2<(CellNo[1]-1)) : (q2<CellNo[1]); q2++)
+	// A sleeping particle is woken if a neighbour which is awake moves faster than the threshold. Several threads
+	// may mark the same particle, so the pairs only set its wake flag, which is applied by the particle loop below
+	// (the particles woken in this pass do not wake their own neighbours)
+	SleepWake.Resize(Particles.Size());
+	SleepWake.SetValues(0);
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (size_t t=0; t<Nproc; t++)
+	for (size_t k=0; k<Nproc; k++)
 	{
-		if (HOC[q1][q2][q3]==-1) continue;
-		else
+		size_t Begin, End;
+		PairList * Lists[3] = {&SMPairs[k], &FSMPairs[k], &NSMPairs[k]};
+		for (size_t l=0; l<3; l++)
 		{
-			int temp1, temp2;
-			temp1 = HOC[q1][q2][q3];
-
-			while (temp1 != -1)
+			PairSlice(Lists[l]->Size(), t, Begin, End);
+			for (size_t a=Begin; a<End; a++)
 			{
-				// The current cell  => self cell interactions
-				temp2 = Particles[temp1]->LL;
-				while (temp2 != -1)
+				size_t i = (*Lists[l])[a].first;
+				size_t j = (*Lists[l])[a].second;
+				if (Particles[i]->Sleeping == Particles[j]->Sleeping) continue;
+				if (Particles[i]->Sleeping) std::swap(i,j);
+				if (norm(Particles[i]->v) > SleepVelocity)
 				{
-					if (Particles[temp1]->IsFree || Particles[temp2]->IsFree)
-					{
-						if (Particles[temp1]->Material == Particles[temp2]->Material)
-						{
-							if (Particles[temp1]->IsFree*Particles[temp2]->IsFree)
-								SMPairs[T].Push(std::make_pair(temp1, temp2));
-							else
-								FSMPairs[T].Push(std::make_pair(temp1, temp2));
-
-						}
-						else
-							NSMPairs[T].Push(std::make_pair(temp1, temp2));
-					}
-					temp2 = Particles[temp2]->LL;
+					#pragma omp atomic write
+					SleepWake[j] = 1;
 				}
+			}
+		}
+	}
 
-				// (q1 + 1, q2 , q3)
-				if (q1+1< CellNo[0])
-				{
-					temp2 = HOC[q1+1][q2][q3];
-					while (temp2 != -1)
-					{
-						if (Particles[temp1]->IsFree || Particles[temp2]->IsFree)
-						{
-							if (Particles[temp1]->Material == Particles[temp2]->Material)
-							{
-								if (Particles[temp1]->IsFree*Particles[temp2]->IsFree)
-									SMPairs[T].Push(std::make_pair(temp1, temp2));
-								else
-									FSMPairs[T].Push(std::make_pair(temp1, temp2));
+	size_t Sleeping	= 0;
+	size_t Free	= 0;
+	size_t Changed	= 0;
+	#pragma omp parallel for schedule (static) num_threads(Nproc) reduction(+:Sleeping,Free,Changed)
+	for (size_t i=0; i<Particles.Size(); i++)
+	{
+		Particle * P = Particles[i];
+		if (!P->IsFree) continue;
+		Free++;
+		if (P->Sleeping)
+		{
+			if (SleepWake[i])
+			{
+				// The rates only have the contributions of the particles which are awake, the particle rests for this step
+				P->Sleeping	= false;
+				P->Active	= (TimeBins == 0);
+				P->a		= 0.0;
+				P->dDensity	= 0.0;
+				set_to_zero(P->StrainRate);
+				if (P->Solid != NULL) set_to_zero(P->Solid->RotationRate);
+				P->QuietSteps	= 0;
+				Changed++;
+			}
+			else
+				Sleeping++;
+		}
+		else if (P->Material > 1 && P->Active)
+		{
+			if (Quiet(P)) P->QuietSteps++; else P->QuietSteps = 0;
+			if (P->QuietSteps >= SleepSteps)
+			{
+				P->Sleeping	= true;
+				P->Active	= false;
+				Sleeping++;
+				Changed++;
+			}
+		}
+	}
 
-							}
-							else
-								NSMPairs[T].Push(std::make_pair(temp1, temp2));
-						}
-						temp2 = Particles[temp2]->LL;
-					}
-				}
+	SleepUpdates		+= Sleeping;
+	SleepFullUpdates	+= Free;
 
-				// (q1 + a, q2 + 1, q3) & a[-1,1]
-				if (q2+1< CellNo[1])
-				{
-					for (int i = q1-1; i <= q1+1; i++)
-					{
-						if (i<CellNo[0] && i>=0)
-						{
-							temp2 = HOC[i][q2+1][q3];
-							while (temp2 != -1)
-							{
-								if (Particles[temp1]->IsFree || Particles[temp2]->IsFree)
-								{
-									if (Particles[temp1]->Material == Particles[temp2]->Material)
-									{
-										if (Particles[temp1]->IsFree*Particles[temp2]->IsFree)
-											SMPairs[T].Push(std::make_pair(temp1, temp2));
-										else
-											FSMPairs[T].Push(std::make_pair(temp1, temp2));
-
-									}
-									else
-										NSMPairs[T].Push(std::make_pair(temp1, temp2));
-								}
-								temp2 = Particles[temp2]->LL;
-							}
-						}
-					}
-				}
+	// The pairs of the sleeping particles have changed
+	if (Changed>0) VerletRebuild = true;
+}
 
-				// (q1 + a, q2 + b, q3 + 1) & a,b[-1,1] => all 9 cells above the current cell
-				if (q3+1< CellNo[2])
-				{
-					for (int j=q2-1; j<=q2+1; j++)
-					for (int i=q1-1; i<=q1+1; i++)
-					{
-						if (i<CellNo[0] && i>=0 && j<CellNo[1] && j>=0)
-						{
-							temp2 = HOC[i][j][q3+1];
-							while (temp2 != -1)
-							{
-								if (Particles[temp1]->IsFree || Particles[temp2]->IsFree)
-								{
-									if (Particles[temp1]->Material == Particles[temp2]->Material)
-									{
-										if (Particles[temp1]->IsFree*Particles[temp2]->IsFree)
-											SMPairs[T].Push(std::make_pair(temp1, temp2));
-										else
-											FSMPairs[T].Push(std::make_pair(temp1, temp2));
-
-									}
-									else
-										NSMPairs[T].Push(std::make_pair(temp1, temp2));
-								}
-								temp2 = Particles[temp2]->LL;
-							}
-						}
-					}
-				}
-				temp1 = Particles[temp1]->LL;
-			}
+inline void Domain::TensileInstability3D (bool Fixed)
+{
+	// The stresses of the soil/solid particles with tensile instability are gathered in blocks, the artificial
+	// stress is computed by TensileInstabilityR (SIMD loop) and scattered back to TIR
+	const size_t B = 64;
+	size_t N = Fixed ? FixedParticles.Size() : Particles.Size();
+
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (size_t b=0; b<N; b+=B)
+	{
+		size_t	Idx[B];
+		double	S00[B], S11[B], S22[B], S01[B], S02[B], S12[B], F[B];
+		double	R00[B], R11[B], R22[B], R01[B], R02[B], R12[B];
+
+		// Gather
+		size_t m = 0;
+		for (size_t n=b; n<std::min(b+B, N); n++)
+		{
+			size_t i = Fixed ? FixedParticles[n] : n;
+			Particle * P = Particles[i];
+			if (P->Material < 2 || !(Materials[P->MatID].TI > 0.0)) continue;
+			if (Fixed ? (P->SumKernel == 0.0) : !P->IsFree) continue;
+			Idx[m]	= i;
+			Sym3_t const & Sig = P->Solid->Sigma;
+			S00[m]	= Sig(0,0);	S11[m]	= Sig(1,1);	S22[m]	= Sig(2,2);
+			S01[m]	= Sig(0,1);	S02[m]	= Sig(0,2);	S12[m]	= Sig(1,2);
+			F[m]	= Materials[P->MatID].TI/(P->Density*P->Density);
+			m++;
+		}
+
+		TensileInstabilityR(m, S00, S11, S22, S01, S02, S12, F, R00, R11, R22, R01, R02, R12);
+
+		// Scatter
+		for (size_t k=0; k<m; k++)
+		{
+			Sym3_t & R = Particles[Idx[k]]->Solid->TIR;
+			R(0,0) = R00[k];	R(1,1) = R11[k];	R(2,2) = R22[k];
+			R(0,1) = R01[k];	R(0,2) = R02[k];	R(1,2) = R12[k];
 		}
 	}
 }
 
 inline void Domain::StartAcceleration (Vec3_t const & a)
 {
+	if (Dimension == 3) TensileInstability3D(false);
+
 	#pragma omp parallel for schedule (static) num_threads(Nproc)
 	for (size_t i=0; i<Particles.Size(); i++)
 	{
 	    	if (Particles[i]->IsFree)
     		{
 			// Tensile Instability for all soil and solid particles
-			if (Particles[i]->Material > 1 && Particles[i]->TI > 0.0)
+			if (Particles[i]->Material > 1 && Materials[Particles[i]->MatID].TI > 0.0)
         		{
-				// XY plane must be used, It is very slow in 3D
+				// Principal stresses in the XY plane, the 3D case is computed in blocks by TensileInstability3D
 				if (Dimension == 2)
 				{
 					double teta, Sigmaxx, Sigmayy, C, S;
 
-					if ((Particles[i]->Sigma(0,0)-Particles[i]->Sigma(1,1))!=0.0)
-						teta = 0.5*atan(2.0*Particles[i]->Sigma(0,1)/(Particles[i]->Sigma(0,0)-Particles[i]->Sigma(1,1)));
+					if ((Particles[i]->Solid->Sigma(0,0)-Particles[i]->Solid->Sigma(1,1))!=0.0)
+						teta = 0.5*atan(2.0*Particles[i]->Solid->Sigma(0,1)/(Particles[i]->Solid->Sigma(0,0)-Particles[i]->Solid->Sigma(1,1)));
 					else
 						teta = M_PI/4.0;
 
 					C = cos(teta);
 					S = sin(teta);
-					Sigmaxx = C*C*Particles[i]->Sigma(0,0) + 2.0*C*S*Particles[i]->Sigma(0,1) + S*S*Particles[i]->Sigma(1,1);
-					Sigmayy = S*S*Particles[i]->Sigma(0,0) - 2.0*C*S*Particles[i]->Sigma(0,1) + C*C*Particles[i]->Sigma(1,1);
-					if (Sigmaxx>0) Sigmaxx = -Particles[i]->TI * Sigmaxx/(Particles[i]->Density*Particles[i]->Density); else Sigmaxx = 0.0;
-					if (Sigmayy>0) Sigmayy = -Particles[i]->TI * Sigmayy/(Particles[i]->Density*Particles[i]->Density); else Sigmayy = 0.0;
-					Particles[i]->TIR(0,0) = C*C*Sigmaxx + S*S*Sigmayy;
-					Particles[i]->TIR(1,1) = S*S*Sigmaxx + C*C*Sigmayy;
-					Particles[i]->TIR(0,1) = Particles[i]->TIR(1,0) = S*C*(Sigmaxx-Sigmayy);
-				}
-				else
-				{
-					Mat3_t Vec,Val,VecT,temp;
-
-					Rotation(Particles[i]->Sigma,Vec,VecT,Val);
-					if (Val(0,0)>0) Val(0,0) = -Particles[i]->TI * Val(0,0)/(Particles[i]->Density*Particles[i]->Density); else Val(0,0) = 0.0;
-					if (Val(1,1)>0) Val(1,1) = -Particles[i]->TI * Val(1,1)/(Particles[i]->Density*Particles[i]->Density); else Val(1,1) = 0.0;
-					if (Val(2,2)>0) Val(2,2) = -Particles[i]->TI * Val(2,2)/(Particles[i]->Density*Particles[i]->Density); else Val(2,2) = 0.0;
-					Mult(Vec,Val,temp);
-					Mult(temp,VecT,Particles[i]->TIR);
+					Sigmaxx = C*C*Particles[i]->Solid->Sigma(0,0) + 2.0*C*S*Particles[i]->Solid->Sigma(0,1) + S*S*Particles[i]->Solid->Sigma(1,1);
+					Sigmayy = S*S*Particles[i]->Solid->Sigma(0,0) - 2.0*C*S*Particles[i]->Solid->Sigma(0,1) + C*C*Particles[i]->Solid->Sigma(1,1);
+					if (Sigmaxx>0) Sigmaxx = -Materials[Particles[i]->MatID].TI * Sigmaxx/(Particles[i]->Density*Particles[i]->Density); else Sigmaxx = 0.0;
+					if (Sigmayy>0) Sigmayy = -Materials[Particles[i]->MatID].TI * Sigmayy/(Particles[i]->Density*Particles[i]->Density); else Sigmayy = 0.0;
+					Particles[i]->Solid->TIR(0,0) = C*C*Sigmaxx + S*S*Sigmayy;
+					Particles[i]->Solid->TIR(1,1) = S*S*Sigmaxx + C*C*Sigmayy;
+					Particles[i]->Solid->TIR(0,1) = S*C*(Sigmaxx-Sigmayy);
 				}
 			}
 	    	}
@@ -992,8 +1733,11 @@ inline void Domain::StartAcceleration (Vec3_t const & a)
 	       		// Reset the pressure and the induced velocity for solid boundaries
 	    		Particles[i]->NSv = 0.0;
 	    		Particles[i]->Pressure = 0.0;
-	        	set_to_zero(Particles[i]->Sigma);
-	        	set_to_zero(Particles[i]->ShearStress);
+			if (Particles[i]->Solid != NULL)
+			{
+				set_to_zero(Particles[i]->Solid->Sigma);
+				set_to_zero(Particles[i]->Solid->ShearStress);
+			}
 	    	}
 
 
@@ -1012,38 +1756,77 @@ inline void Domain::StartAcceleration (Vec3_t const & a)
 //	        set_to_zero(Particles[i]->FSISigma);
 		if (Dimension == 2) Particles[i]->v(2) = 0.0;
 		set_to_zero(Particles[i]->StrainRate);
-		set_to_zero(Particles[i]->RotationRate);
+		if (Particles[i]->Solid != NULL) set_to_zero(Particles[i]->Solid->RotationRate);
 		Particles[i]->S		= 0.0;
 	}
 }
 
-inline void Domain::PrimaryComputeAcceleration ()
+template <typename KP> inline void Domain::PairGeometry (size_t P1, size_t P2, KP const & Ker, PairGeom & G)
+{
+	// The distance is computed in double from the positions, only the result is stored as Real_t
+	double h	= (Particles[P1]->h+Particles[P2]->h)/2.0;
+	Vec3_t xij	= Particles[P1]->x - Particles[P2]->x;
+
+	Periodic_X_Correction(xij, h, Particles[P1], Particles[P2]);
+
+	double rij	= norm(xij);
+	G.xij[0]	= xij(0);
+	G.xij[1]	= xij(1);
+	G.xij[2]	= xij(2);
+	G.rij		= rij;
+	G.W		= Ker.Kernel(rij/h, h);
+	G.GK		= Ker.GradKernel(rij/h, h);
+}
+
+template <typename KP> inline void Domain::PairGeometry (KP const & Ker)
+{
+	// The fixed particle pairs are used by both PrimaryComputeAcceleration and CalcForce, the other
+	// same material pairs only by CalcForce which computes the geometry itself in gather mode
+	#pragma omp parallel for schedule (static) num_threads(Nproc)
+	for (size_t t=0; t<Nproc; t++)
+	for (size_t k=0; k<Nproc; k++)
+	{
+		size_t Begin, End;
+		PairSlice(FSMPairs[k].Size(), t, Begin, End);
+		for (size_t a=Begin; a<End; a++)
+			PairGeometry(FSMPairs[k][a].first, FSMPairs[k][a].second, Ker, FSMPairs[k].Geom(a));
+
+		if (InteractionMode == Gather_Mode) continue;
+
+		PairSlice(SMPairs[k].Size(), t, Begin, End);
+		for (size_t a=Begin; a<End; a++)
+			PairGeometry(SMPairs[k][a].first, SMPairs[k][a].second, Ker, SMPairs[k].Geom(a));
+	}
+}
+
+template <typename KP> inline void Domain::PairSums (KP const & Ker)
 {
+	// The geometry of the same material pairs is computed here once and reused by LastComputeAcceleration
+	PairGeometry(Ker);
+
 	#pragma omp parallel for schedule (static) num_threads(Nproc)
-	for (size_t k=0; k<Nproc;k++)
+	for (size_t t=0; t<Nproc; t++)
+	for (size_t k=0; k<Nproc; k++)
 	{
-		size_t P1,P2;
+		size_t P1,P2,Begin,End;
 		Vec3_t xij;
 		double h,K;
-		// Summing the smoothed pressure, velocity and stress for fixed particles from neighbour particles
-		for (size_t a=0; a<FSMPairs[k].Size();a++)
+		// Summing the smoothed pressure, velocity and stress for fixed particles from neighbour particles, the hydrostatic
+		// term of the pressure uses the distance from the neighbour to the fixed particle: xij for P1 and -xij for P2
+		PairSlice(FSMPairs[k].Size(), t, Begin, End);
+		for (size_t a=Begin; a<End; a++)
 		{
 			P1	= FSMPairs[k][a].first;
 			P2	= FSMPairs[k][a].second;
-			xij	= Particles[P1]->x-Particles[P2]->x;
-			h	= (Particles[P1]->h+Particles[P2]->h)/2.0;
-
-			Periodic_X_Correction(xij, h, Particles[P1], Particles[P2]);
-
-
-			K	= Kernel(Dimension, KernelType, norm(xij)/h, h);
+			xij	= FSMPairs[k].Geom(a).Xij();
+			K	= FSMPairs[k].Geom(a).W;
 
 			if (!Particles[P1]->IsFree)
 			{
 				omp_set_lock(&Particles[P1]->my_lock);
 										Particles[P1]->SumKernel+= K;
 					if (Particles[P1]->Material < 3)	Particles[P1]->Pressure	+= Particles[P2]->Pressure * K + dot(Gravity,xij)*Particles[P2]->Density*K;
-					if (Particles[P1]->Material > 1)	Particles[P1]->Sigma 	 = Particles[P1]->Sigma + K * Particles[P2]->Sigma;
+					if (Particles[P1]->Material > 1 && Particles[P2]->Material > 1)	Particles[P1]->Solid->Sigma	+= K * Particles[P2]->Solid->Sigma;
 					if (Particles[P1]->NoSlip)		Particles[P1]->NSv 	+= Particles[P2]->v * K;
 				omp_unset_lock(&Particles[P1]->my_lock);
 			}
@@ -1051,15 +1834,16 @@ inline void Domain::PrimaryComputeAcceleration ()
 			{
 				omp_set_lock(&Particles[P2]->my_lock);
 										Particles[P2]->SumKernel+= K;
-					if (Particles[P2]->Material < 3)	Particles[P2]->Pressure	+= Particles[P1]->Pressure * K + dot(Gravity,xij)*Particles[P1]->Density*K;
-					if (Particles[P2]->Material > 1)	Particles[P2]->Sigma	 = Particles[P2]->Sigma + K * Particles[P1]->Sigma;
+					if (Particles[P2]->Material < 3)	Particles[P2]->Pressure	+= Particles[P1]->Pressure * K - dot(Gravity,xij)*Particles[P1]->Density*K;
+					if (Particles[P2]->Material > 1 && Particles[P1]->Material > 1)	Particles[P2]->Solid->Sigma	+= K * Particles[P1]->Solid->Sigma;
 					if (Particles[P2]->NoSlip)		Particles[P2]->NSv 	+= Particles[P1]->v * K;
 				omp_unset_lock(&Particles[P2]->my_lock);
 			}
 		}
+		PairSlice(NSMPairs[k].Size(), t, Begin, End);
 		if (SWIType != 2)
 		{
-			for (size_t a=0; a<NSMPairs[k].Size();a++)
+			for (size_t a=Begin; a<End; a++)
 			{
 				P1 = NSMPairs[k][a].first;
 				P2 = NSMPairs[k][a].second;
@@ -1089,7 +1873,7 @@ inline void Domain::PrimaryComputeAcceleration ()
 		}
 		if (FSI)
 		{
-			for (size_t a=0; a<NSMPairs[k].Size();a++)
+			for (size_t a=Begin; a<End; a++)
 			{
 				P1 = NSMPairs[k][a].first;
 				P2 = NSMPairs[k][a].second;
@@ -1101,7 +1885,7 @@ inline void Domain::PrimaryComputeAcceleration ()
 
 					Periodic_X_Correction(xij, h, Particles[P1], Particles[P2]);
 
-					K	= Kernel(Dimension, KernelType, norm(xij)/h, h);
+					K	= Ker.Kernel(norm(xij)/h, h);
 
 					if (Particles[P1]->Material == 1)
 					{
@@ -1112,7 +1896,7 @@ inline void Domain::PrimaryComputeAcceleration ()
 						omp_set_lock(&Particles[P2]->my_lock);
 							Particles[P2]->FSISumKernel	+= K;
 							Particles[P2]->NSv 		+= Particles[P1]->v * K;
-							Particles[P2]->FSIPressure	+= Particles[P1]->Pressure * K + dot(Gravity,xij)*Particles[P1]->Density*K;
+							Particles[P2]->FSIPressure	+= Particles[P1]->Pressure * K - dot(Gravity,xij)*Particles[P1]->Density*K;
 						omp_unset_lock(&Particles[P2]->my_lock);
 
 //						Particles[P1]->FSISumKernel	+= K;
@@ -1143,6 +1927,28 @@ inline void Domain::PrimaryComputeAcceleration ()
 		}
 
 	}
+}
+
+inline void Domain::PrimaryComputeAcceleration ()
+{
+	// The pair sums are instantiated on the selected kernel
+	if (KernelTableSize>0)
+		PairSums(KernelTable);
+	else
+	{
+		switch (KernelType)
+		{
+			case 0:
+				if (Dimension == 2) PairSums(QubicSplineKernel<2>()); else PairSums(QubicSplineKernel<3>());
+				break;
+			case 1:
+				if (Dimension == 2) PairSums(QuinticKernel<2>()); else PairSums(QuinticKernel<3>());
+				break;
+			case 2:
+				if (Dimension == 2) PairSums(QuinticSplineKernel<2>()); else PairSums(QuinticSplineKernel<3>());
+				break;
+		}
+	}
 
 	if (FSI)
 	{
@@ -1167,43 +1973,34 @@ inline void Domain::PrimaryComputeAcceleration ()
 		{
 			size_t a = FixedParticles[i];
 			if (Particles[a]->Material < 3)	Particles[a]->Pressure	= Particles[a]->Pressure/Particles[a]->SumKernel;
-			if (Particles[a]->Material > 1) Particles[a]->Sigma	= 1.0/Particles[a]->SumKernel*Particles[a]->Sigma;
+			if (Particles[a]->Material > 1) Particles[a]->Solid->Sigma	*= 1.0/Particles[a]->SumKernel;
 			if (Particles[a]->NoSlip)	Particles[a]->NSv	= Particles[a]->NSv/Particles[a]->SumKernel;
 
 			// Tensile Instability for fixed soil and solid particles
-			if (Particles[a]->Material > 1 && Particles[a]->TI > 0.0)
+			if (Particles[a]->Material > 1 && Materials[Particles[a]->MatID].TI > 0.0)
 			{
-				// XY plane must be used, It is very slow in 3D
+				// Principal stresses in the XY plane, the 3D case is computed in blocks by TensileInstability3D
 				if (Dimension == 2)
 				{
 					double teta, Sigmaxx, Sigmayy, C, S;
-					if ((Particles[a]->Sigma(0,0)-Particles[a]->Sigma(1,1))!=0.0)
-						teta = 0.5*atan(2.0*Particles[a]->Sigma(0,1)/(Particles[a]->Sigma(0,0)-Particles[a]->Sigma(1,1)));
+					if ((Particles[a]->Solid->Sigma(0,0)-Particles[a]->Solid->Sigma(1,1))!=0.0)
+						teta = 0.5*atan(2.0*Particles[a]->Solid->Sigma(0,1)/(Particles[a]->Solid->Sigma(0,0)-Particles[a]->Solid->Sigma(1,1)));
 					else
 						teta = M_PI/4.0;
 
 					C = cos(teta);
 					S = sin(teta);
-					Sigmaxx = C*C*Particles[a]->Sigma(0,0) + 2.0*C*S*Particles[a]->Sigma(0,1) + S*S*Particles[a]->Sigma(1,1);
-					Sigmayy = S*S*Particles[a]->Sigma(0,0) - 2.0*C*S*Particles[a]->Sigma(0,1) + C*C*Particles[a]->Sigma(1,1);
-					if (Sigmaxx>0) Sigmaxx = -Particles[a]->TI * Sigmaxx/(Particles[a]->Density*Particles[a]->Density); else Sigmaxx = 0.0;
-					if (Sigmayy>0) Sigmayy = -Particles[a]->TI * Sigmayy/(Particles[a]->Density*Particles[a]->Density); else Sigmayy = 0.0;
-					Particles[a]->TIR(0,0) = C*C*Sigmaxx + S*S*Sigmayy;
-					Particles[a]->TIR(1,1) = S*S*Sigmaxx + C*C*Sigmayy;
-					Particles[a]->TIR(0,1) = Particles[a]->TIR(1,0) = S*C*(Sigmaxx-Sigmayy);
-				}
-				else
-				{
-					Mat3_t Vec,Val,VecT,temp;
-					Rotation(Particles[a]->Sigma,Vec,VecT,Val);
-					if (Val(0,0)>0) Val(0,0) = -Particles[a]->TI * Val(0,0)/(Particles[a]->Density*Particles[a]->Density); else Val(0,0) = 0.0;
-					if (Val(1,1)>0) Val(1,1) = -Particles[a]->TI * Val(1,1)/(Particles[a]->Density*Particles[a]->Density); else Val(1,1) = 0.0;
-					if (Val(2,2)>0) Val(2,2) = -Particles[a]->TI * Val(2,2)/(Particles[a]->Density*Particles[a]->Density); else Val(2,2) = 0.0;
-					Mult(Vec,Val,temp);
-					Mult(temp,VecT,Particles[a]->TIR);
+					Sigmaxx = C*C*Particles[a]->Solid->Sigma(0,0) + 2.0*C*S*Particles[a]->Solid->Sigma(0,1) + S*S*Particles[a]->Solid->Sigma(1,1);
+					Sigmayy = S*S*Particles[a]->Solid->Sigma(0,0) - 2.0*C*S*Particles[a]->Solid->Sigma(0,1) + C*C*Particles[a]->Solid->Sigma(1,1);
+					if (Sigmaxx>0) Sigmaxx = -Materials[Particles[a]->MatID].TI * Sigmaxx/(Particles[a]->Density*Particles[a]->Density); else Sigmaxx = 0.0;
+					if (Sigmayy>0) Sigmayy = -Materials[Particles[a]->MatID].TI * Sigmayy/(Particles[a]->Density*Particles[a]->Density); else Sigmayy = 0.0;
+					Particles[a]->Solid->TIR(0,0) = C*C*Sigmaxx + S*S*Sigmayy;
+					Particles[a]->Solid->TIR(1,1) = S*S*Sigmaxx + C*C*Sigmayy;
+					Particles[a]->Solid->TIR(0,1) = S*C*(Sigmaxx-Sigmayy);
 				}
 			}
 		}
+	if (Dimension == 3) TensileInstability3D(true);
 
 
 	if (SWIType != 2)
@@ -1213,20 +2010,21 @@ inline void Domain::PrimaryComputeAcceleration ()
 		{
 			if (Particles[i]->Material == 3)
 			{
+				double RhoF = Materials[Particles[i]->MatID].RhoF;
 				if (Particles[i]->SatCheck && !Particles[i]->IsSat)
 				{
-					Particles[i]->Mass		= Particles[i]->V*(Particles[i]->RefDensity - Particles[i]->RhoF);
-					Particles[i]->Density		= Particles[i]->Density - Particles[i]->RhoF;
-					Particles[i]->Densityb		= Particles[i]->Densityb - Particles[i]->RhoF;
-					Particles[i]->RefDensity	= Particles[i]->RefDensity - Particles[i]->RhoF;
+					Particles[i]->Mass		= Particles[i]->V*(Particles[i]->RefDensity - RhoF);
+					Particles[i]->Density		= Particles[i]->Density - RhoF;
+					Particles[i]->Densityb		= Particles[i]->Densityb - RhoF;
+					Particles[i]->RefDensity	= Particles[i]->RefDensity - RhoF;
 					Particles[i]->IsSat		= true;
 				}
 				if (!Particles[i]->SatCheck && Particles[i]->IsSat)
 				{
-					Particles[i]->Mass		= Particles[i]->V*(Particles[i]->RefDensity + Particles[i]->RhoF);
-					Particles[i]->Density		= Particles[i]->Density + Particles[i]->RhoF;
-					Particles[i]->Densityb		= Particles[i]->Densityb + Particles[i]->RhoF;
-					Particles[i]->RefDensity	= Particles[i]->RefDensity + Particles[i]->RhoF;
+					Particles[i]->Mass		= Particles[i]->V*(Particles[i]->RefDensity + RhoF);
+					Particles[i]->Density		= Particles[i]->Density + RhoF;
+					Particles[i]->Densityb		= Particles[i]->Densityb + RhoF;
+					Particles[i]->RefDensity	= Particles[i]->RefDensity + RhoF;
 					Particles[i]->IsSat		= false;
 				}
 			}
@@ -1235,72 +2033,178 @@ inline void Domain::PrimaryComputeAcceleration ()
 
 }
 
-inline void Domain::LastComputeAcceleration ()
+template <typename KP> inline void Domain::PairForces (KP const & Ker)
 {
+	// Fluid-fluid pairs are computed on the packed arrays and copied back before the mixed pairs
+	double T0 = omp_get_wtime();
+	PD.Pack(Particles, Materials, Nproc);
+	PackTime += omp_get_wtime() - T0;
+
+	// Reference kernel of the tensile instability, it is constant but depends on the kernel
 	#pragma omp parallel for schedule (static) num_threads(Nproc)
-	for (size_t k=0; k<Nproc;k++)
+	for (size_t i=0; i<PD.Size; i++)
+		PD.TIKernel[i] = Ker.Kernel(PD.TIInitDist[i]/PD.h[i], PD.h[i]);
+
+	if (InteractionMode == Gather_Mode)
 	{
-		for (size_t i=0; i<SMPairs[k].Size();i++)
-			if (Particles[SMPairs[k][i].first]->Material == 1)
-				CalcForce11(Particles[SMPairs[k][i].first],Particles[SMPairs[k][i].second]);
-			else
-				CalcForce2233(Particles[SMPairs[k][i].first],Particles[SMPairs[k][i].second]);
+		// Each thread owns a range of particles and only updates them, inactive particles (block time stepping) are skipped
+		#pragma omp parallel for schedule (static) num_threads(Nproc)
+		for (size_t a=0; a<Particles.Size(); a++)
+			if (Particles[a]->Active)
+			for (int n=NeighStart[a]; n<NeighStart[a+1]; n++)
+			{
+				size_t P1 = NeighPairs[n].first;
+				size_t P2 = NeighPairs[n].second;
+				if (PD.Material[P1] != PD.Material[P2]) continue;
+				PairGeom G;
+				PairGeometry(P1, P2, Ker, G);
+				if (PD.Material[P1] == 1)
+					CalcForce11(P1, P2, Ker, G, P1==a, P2==a);
+				else
+					CalcForce2233(P1, P2, Ker, G, P1==a, P2==a);
+			}
 
-		for (size_t i=0; i<FSMPairs[k].Size();i++)
-			if (Particles[FSMPairs[k][i].first]->Material == 1)
-				CalcForce11(Particles[FSMPairs[k][i].first],Particles[FSMPairs[k][i].second]);
-			else
-				CalcForce2233(Particles[FSMPairs[k][i].first],Particles[FSMPairs[k][i].second]);
-	}
+		T0 = omp_get_wtime();
+		PD.Unpack(Particles, Nproc);
+		PackTime += omp_get_wtime() - T0;
 
-	#pragma omp parallel for schedule (static) num_threads(Nproc)
-	for (size_t k=0; k<NSMPairs.Size();k++)
+		#pragma omp parallel for schedule (static) num_threads(Nproc)
+		for (size_t a=0; a<Particles.Size(); a++)
+			if (Particles[a]->Active)
+			for (int n=NeighStart[a]; n<NeighStart[a+1]; n++)
+			{
+				size_t P1 = NeighPairs[n].first;
+				size_t P2 = NeighPairs[n].second;
+				if (Particles[P1]->Material == Particles[P2]->Material) continue;
+				if (Particles[P1]->Material*Particles[P2]->Material == 3)
+					CalcForce13(Particles[P1], Particles[P2], Ker, P1==a, P2==a);
+				else if (Particles[P1]->Material*Particles[P2]->Material == 2)
+					CalcForce12(Particles[P1], Particles[P2], Ker, P1==a, P2==a);
+				else
+				{
+					std::cout<<"Out of Interaction types"<<std::endl;
+					abort();
+				}
+			}
+	}
+	else
 	{
-		for (size_t i=0; i<NSMPairs[k].Size();i++)
+		#pragma omp parallel for schedule (static) num_threads(Nproc)
+		for (size_t t=0; t<Nproc; t++)
+		for (size_t k=0; k<Nproc; k++)
 		{
-			if (Particles[NSMPairs[k][i].first]->Material*Particles[NSMPairs[k][i].second]->Material == 3)
-				CalcForce13(Particles[NSMPairs[k][i].first],Particles[NSMPairs[k][i].second]);
-			else if (Particles[NSMPairs[k][i].first]->Material*Particles[NSMPairs[k][i].second]->Material == 2)
-				CalcForce12(Particles[NSMPairs[k][i].first],Particles[NSMPairs[k][i].second]);
+			size_t Begin, End;
+			PairSlice(SMPairs[k].Size(), t, Begin, End);
+			if (FluidBatch)
+				CalcForce11Batch(SMPairs[k], Begin, End, Ker);
 			else
+				for (size_t i=Begin; i<End; i++)
+					if (PD.Material[SMPairs[k][i].first] == 1)
+						CalcForce11(SMPairs[k][i].first, SMPairs[k][i].second, Ker, SMPairs[k].Geom(i));
+					else
+						CalcForce2233(SMPairs[k][i].first, SMPairs[k][i].second, Ker, SMPairs[k].Geom(i));
+
+			PairSlice(FSMPairs[k].Size(), t, Begin, End);
+			for (size_t i=Begin; i<End; i++)
+				if (PD.Material[FSMPairs[k][i].first] == 1)
+					CalcForce11(FSMPairs[k][i].first, FSMPairs[k][i].second, Ker, FSMPairs[k].Geom(i));
+				else
+					CalcForce2233(FSMPairs[k][i].first, FSMPairs[k][i].second, Ker, FSMPairs[k].Geom(i));
+		}
+
+		T0 = omp_get_wtime();
+		PD.Unpack(Particles, Nproc);
+		PackTime += omp_get_wtime() - T0;
+
+		#pragma omp parallel for schedule (static) num_threads(Nproc)
+		for (size_t t=0; t<Nproc; t++)
+		for (size_t k=0; k<Nproc; k++)
+		{
+			size_t Begin, End;
+			PairSlice(NSMPairs[k].Size(), t, Begin, End);
+			for (size_t i=Begin; i<End; i++)
 			{
-				std::cout<<"Out of Interaction types"<<std::endl;
-				abort();
+				if (Particles[NSMPairs[k][i].first]->Material*Particles[NSMPairs[k][i].second]->Material == 3)
+					CalcForce13(Particles[NSMPairs[k][i].first], Particles[NSMPairs[k][i].second], Ker);
+				else if (Particles[NSMPairs[k][i].first]->Material*Particles[NSMPairs[k][i].second]->Material == 2)
+					CalcForce12(Particles[NSMPairs[k][i].first], Particles[NSMPairs[k][i].second], Ker);
+				else
+				{
+					std::cout<<"Out of Interaction types"<<std::endl;
+					abort();
+				}
 			}
 		}
 	}
+}
 
-	for (size_t i=0 ; i<Nproc ; i++)
+inline void Domain::LastComputeAcceleration ()
+{
+	// The pair loops are instantiated on the selected kernel
+	double T0 = omp_get_wtime();
+	if (KernelTableSize>0)
+		PairForces(KernelTable);
+	else
 	{
-		SMPairs[i].Clear();
-		FSMPairs[i].Clear();
-		NSMPairs[i].Clear();
+		switch (KernelType)
+		{
+			case 0:
+				if (Dimension == 2) PairForces(QubicSplineKernel<2>()); else PairForces(QubicSplineKernel<3>());
+				break;
+			case 1:
+				if (Dimension == 2) PairForces(QuinticKernel<2>()); else PairForces(QuinticKernel<3>());
+				break;
+			case 2:
+				if (Dimension == 2) PairForces(QuinticSplineKernel<2>()); else PairForces(QuinticSplineKernel<3>());
+				break;
+		}
 	}
+	ForceTime += omp_get_wtime() - T0;
 
-		//Min time step check based on the acceleration
-		double test	= 0.0;
-		deltatmin	= deltatint;
-		#pragma omp parallel for schedule (static) private(test) num_threads(Nproc)
-		for (size_t i=0; i<Particles.Size(); i++)
+	// The sleeping particles are woken through the pairs of this step, before the lists are cleared
+	if (SleepSteps>0) SleepCheck();
+
+	// Verlet lists are kept until the next neighbour search
+	if (!(VerletSkin>0.0))
+		for (size_t i=0 ; i<Nproc ; i++)
 		{
-			if (Particles[i]->IsFree)
-			{
-				test = sqrt(Particles[i]->h/norm(Particles[i]->a));
-				if (deltatmin > (sqrt_h_a*test))
-				{
-					omp_set_lock(&dom_lock);
-						deltatmin = sqrt_h_a*test;
-					omp_unset_lock(&dom_lock);
-				}
-			}
+			SMPairs[i].Clear();
+			FSMPairs[i].Clear();
+			NSMPairs[i].Clear();
 		}
+
+	//Min time step check based on the acceleration (and the acoustic and viscous limits with the controller)
+	double Min = (CFLFactor>0.0) ? std::numeric_limits<double>::max() : deltatint;
+	#pragma omp parallel for schedule (static) num_threads(Nproc) reduction(min:Min)
+	for (size_t i=0; i<Particles.Size()-NGhost; i++)
+		if (Particles[i]->IsFree && Particles[i]->Active) Min = std::min(Min, TimeStepLimit(Particles[i]));
+#ifdef USE_MPI
+	// All of the ranks take the same time step
+	MPI_Allreduce(MPI_IN_PLACE, &Min, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+#endif
+	deltatmin = (Min < std::numeric_limits<double>::max()) ? Min : deltatint;
+}
+
+inline double Domain::TimeStepLimit (Particle const * P) const
+{
+	double dt = sqrt_h_a*sqrt(P->h/norm(P->a));
+	if (CFLFactor>0.0)
+	{
+		// Acoustic limit with the current sound speed and velocity, viscous limit with the current (Bingham/LES) viscosity
+		MaterialProps const & M = Materials[P->MatID];
+		double C = SoundSpeed(M.PresEq, M.Cs, P->Density, P->RefDensity);
+		dt = std::min(dt, CFLFactor*P->h/(C+norm(P->v)));
+		if (P->Material == 1 && P->Mu>0.0) dt = std::min(dt, CFLFactor*0.5*P->h*P->h*P->Density/P->Mu);
+	}
+	return dt;
 }
 
 inline void Domain::Move (double dt)
 {
+	// With the block time stepping dt is the sub-step and only the active particles move with their own step
 	#pragma omp parallel for schedule (static) num_threads(Nproc)
 	for (size_t i=0; i<Particles.Size(); i++)
-		if (Particles[i]->IsFree)
+		if (Particles[i]->IsFree && Particles[i]->Active)
 		{
 			if (Particles[i]->InOut>0)
 			{
@@ -1319,7 +2223,10 @@ inline void Domain::Move (double dt)
 					}
 				}
 			}
-		Particles[i]->Move(dt,DomSize,TRPR,BLPF,Scheme,I);
+		if (TimeBins>0)
+			Particles[i]->Move(dt*(size_t(1)<<(TimeBins-Particles[i]->TimeBin)),DomSize,TRPR,BLPF,Scheme,I,Materials[Particles[i]->MatID]);
+		else
+			Particles[i]->Move(dt,DomSize,TRPR,BLPF,Scheme,I,Materials[Particles[i]->MatID]);
 		}
 
 }
@@ -1341,6 +2248,9 @@ inline void Domain::InFlowBCLeave()
 			omp_unset_lock(&dom_lock);
 		}
 
+	// Recycled particles jump to the inflow, so the neighbour list must be rebuilt
+	if (DelPart.Size()>0) VerletRebuild = true;
+
 	if (BC.InOutFlow==1 || BC.InOutFlow==3)
 	{
 		for (size_t i=0 ; i<BC.InPart.Size() ; i++)
@@ -1356,6 +2266,7 @@ inline void Domain::InFlowBCLeave()
 			}
 		BC.InPart.DelItems(TempPart);
 		TempPart.Clear();
+		if (AddPart.Size()>0) VerletRebuild = true;
 	}
 
 	if (AddPart.Size() >= DelPart.Size())
@@ -1365,27 +2276,18 @@ inline void Domain::InFlowBCLeave()
 			a = DelPart[i];
 			b = AddPart[i].second;
 			Particles[a]->x 		= AddPart[i].first;
-			Particles[a]->Material		= 1;
+			Particles[a]->MatID		= Particles[b]->MatID; // Material of the inflow particle, it must be a Newtonian fluid without tensile instability
+			Particles[a]->AllocateState(Materials[Particles[a]->MatID], Scheme); // Fluid, the solid state of a recycled soil particle is freed
 			Particles[a]->InOut		= 1;
 			Particles[a]->FirstStep		= false;
 
-			Particles[a]->P0		= Particles[b]->P0;
-			Particles[a]->PresEq		= Particles[b]->PresEq;
-			Particles[a]->Cs		= Particles[b]->Cs;
-
-			Particles[a]->Alpha		= Particles[b]->Alpha;
-			Particles[a]->Beta		= Particles[b]->Beta;
 			Particles[a]->Mu		= Particles[b]->Mu;
-			Particles[a]->MuRef		= Particles[b]->MuRef;
-			Particles[a]->T0		= 0.0; // Inflow is not capable of injecting non-Newtonian fluid
 
 			Particles[a]->Mass 		= Particles[b]->Mass;
 			Particles[a]->h			= Particles[b]->h;
 
 			Particles[a]->ID 		= Particles[b]->ID;
 
-			Particles[a]->TI		= 0.0; // Inflow is not capable of condidering the tensile instability
-
 			Particles[a]->RefDensity	= Particles[b]->RefDensity; // The density for inflow must always be defined
 
 			Particles[a]->ct		= Particles[b]->ct;
@@ -1394,8 +2296,6 @@ inline void Domain::InFlowBCLeave()
 			Particles[a]->ShepardStep	= Particles[b]->ShepardStep;
 			Particles[a]->ShepardCounter	= Particles[b]->ShepardCounter;
 
-			Particles[a]->LES		= Particles[b]->LES;
-			Particles[a]->CSmag		= Particles[b]->CSmag;
 			BC.InPart.Push(a);
 		}
 
@@ -1407,21 +2307,12 @@ inline void Domain::InFlowBCLeave()
 				Particles.Push(new Particle(Particles[b]->ID,AddPart[i].first,Particles[b]->v,Particles[b]->Mass,Particles[b]->RefDensity,Particles[b]->h,false));
 
 				a = Particles.Size()-1;
-				Particles[a]->Material		= 1;
+				Particles[a]->MatID		= Particles[b]->MatID; // Material of the inflow particle, it must be a Newtonian fluid without tensile instability
+				Particles[a]->AllocateState(Materials[Particles[a]->MatID], Scheme); // Fluid, the solid state of a recycled soil particle is freed
 				Particles[a]->InOut		= 1;
 				Particles[a]->FirstStep		= false;
 
-				Particles[a]->P0		= Particles[b]->P0;
-				Particles[a]->PresEq		= Particles[b]->PresEq;
-				Particles[a]->Cs		= Particles[b]->Cs;
-
-				Particles[a]->Alpha		= Particles[b]->Alpha;
-				Particles[a]->Beta		= Particles[b]->Beta;
 				Particles[a]->Mu		= Particles[b]->Mu;
-				Particles[a]->MuRef		= Particles[b]->MuRef;
-				Particles[a]->T0		= 0.0; // Inflow is not capable of injecting non-Newtonian fluid
-
-				Particles[a]->TI		= 0.0; // Inflow is not capable of condidering the tensile instability
 
 				Particles[a]->ct		= Particles[b]->ct;
 
@@ -1429,8 +2320,6 @@ inline void Domain::InFlowBCLeave()
 				Particles[a]->ShepardStep	= Particles[b]->ShepardStep;
 				Particles[a]->ShepardCounter	= Particles[b]->ShepardCounter;
 
-				Particles[a]->LES		= Particles[b]->LES;
-				Particles[a]->CSmag		= Particles[b]->CSmag;
 				BC.InPart.Push(a);
 			}
 
@@ -1444,27 +2333,18 @@ inline void Domain::InFlowBCLeave()
 			a = DelPart[i];
 			b = AddPart[i].second;
 			Particles[a]->x 		= AddPart[i].first;
-			Particles[a]->Material		= 1;
+			Particles[a]->MatID		= Particles[b]->MatID; // Material of the inflow particle, it must be a Newtonian fluid without tensile instability
+			Particles[a]->AllocateState(Materials[Particles[a]->MatID], Scheme); // Fluid, the solid state of a recycled soil particle is freed
 			Particles[a]->InOut		= 1;
 			Particles[a]->FirstStep		= false;
 
-			Particles[a]->P0		= Particles[b]->P0;
-			Particles[a]->PresEq		= Particles[b]->PresEq;
-			Particles[a]->Cs		= Particles[b]->Cs;
-
-			Particles[a]->Alpha		= Particles[b]->Alpha;
-			Particles[a]->Beta		= Particles[b]->Beta;
 			Particles[a]->Mu		= Particles[b]->Mu;
-			Particles[a]->MuRef		= Particles[b]->MuRef;
-			Particles[a]->T0		= 0.0; // Inflow is not capable of injecting non-Newtonian fluid
 
 			Particles[a]->Mass 		= Particles[b]->Mass;
 			Particles[a]->h			= Particles[b]->h;
 
 			Particles[a]->ID 		= Particles[b]->ID;
 
-			Particles[a]->TI		= 0.0; // Inflow is not capable of condidering the tensile instability
-
 			Particles[a]->RefDensity	= Particles[b]->RefDensity; // The density for inflow must always be defined
 
 			Particles[a]->ct		= Particles[b]->ct;
@@ -1473,8 +2353,6 @@ inline void Domain::InFlowBCLeave()
 			Particles[a]->ShepardStep	= Particles[b]->ShepardStep;
 			Particles[a]->ShepardCounter	= Particles[b]->ShepardCounter;
 
-			Particles[a]->LES		= Particles[b]->LES;
-			Particles[a]->CSmag		= Particles[b]->CSmag;
 			BC.InPart.Push(a);
 		}
 		for (size_t i=AddPart.Size() ; i<DelPart.Size() ; i++)
@@ -1482,6 +2360,7 @@ inline void Domain::InFlowBCLeave()
 			TempPart.Push(DelPart[i]);
 		}
 		Particles.DelItems(TempPart);
+		StaticRebuild = true;
 		BC.inoutcounter = 1;
 		DelPart.Clear();
 		AddPart.Clear();
@@ -1491,7 +2370,8 @@ inline void Domain::InFlowBCLeave()
 inline void Domain::InFlowBCFresh()
 {
 	int temp, temp1;
-	int q1,q2,q3;
+	int q1,q2,q3,c;
+
 	if (BC.inoutcounter == 0)
 	{
 		if (BC.InOutFlow==1 || BC.InOutFlow==3)
@@ -1510,20 +2390,23 @@ inline void Domain::InFlowBCFresh()
 			for (q3=0; BC.Periodic[2]? (q3<(CellNo[2]-2)) : (q3<CellNo[2]) ; q3++)
 			for (q1=0; q1<(temp1 + 1)                                      ; q1++)
 			{
-				if (HOC[q1][q2][q3]!=-1)
+				c = CellIndex(q1,q2,q3);
+				for (int a=CellStart[c]; a<CellStart[c]+CellCount[c]; a++)
 				{
-					temp = HOC[q1][q2][q3];
-					while (temp != -1)
+					temp = CellPart[a];
+					if (Particles[temp]->IsFree && (Particles[temp]->x(0) <= BC.InFlowLoc1) )
 					{
-						if (Particles[temp]->IsFree && (Particles[temp]->x(0) <= BC.InFlowLoc1) )
-						{
-							BC.InPart.Push(temp);
-							Particles[temp]->InOut = 1;
-						}
-						temp = Particles[temp]->LL;
+						BC.InPart.Push(temp);
+						Particles[temp]->InOut = 1;
 					}
 				}
 			}
+
+			// The recycled particles take the material of the inflow particles
+			for (size_t i=0 ; i<BC.InPart.Size() ; i++)
+				if (Materials[Particles[BC.InPart[i]]->MatID].Type != 1)
+					throw new Fatal("Inflow particle %zd refers to the material %zd, the inflow particles must be fluid", BC.InPart[i], Particles[BC.InPart[i]]->MatID);
+
 			BC.InFlowLoc2  = Particles[BC.InPart[0]]->x(0);
 			BC.InFlowLoc3  = Particles[BC.InPart[0]]->x(0);
 			#pragma omp parallel for schedule(static) num_threads(Nproc)
@@ -1549,15 +2432,12 @@ inline void Domain::InFlowBCFresh()
 		for (q3=0; BC.Periodic[2]? (q3<(CellNo[2]-2)) : (q3<CellNo[2]) ; q3++)
 		for (q1=0; q1<(temp1 + 1)                                      ; q1++)
 		{
-			if (HOC[q1][q2][q3]!=-1)
+			c = CellIndex(q1,q2,q3);
+			for (int a=CellStart[c]; a<CellStart[c]+CellCount[c]; a++)
 			{
-				temp = HOC[q1][q2][q3];
-				while (temp != -1)
-				{
-					if (Particles[temp]->IsFree && (Particles[temp]->x(0) <= BC.InFlowLoc1) && Particles[temp]->InOut==1)
-						BC.InPart.Push(temp);
-					temp = Particles[temp]->LL;
-				}
+				temp = CellPart[a];
+				if (Particles[temp]->IsFree && (Particles[temp]->x(0) <= BC.InFlowLoc1) && Particles[temp]->InOut==1)
+					BC.InPart.Push(temp);
 			}
 		}
 		BC.inoutcounter = 2;
@@ -1573,17 +2453,14 @@ inline void Domain::InFlowBCFresh()
 		for (q3=0     ; BC.Periodic[2]? (q3<(CellNo[2]-2)) : (q3<CellNo[2]) ; q3++)
 		for (q1=temp1 ; q1<CellNo[0]                                        ; q1++)
 		{
-			if (HOC[q1][q2][q3]!=-1)
+			c = CellIndex(q1,q2,q3);
+			for (int a=CellStart[c]; a<CellStart[c]+CellCount[c]; a++)
 			{
-				temp = HOC[q1][q2][q3];
-				while (temp != -1)
+				temp = CellPart[a];
+				if (Particles[temp]->IsFree && (Particles[temp]->x(0) >= BC.OutFlowLoc) )
 				{
-					if (Particles[temp]->IsFree && (Particles[temp]->x(0) >= BC.OutFlowLoc) )
-					{
-						BC.OutPart.Push(temp);
-						Particles[temp]->InOut = 2;
-					}
-					temp = Particles[temp]->LL;
+					BC.OutPart.Push(temp);
+					Particles[temp]->InOut = 2;
 				}
 			}
 		}
@@ -1603,7 +2480,8 @@ inline void Domain::InFlowBCFresh()
 			Particles[a]->Density  = den;
 			Particles[a]->Densityb = den;
 			Particles[a]->Densitya = den;
-    			Particles[a]->Pressure = EOS(Particles[a]->PresEq, Particles[a]->Cs, Particles[a]->P0,Particles[a]->Density, Particles[a]->RefDensity);
+			MaterialProps const & M = Materials[Particles[a]->MatID];
+			Particles[a]->Pressure = EOS(M.PresEq, M.Cs, M.P0,Particles[a]->Density, Particles[a]->RefDensity);
 		}
 
 	double temp11;
@@ -1629,7 +2507,8 @@ inline void Domain::InFlowBCFresh()
 				Particles[a]->Density  = den;
 				Particles[a]->Densityb = den;
  				Particles[a]->Densitya = den;
-    				Particles[a]->Pressure = EOS(Particles[a]->PresEq, Particles[a]->Cs, Particles[a]->P0,Particles[a]->Density, Particles[a]->RefDensity);
+				MaterialProps const & M = Materials[Particles[a]->MatID];
+				Particles[a]->Pressure = EOS(M.PresEq, M.Cs, M.P0,Particles[a]->Density, Particles[a]->RefDensity);
 			}
 		}
 }
@@ -1653,7 +2532,8 @@ inline void Domain::WholeVelocity()
     		if (Particles[i]->IsFree && BC.allDensity>0.0)
     		{
 			Particles[i]->Density	= den;
-			Particles[i]->Pressure	= EOS(Particles[i]->PresEq, Particles[i]->Cs, Particles[i]->P0,Particles[i]->Density, Particles[i]->RefDensity);
+			MaterialProps const & M = Materials[Particles[i]->MatID];
+			Particles[i]->Pressure	= EOS(M.PresEq, M.Cs, M.P0,Particles[i]->Density, Particles[i]->RefDensity);
     		}
     	}
     }
@@ -1673,34 +2553,99 @@ inline void Domain::InitialChecks()
 	if (BC.InOutFlow>0 && BC.Periodic[0])
 		throw new Fatal("Periodic BC in the X direction cannot be used with In/Out-Flow BC simultaneously");
 
+	if (RefineStep>0 && BC.InOutFlow>0)
+		throw new Fatal("Particle refinement (RefineStep>0) cannot be used with In/Out-Flow BC, the particle indices are not kept");
+
+	if (KernelType>2)
+		throw new Fatal("Unknown kernel type (%zd), please use Kernel_Set with Qubic_Spline, Quintic or Quintic_Spline", KernelType);
+
+	if (TimeBins>0 && InteractionMode != Gather_Mode)
+		throw new Fatal("Block time stepping (TimeBins>0) needs the gather mode, please use Interaction_Mode_Set(Gather_Mode)");
+
+	if (NRanks>1 && (BC.InOutFlow>0 || TimeBins>0 || SleepSteps>0 || RefineStep>0 || ReorderStep>0))
+		throw new Fatal("In/Out-Flow BC, block time stepping, sleeping particles, particle refinement and reordering cannot be used with the MPI domain decomposition");
+
+	// The ghosts are exchanged at every step, which rebuilds the neighbour lists (and the static list of the fixed particles) anyway
+	if (NRanks>1 && VerletSkin>0.0)
+		throw new Fatal("Verlet lists (VerletSkin>0) cannot be used with the MPI domain decomposition, the halo exchange rebuilds the lists at every step");
+
+	// The pair lists store the particle indices with 32 bits
+	if (Particles.Size() >= std::numeric_limits<unsigned int>::max())
+		throw new Fatal("The No of particles (%zd) exceeds the 32 bit indices of the pair lists", Particles.Size());
+
+	// Output profile
+	if (!(Output.Fields & Out_Position))
+		throw new Fatal("The positions (Out_Position) are needed by the XDMF geometry of the output files");
+	if (Output.Half & (Out_Position|Out_Tag))
+		throw new Fatal("Positions and tags cannot be stored as 16 bit floats, please use Output.PositionBits to quantize the positions");
+	if (Output.Deflate>9)
+		throw new Fatal("The gzip level of the output (Output.Deflate = %zd) must be between 0 and 9", Output.Deflate);
+	if (Output.Deflate>0 && H5Zfilter_avail(H5Z_FILTER_DEFLATE)<=0)
+		throw new Fatal("The gzip filter (Output.Deflate) is not available in this HDF5 library");
+	if (Output.PositionBits>0 && H5Zfilter_avail(H5Z_FILTER_SCALEOFFSET)<=0)
+		throw new Fatal("The scale-offset filter (Output.PositionBits) is not available in this HDF5 library");
+
+	// The user properties are datasets next to the fixed ones of the output files and time series
+	char const * Fixed[13] = {"Position", "Velocity", "Acceleration", "Tag", "Pressure", "Density", "Mass", "h", "Sigma", "Strain", "NP", "Time", "Offset"};
+	unsigned Props[3] = {Out_Prop0, Out_Prop1, Out_Prop2};
+	for (size_t k=0; k<3; k++)
+	{
+		if (!(Output.Fields & Props[k])) continue;
+		if (OutputName[k].size()==0)
+			throw new Fatal("The name of the output property %zd (OutputName[%zd]) is empty", k+1, k);
+		for (size_t j=0; j<13; j++)
+			if (OutputName[k] == Fixed[j])
+				throw new Fatal("The name of the output property %zd (OutputName[%zd] = %s) is a dataset of the output files, please rename it", k+1, k, OutputName[k].CStr());
+		for (size_t j=0; j<k; j++)
+			if ((Output.Fields & Props[j]) && OutputName[k] == OutputName[j])
+				throw new Fatal("The output properties %zd and %zd have the same name (%s)", j+1, k+1, OutputName[k].CStr());
+	}
+
+
+	// Material table
+	if (Materials.Size()==0)
+		throw new Fatal("No material is defined, please add the materials with AddMaterial and set Particle::MatID of the particles");
+	for (size_t i=0; i<Materials.Size(); i++) Materials[i].Init();
+	for (size_t i=0; i<Particles.Size(); i++)
+		if (Particles[i]->MatID >= Materials.Size())
+			throw new Fatal("Particle %zd refers to the material %zd, only %zd materials are defined", i, Particles[i]->MatID, Materials.Size());
 
+	PD.Invalidate();
 	#pragma omp parallel for schedule (static) num_threads(Nproc)
 	for (size_t i=0; i<Particles.Size(); i++)
 	{
+		MaterialProps const & M = Materials[Particles[i]->MatID];
+
+		// Reference viscosity of the particle
+		Particles[i]->Mu	= M.MuRef;
+
+		// Material type and stress and strain state of the solid and soil particles for the selected scheme
+		Particles[i]->AllocateState(M, Scheme);
+
 		//Initializing pressure of solid and fluid particles
 		if (Particles[i]->Material < 3)
-			Particles[i]->Pressure = EOS(Particles[i]->PresEq, Particles[i]->Cs, Particles[i]->P0,Particles[i]->Density, Particles[i]->RefDensity);
+			Particles[i]->Pressure = EOS(M.PresEq, M.Cs, M.P0,Particles[i]->Density, Particles[i]->RefDensity);
 
 		// Initializing the permeability for soil particles
 		if (Particles[i]->Material == 3)
 		{
-			switch(Particles[i]->SeepageType)
+			switch(M.SeepageType)
 			{
 				case 0:
 					break;
 
 				case 1:
-					Particles[i]->k = Particles[i]->n0*Particles[i]->n0*Particles[i]->n0*Particles[i]->d*Particles[i]->d/(180.0*(1.0-Particles[i]->n0)*(1.0-Particles[i]->n0));
+					Particles[i]->k = M.n0*M.n0*M.n0*M.d*M.d/(180.0*(1.0-M.n0)*(1.0-M.n0));
 					break;
 
 				case 2:
-					Particles[i]->k = Particles[i]->n0*Particles[i]->n0*Particles[i]->n0*Particles[i]->d*Particles[i]->d/(150.0*(1.0-Particles[i]->n0)*(1.0-Particles[i]->n0));
-					Particles[i]->k2= 1.75*(1.0-Particles[i]->n0)/(Particles[i]->n0*Particles[i]->n0*Particles[i]->n0*Particles[i]->d);
+					Particles[i]->k = M.n0*M.n0*M.n0*M.d*M.d/(150.0*(1.0-M.n0)*(1.0-M.n0));
+					Particles[i]->k2= 1.75*(1.0-M.n0)/(M.n0*M.n0*M.n0*M.d);
 					break;
 
 				case 3:
-					Particles[i]->k = Particles[i]->n0*Particles[i]->n0*Particles[i]->n0*Particles[i]->d*Particles[i]->d/(150.0*(1.0-Particles[i]->n0)*(1.0-Particles[i]->n0));
-					Particles[i]->k2= 0.4/(Particles[i]->n0*Particles[i]->n0*Particles[i]->d);
+					Particles[i]->k = M.n0*M.n0*M.n0*M.d*M.d/(150.0*(1.0-M.n0)*(1.0-M.n0));
+					Particles[i]->k2= 0.4/(M.n0*M.n0*M.d);
 					break;
 
 				default:
@@ -1713,7 +2658,7 @@ inline void Domain::InitialChecks()
 					break;
 			}
 
-			Particles[i]->n = Particles[i]->n0;
+			Particles[i]->n = M.n0;
 		}
 	}
 }
@@ -1725,8 +2670,11 @@ inline void Domain::TimestepCheck ()
 	t1 = 0.25*hmax/(CsMax);
 	if (MuMax>0.0) t2 = 0.125*hmax*hmax*rhomax/MuMax; else t2 =1000000.0;
 
-	std::cout << "Max allowable time step using CFL = "<< std::min(t1,t2) << " S" << std::endl;
-	std::cout << "User Time Step = "<< deltatint  << " S" << std::endl;
+	if (Rank==0)
+	{
+		std::cout << "Max allowable time step using CFL = "<< std::min(t1,t2) << " S" << std::endl;
+		std::cout << "User Time Step = "<< deltatint  << " S" << std::endl;
+	}
 
 	if (deltatint > std::min(t1,t2))
 	throw new Fatal("Please decrease the time step to the allowable range");
@@ -1734,18 +2682,76 @@ inline void Domain::TimestepCheck ()
 
 inline void Domain::Solve (double tf, double dt, double dtOut, char const * TheFileKey, size_t maxidx)
 {
-	std::cout << "\n--------------Solving---------------------------------------------------------------" << std::endl;
+#ifdef USE_MPI
+	// An error on some of the ranks would leave the other ones waiting in their next collective call, so all of them are aborted
+	try
+	{
+		SolveSteps(tf, dt, dtOut, TheFileKey, maxidx);
+	}
+	catch (Fatal * e)
+	{
+		if (NRanks>1)
+		{
+			printf("Rank %d: ", Rank);
+			e->Cout();
+			fflush(stdout);
+			MPI_Abort(MPI_COMM_WORLD, 1);
+		}
+		throw;
+	}
+	catch (...)
+	{
+		if (NRanks>1)
+		{
+			printf("Rank %d: Fatal: Some exception (...) occurred in Domain::Solve\n", Rank);
+			fflush(stdout);
+			MPI_Abort(MPI_COMM_WORLD, 1);
+		}
+		throw;
+	}
+#else
+	SolveSteps(tf, dt, dtOut, TheFileKey, maxidx);
+#endif
+}
+
+inline void Domain::SolveSteps (double tf, double dt, double dtOut, char const * TheFileKey, size_t maxidx)
+{
+	if (Rank==0) std::cout << "\n--------------Solving---------------------------------------------------------------" << std::endl;
 
 	size_t idx_out = 1;
+	size_t Step = 0;
+	bool Search = true;
 	double tout = Time;
 
 	//Initializing adaptive time step variables
 	deltat = deltatint = deltatmin	= dt;
 
+	// Each rank writes the particles of its subdomain to its own files
+	String Key;
+	if (TheFileKey!=NULL)
+	{
+		if (NRanks>1) Key.Printf("%s_r%d", TheFileKey, Rank); else Key = TheFileKey;
+	}
+
+	if (NUMA) PinThreads();
 	InitialChecks();
+	if (TimeSeries && TheFileKey!=NULL) Series.Open(Key.CStr());
+	if (KernelTableSize>0) KernelTable.Build(Dimension, KernelType, KernelTableSize);
 	CellInitiate();
+#ifdef USE_MPI
+	// Each rank keeps its subdomain and the ghosts of the others, if all ranks built the whole model the other
+	// particles are only deleted, otherwise they are sent to their owners
+	Decompose();
+	Migrate(!Distributed);
+	HaloExchange();
+#endif
+	if (NUMA)
+	{
+		FirstTouch();
+		NUMAReport();
+	}
 	ListGenerate();
-	PrintInput(TheFileKey);
+	if (Rank==0 && TheFileKey!=NULL) PrintInput(TheFileKey);
 	TimestepCheck();
 	WholeVelocity();
 
@@ -1754,45 +2760,106 @@ inline void Domain::Solve (double tf, double dt, double dtOut, char const * TheF
 	if (TheFileKey!=NULL)
 	{
 		String fn;
-		fn.Printf    ("%s_Initial", TheFileKey);
-		WriteXDMF    (fn.CStr());
-		std::cout << "\nInitial Condition has been generated\n" << std::endl;
+		fn.Printf    ("%s_Initial", Key.CStr());
+		WriteOutput  (fn.CStr());
+		if (Rank==0) std::cout << "\nInitial Condition has been generated\n" << std::endl;
 	}
 
 	while (Time<tf && idx_out<=maxidx)
 	{
+		if (TimeBins>0) BlockActivate();
 		StartAcceleration(Gravity);
 		if (BC.InOutFlow>0) InFlowBCFresh();
-		MainNeighbourSearch();
+		if (Search || VerletRebuild)
+		{
+			MainNeighbourSearch();
+			if (VerletSkin>0.0) VerletRecord();
+			if (InteractionMode == Gather_Mode) GatherListGenerate();
+		}
 		GeneralBefore(*this);
 		PrimaryComputeAcceleration();
+#ifdef USE_MPI
+		HaloUpdate();
+#endif
 		LastComputeAcceleration();
 		GeneralAfter(*this);
+#ifdef USE_MPI
+		HaloClear();
+#endif
 
-		// output
-		if (Time>=tout)
+		// output (particles are only synchronised at the first sub-step with the block time stepping)
+		if (Time>=tout && TimeSub==0)
 		{
 			if (TheFileKey!=NULL)
 			{
 				String fn;
-				fn.Printf    ("%s_%04d", TheFileKey, idx_out);
-				WriteXDMF    (fn.CStr());
-				std::cout << "\nOutput No. " << idx_out << " at " << Time << " has been generated" << std::endl;
-				std::cout << "Current Time Step = " <<deltat<<std::endl;
+				fn.Printf    ("%s_%04d", Key.CStr(), idx_out);
+				WriteOutput  (fn.CStr());
+				if (Rank==0)
+				{
+					std::cout << "\nOutput No. " << idx_out << " at " << Time << " has been generated" << std::endl;
+					std::cout << "Current Time Step = " <<deltat<<std::endl;
+				}
 			}
 			idx_out++;
 			tout += dtOut;
 		}
 
-		AdaptiveTimeStep();
-		Move(deltat);
-		Time += deltat;
+		if (TimeBins>0)
+			BlockMove();
+		else
+		{
+			AdaptiveTimeStep();
+			Move(deltat);
+			Time += deltat;
+		}
 		if (BC.InOutFlow>0) InFlowBCLeave(); else CheckParticleLeave ();
-		CellReset();
-		ListGenerate();
+		Step++;
+		if (RefineStep>0 && (Step%RefineStep)==0 && TimeSub==0) Refine();
+		if (ReorderStep>0 && (Step%ReorderStep)==0) Reorder();
+		if (NUMA && ((RefineStep>0 && (Step%RefineStep)==0) || (ReorderStep>0 && (Step%ReorderStep)==0))) FirstTouch();
+#ifdef USE_MPI
+		if (BalanceStep>0 && (Step%BalanceStep)==0) Decompose();
+		Migrate(false);
+		HaloExchange();
+#endif
+
+		// With the Verlet lists the particles are only binned again for the next neighbour search (and at every step for the outflow)
+		Search = !(VerletSkin>0.0) || VerletCheck();
+		if (Search || BC.InOutFlow>0)
+		{
+			CellReset();
+			ListGenerate();
+		}
+	}
+
+	if (Rank==0)
+	{
+		if (VerletSkin>0.0) std::cout << "\nNo of neighbour searches (Verlet lists) = " << VerletBuilds << std::endl;
+		if (RefineStep>0) std::cout << "\nNo of split particles = " << RefineSplits << ", No of merged families = " << RefineMerges << std::endl;
+		if (SleepSteps>0 && SleepFullUpdates>0) std::cout << "\nParticle steps skipped by the sleeping particles = " << 100.0*SleepUpdates/SleepFullUpdates << " %" << std::endl;
+		if (TimeBins>0 && BlockFullUpdates>0) std::cout << "\nParticle moves of the block time stepping = " << 100.0*BlockUpdates/BlockFullUpdates << " % of a global time step with the same smallest step" << std::endl;
+		if (ForceTime>0.0) std::cout << "\nPacking of the particle state = " << PackTime << " s (" << 100.0*PackTime/ForceTime << " % of the pair force loops)" << std::endl;
+
+
+		// The lists keep their memory, so the allocated bytes (indices and geometry) are those of the peak
+		size_t Peak = 0;
+		size_t Bytes = 0;
+		for (size_t i=0 ; i<SMPairs.Size() ; i++)
+		{
+			Peak	+= SMPairs[i].Peak() + FSMPairs[i].Peak() + NSMPairs[i].Peak();
+			Bytes	+= SMPairs[i].Bytes() + FSMPairs[i].Bytes() + NSMPairs[i].Bytes();
+		}
+		std::cout << "\nPeak No of pairs (sum of the thread lists) = " << Peak << " (" << Bytes/1048576.0 << " MB allocated)" << std::endl;
 	}
 
-	std::cout << "\n--------------Solving is finished---------------------------------------------------" << std::endl;
+#ifdef USE_MPI
+	// The particles of the other subdomains are not kept after the solution
+	HaloClear();
+#endif
+	Writer.Wait();
+	if (Series.IsOpen()) Series.Close();
+	if (Rank==0) std::cout << "\n--------------Solving is finished---------------------------------------------------" << std::endl;
 
 }
 
@@ -1819,6 +2886,7 @@ inline void Domain::PrintInput(char const * FileKey)
 		oss << "Quintic Spline\n";
 		break;
 	}
+	if (KernelTableSize>0) oss << "Tabulated with " << KernelTableSize << " intervals (linear interpolation)\n";
 
 	oss << "\nViscosity Equation = ";
 	switch (VisEq)
@@ -1837,12 +2905,42 @@ inline void Domain::PrintInput(char const * FileKey)
 			break;
 	}
 
+	oss << "\nInteraction Mode = ";
+	switch (InteractionMode)
+	{
+		case 0:
+			oss << "0 => Pair mode (each pair once, locked updates)";
+			if (FluidBatch) oss << ", batched fluid pairs";
+			oss << "\n";
+			break;
+		case 1:
+			oss << "1 => Gather mode (full neighbour list, lock-free updates)\n";
+			break;
+	}
+
+#ifdef USE_MIXED_PRECISION
+	oss << "\nMixed precision: float particle state for the pair loops, double accumulation\n";
+#endif
+	size_t NSolid = 0;
+	for (size_t i=0; i<Particles.Size(); i++) if (Particles[i]->Solid != NULL) NSolid++;
+	oss << "\nMaterials = " << Materials.Size() << " (" << sizeof(MaterialProps) << " bytes each)\n";
+	for (size_t i=0; i<Materials.Size(); i++)
+		oss << "  " << i << " => " << (Materials[i].Type==1 ? "Fluid" : (Materials[i].Type==2 ? "Solid" : "Soil")) << ", Cs = " << Materials[i].Cs << " m/s\n";
+	oss << "\nParticle state = " << sizeof(Particle) << " bytes, plus " << sizeof(SolidState)+sizeof(StressState) << " bytes for each of the " << NSolid << " solid/soil particles\n";
+	if (CFLFactor>0.0) oss << "\nTime step controller with acceleration, acoustic and viscous limits, safety factor = " << CFLFactor << "\n";
+	if (RefineStep>0) oss << "\nParticles are split and merged every " << RefineStep << " steps up to refinement level " << RefineMax << "\n";
+	if (SleepSteps>0) oss << "\nSoil/solid particles sleep after " << SleepSteps << " quiet steps (v < " << SleepVelocity << ", a < " << SleepAcceleration << ", strain rate < " << SleepStrainRate << ")\n";
+	if (TimeBins>0) oss << "\nBlock time stepping with " << TimeBins+1 << " time bins (deltat/2^" << TimeBins << " to deltat)\n";
+
 	oss << "\nComputational domain size\n";
 	oss << "Bottom Left-Corner Front = " << BLPF <<" m\n";
 	oss << "Top Right-Corner Rear    = " << TRPR <<" m\n";
 
 	oss << "\nMax of the smoothing lengths, h = " << hmax << " m\n";
 	oss << "Cell factor in Linked List (based on kernels) = " << Cellfac << "\n";
+	if (VerletSkin>0.0) oss << "Verlet list skin distance = " << VerletSkin << " m\n";
+	if (StaticBoundary) oss << "Fixed particles are sorted once into a static cell list (" << FixedParticles.Size() << " particles)\n";
+	if (ReorderStep>0) oss << "Particles are reordered along a Morton curve every " << ReorderStep << " steps\n";
 
 	oss << "\nCell Size in XYZ Directions = " << CellSize <<" m\n";
 	oss << "No of Cells in XYZ Directions = ( " << CellNo[0] << " , " << CellNo[1] << " , " << CellNo[2] <<" )\n" ;
@@ -1854,6 +2952,12 @@ inline void Domain::PrintInput(char const * FileKey)
 	oss << "\nExternal Acceleration (Gravity enabled)= "<<Gravity<< " m/s2\n";
 
 	oss << "\nNo of Threads = "<<Nproc<<"\n";
+	if (Output.Fields!=Out_All || Output.Half || Output.PositionBits>0 || Output.Deflate>0 || Output.Shuffle)
+		oss << "\nOutput profile: fields = " << Output.Fields << ", 16 bit fields = " << Output.Half << ", position bits = " << Output.PositionBits
+		    << ", gzip level = " << Output.Deflate << (Output.Shuffle ? ", shuffled" : "") << "\n";
+	if (TimeSeries) oss << "\nAll outputs are appended to " << FileKey << (NRanks>1 ? "_r<rank>" : "") << ".hdf5 (temporal XDMF collection in .xmf)\n";
+	if (NUMA) oss << "NUMA mode: pinned threads, particles placed by first touch of the static schedule\n";
+	if (NRanks>1) oss << "No of MPI ranks = "<<NRanks<<", subdomains rebalanced every "<<BalanceStep<<" steps (recursive coordinate bisection)\n";
 
 	oss << "\nPeriodic Boundary Condition X dir= " << (BC.Periodic[0] ? "True" : "False") << "\n";
 	oss << "Periodic Boundary Condition Y dir= " << (BC.Periodic[1] ? "True" : "False") << "\n";
@@ -1866,201 +2970,116 @@ inline void Domain::PrintInput(char const * FileKey)
 	of.close();
 }
 
-inline void Domain::WriteXDMF (char const * FileKey)
+inline void Domain::Snapshot (char const * FileKey, OutputFrame & F)
 {
-    String fn(FileKey);
-    fn.append(".hdf5");
-    hid_t file_id;
-    file_id = H5Fcreate(fn.CStr(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
-
-
-    float * Posvec	= new float[3*Particles.Size()];
-    float * Velvec	= new float[3*Particles.Size()];
-    float * ACCvec	= new float[3*Particles.Size()];
-    float * Pressure	= new float[  Particles.Size()];
-    float * Prop1	= new float[  Particles.Size()];
-    float * Prop2	= new float[  Particles.Size()];
-    float * Prop3	= new float[  Particles.Size()];
-    float * Density	= new float[  Particles.Size()];
-    float * Mass	= new float[  Particles.Size()];
-    float * sh		= new float[  Particles.Size()];
-    int   * Tag		= new int  [  Particles.Size()];
-    float * Sigma	= new float[6*Particles.Size()];
-    float * Strain	= new float[6*Particles.Size()];
+	// The ghost particles (MPI halo) are written by their owners
+	F.Resize(Particles.Size() - NGhost);
+	F.Key		= FileKey;
+	F.Name[0]	= OutputName[0];
+	F.Name[1]	= OutputName[1];
+	F.Name[2]	= OutputName[2];
+	F.Time		= Time;
+	F.Series	= NULL;
+	F.Profile	= Output;
+
+	// Decimal digits of the fixed point positions: 2^PositionBits steps over the largest side of the domain box
+	if (Output.PositionBits>0)
+	{
+		Vec3_t Max = TRPR, Min = BLPF;
+		if (!(norm(TRPR-BLPF)>0.0) && F.N>0)
+		{
+			// The box is set by Solve, the particles give it to the outputs written before
+			Max = Particles[0]->x;
+			Min = Particles[0]->x;
+			for (size_t i=1; i<F.N; i++) for (size_t k=0; k<3; k++)
+			{
+				Max(k) = std::max(Max(k), Particles[i]->x(k));
+				Min(k) = std::min(Min(k), Particles[i]->x(k));
+			}
+		}
+		double L = std::max(Max(0)-Min(0), std::max(Max(1)-Min(1), Max(2)-Min(2)));
+		F.PositionDigits = (L>0.0) ? int(ceil(log10((pow(2.0, double(Output.PositionBits))-1.0)/L))) : 0;
+	}
 
+	unsigned Fields = Output.Fields;
+	bool User = (Fields & (Out_Prop0|Out_Prop1|Out_Prop2));
 	double P1,P2,P3;
 
-    #pragma omp parallel for schedule (static) private(P1,P2,P3) num_threads(Nproc)
-    for (size_t i=0;i<Particles.Size();i++)
-    {
-        Posvec  [3*i  ] = float(Particles[i]->x(0));
-        Posvec  [3*i+1] = float(Particles[i]->x(1));
-        Posvec  [3*i+2] = float(Particles[i]->x(2));
-        Velvec  [3*i  ] = float(Particles[i]->v(0));
-        Velvec  [3*i+1] = float(Particles[i]->v(1));
-        Velvec  [3*i+2] = float(Particles[i]->v(2));
-        ACCvec  [3*i  ] = float(Particles[i]->a(0));
-        ACCvec  [3*i+1] = float(Particles[i]->a(1));
-        ACCvec  [3*i+2] = float(Particles[i]->a(2));
-       	Pressure[i    ] = float(Particles[i]->Pressure);
-        Density [i    ] = float(Particles[i]->Density);
-        Mass	[i    ] = float(Particles[i]->Mass);
-        sh	[i    ] = float(Particles[i]->h);
-        Tag     [i    ] = int  (Particles[i]->ID);
-        Sigma   [6*i  ] = float(Particles[i]->Sigma(0,0));
-        Sigma   [6*i+1] = float(Particles[i]->Sigma(0,1));
-        Sigma   [6*i+2] = float(Particles[i]->Sigma(0,2));
-        Sigma   [6*i+3] = float(Particles[i]->Sigma(1,1));
-        Sigma   [6*i+4] = float(Particles[i]->Sigma(1,2));
-        Sigma   [6*i+5] = float(Particles[i]->Sigma(2,2));
-        Strain  [6*i  ] = float(Particles[i]->Strain(0,0));
-        Strain  [6*i+1] = float(Particles[i]->Strain(0,1));
-        Strain  [6*i+2] = float(Particles[i]->Strain(0,2));
-        Strain  [6*i+3] = float(Particles[i]->Strain(1,1));
-        Strain  [6*i+4] = float(Particles[i]->Strain(1,2));
-        Strain  [6*i+5] = float(Particles[i]->Strain(2,2));
-
-	UserOutput(Particles[i],P1,P2,P3);
-        Prop1	[i    ] = float(P1);
-        Prop2	[i    ] = float(P2);
-        Prop3	[i    ] = float(P3);
-   }
-
-    int data[1];
-    String dsname;
-    hsize_t dims[1];
-    dims[0]=1;
-    data[0]=Particles.Size();
-    dsname.Printf("/NP");
-    H5LTmake_dataset_int(file_id,dsname.CStr(),1,dims,data);
-    dims[0] = 3*Particles.Size();
-    dsname.Printf("Position");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Posvec);
-    dsname.Printf("Velocity");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Velvec);
-    dsname.Printf("Acceleration");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,ACCvec);
-    dims[0] = Particles.Size();
-    dsname.Printf("Tag");
-    H5LTmake_dataset_int(file_id,dsname.CStr(),1,dims,Tag);
-    dsname.Printf("Pressure");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Pressure);
-    dsname.Printf("Density");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Density);
-    dsname.Printf(OutputName[0]);
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Prop1);
-    dsname.Printf(OutputName[1]);
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Prop2);
-    dsname.Printf(OutputName[2]);
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Prop3);
-    dsname.Printf("Mass");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Mass);
-    dsname.Printf("h");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,sh);
-    dims[0] = 6*Particles.Size();
-    dsname.Printf("Sigma");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Sigma);
-    dsname.Printf("Strain");
-    H5LTmake_dataset_float(file_id,dsname.CStr(),1,dims,Strain);
-
-
-
-    delete [] Posvec;
-    delete [] Velvec;
-    delete [] ACCvec;
-    delete [] Pressure;
-    delete [] Prop1;
-    delete [] Prop2;
-    delete [] Prop3;
-    delete [] Density;
-    delete [] Mass;
-    delete [] sh;
-    delete [] Tag;
-    delete [] Sigma;
-    delete [] Strain;
-
-   //Closing the file
-    H5Fflush(file_id,H5F_SCOPE_GLOBAL);
-    H5Fclose(file_id);
-
-    //Writing xmf file
-    std::ostringstream oss;
-    oss << "<?xml version=\"1.0\" ?>\n";
-    oss << "<!DOCTYPE Xdmf SYSTEM \"Xdmf.dtd\" []>\n";
-    oss << "<Xdmf Version=\"2.0\">\n";
-    oss << " <Domain>\n";
-    oss << "   <Grid Name=\"SPHCenter\" GridType=\"Uniform\">\n";
-    oss << "     <Topology TopologyType=\"Polyvertex\" NumberOfElements=\"" << Particles.Size() << "\"/>\n";
-    oss << "     <Geometry GeometryType=\"XYZ\">\n";
-    oss << "       <DataItem Format=\"HDF\" NumberType=\"Float\" Precision=\"10\" Dimensions=\"" << Particles.Size() << " 3\" >\n";
-    oss << "        " << fn.CStr() <<":/Position \n";
-    oss << "       </DataItem>\n";
-    oss << "     </Geometry>\n";
-    oss << "     <Attribute Name=\"Tag\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Int\" Format=\"HDF\">\n";
-    oss << "        " << fn.CStr() <<":/Tag \n";
-    oss << "       </DataItem>\n";
-    oss << "     </Attribute>\n";
-    oss << "     <Attribute Name=\"Position\" AttributeType=\"Vector\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 3\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
-    oss << "        " << fn.CStr() <<":/Position \n";
-    oss << "       </DataItem>\n";
-    oss << "     </Attribute>\n";
-    oss << "     <Attribute Name=\"Velocity\" AttributeType=\"Vector\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 3\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
-    oss << "        " << fn.CStr() <<":/Velocity \n";
-    oss << "       </DataItem>\n";
-    oss << "     </Attribute>\n";
-    oss << "     <Attribute Name=\"Acceleration\" AttributeType=\"Vector\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 3\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
-    oss << "        " << fn.CStr() <<":/Acceleration \n";
-    oss << "       </DataItem>\n";
-    oss << "     </Attribute>\n";
-    oss << "     <Attribute Name=\"Density\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
-    oss << "        " << fn.CStr() <<":/Density \n";
-    oss << "       </DataItem>\n";
-    oss << "     </Attribute>\n";
-    oss << "     <Attribute Name=\"Pressure\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
-    oss << "        " << fn.CStr() <<":/Pressure \n";
-    oss << "       </DataItem>\n";
-    oss << "     </Attribute>\n";
-    oss << "     <Attribute Name=\"" << OutputName[0] << "\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
-    oss << "        " << fn.CStr() <<":/" << OutputName[0] << " \n";
-    oss << "       </DataItem>\n";
-    oss << "     </Attribute>\n";
-    oss << "     <Attribute Name=\"" << OutputName[1] << "\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
-    oss << "        " << fn.CStr() <<":/" << OutputName[1] << " \n";
-    oss << "       </DataItem>\n";
-    oss << "     </Attribute>\n";
-    oss << "     <Attribute Name=\"" << OutputName[2] << "\" AttributeType=\"Scalar\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << "\" NumberType=\"Float\" Precision=\"10\"  Format=\"HDF\">\n";
-    oss << "        " << fn.CStr() <<":/" << OutputName[2] << " \n";
-    oss << "       </DataItem>\n";
-    oss << "     </Attribute>\n";
-    oss << "     <Attribute Name=\"Sigma\" AttributeType=\"Tensor6\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 6\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
-    oss << "        " << fn.CStr() <<":/Sigma \n";
-    oss << "       </DataItem>\n";
-    oss << "     </Attribute>\n";
-    oss << "     <Attribute Name=\"Strain\" AttributeType=\"Tensor6\" Center=\"Node\">\n";
-    oss << "       <DataItem Dimensions=\"" << Particles.Size() << " 6\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
-    oss << "        " << fn.CStr() <<":/Strain \n";
-    oss << "       </DataItem>\n";
-    oss << "     </Attribute>\n";
-    oss << "   </Grid>\n";
-    oss << " </Domain>\n";
-    oss << "</Xdmf>\n";
-
-
-    fn = FileKey;
-    fn.append(".xmf");
-    std::ofstream of(fn.CStr(), std::ios::out);
-    of << oss.str();
-    of.close();
+	// Only the written fields are copied
+	#pragma omp parallel for schedule (static) private(P1,P2,P3) num_threads(Nproc)
+	for (size_t i=0;i<F.N;i++)
+	{
+		if (Fields & Out_Position)
+		{
+			F.Position	[3*i  ] = float(Particles[i]->x(0));
+			F.Position	[3*i+1] = float(Particles[i]->x(1));
+			F.Position	[3*i+2] = float(Particles[i]->x(2));
+		}
+		if (Fields & Out_Velocity)
+		{
+			F.Velocity	[3*i  ] = float(Particles[i]->v(0));
+			F.Velocity	[3*i+1] = float(Particles[i]->v(1));
+			F.Velocity	[3*i+2] = float(Particles[i]->v(2));
+		}
+		if (Fields & Out_Acceleration)
+		{
+			F.Acceleration	[3*i  ] = float(Particles[i]->a(0));
+			F.Acceleration	[3*i+1] = float(Particles[i]->a(1));
+			F.Acceleration	[3*i+2] = float(Particles[i]->a(2));
+		}
+		if (Fields & Out_Pressure)	F.Pressure	[i    ] = float(Particles[i]->Pressure);
+		if (Fields & Out_Density)	F.Density	[i    ] = float(Particles[i]->Density);
+		if (Fields & Out_Mass)		F.Mass		[i    ] = float(Particles[i]->Mass);
+		if (Fields & Out_h)		F.h		[i    ] = float(Particles[i]->h);
+		if (Fields & Out_Tag)		F.Tag		[i    ] = int  (Particles[i]->ID);
+		// Fluid particles have no stress and strain state
+		SolidState const * SS = Particles[i]->Solid;
+		if (Fields & Out_Sigma)
+		{
+			F.Sigma		[6*i  ] = (SS!=NULL ? float(SS->Sigma(0,0)) : 0.0f);
+			F.Sigma		[6*i+1] = (SS!=NULL ? float(SS->Sigma(0,1)) : 0.0f);
+			F.Sigma		[6*i+2] = (SS!=NULL ? float(SS->Sigma(0,2)) : 0.0f);
+			F.Sigma		[6*i+3] = (SS!=NULL ? float(SS->Sigma(1,1)) : 0.0f);
+			F.Sigma		[6*i+4] = (SS!=NULL ? float(SS->Sigma(1,2)) : 0.0f);
+			F.Sigma		[6*i+5] = (SS!=NULL ? float(SS->Sigma(2,2)) : 0.0f);
+		}
+		if (Fields & Out_Strain)
+		{
+			F.Strain	[6*i  ] = (SS!=NULL ? float(SS->Strain(0,0)) : 0.0f);
+			F.Strain	[6*i+1] = (SS!=NULL ? float(SS->Strain(0,1)) : 0.0f);
+			F.Strain	[6*i+2] = (SS!=NULL ? float(SS->Strain(0,2)) : 0.0f);
+			F.Strain	[6*i+3] = (SS!=NULL ? float(SS->Strain(1,1)) : 0.0f);
+			F.Strain	[6*i+4] = (SS!=NULL ? float(SS->Strain(1,2)) : 0.0f);
+			F.Strain	[6*i+5] = (SS!=NULL ? float(SS->Strain(2,2)) : 0.0f);
+		}
+
+		if (User)
+		{
+			UserOutput(Particles[i],P1,P2,P3);
+			F.Prop[0]	[i    ] = float(P1);
+			F.Prop[1]	[i    ] = float(P2);
+			F.Prop[2]	[i    ] = float(P3);
+		}
+	}
+}
+
+inline void Domain::WriteOutput (char const * FileKey)
+{
+	// The staging frame is written by the background thread while the solution goes on
+	if (!AsyncOutput) Writer.Wait();
+	OutputFrame & F = Writer.Acquire();
+	Snapshot(FileKey, F);
+	if (TimeSeries) F.Series = &Series;
+	if (AsyncOutput) Writer.Submit(); else WriteFrame(F);
+}
+
+inline void Domain::WriteXDMF (char const * FileKey)
+{
+	// HDF5 is only called by one thread at a time
+	Writer.Wait();
+	OutputFrame & F = Writer.Acquire();
+	Snapshot(FileKey, F);
+	WriteFrame(F);
 }
 
 }; // namespace SPH
@@ -23,21 +23,36 @@
 
 #include <stdio.h>    // for NULL
 #include <algorithm>  // for min,max
+#include <limits>     // for numeric_limits
 
 #include <hdf5.h>
 #include <hdf5_hl.h>
 
 #include <omp.h>
 
+#ifdef __linux__
+#include <sched.h>        // for sched_setaffinity
+#include <unistd.h>       // for syscall, sysconf
+#include <sys/syscall.h>  // for SYS_getcpu, SYS_move_pages
+#endif
+
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
 #include "Particle.h"
+#include "Particle_Data.h"
+#include "Pair_List.h"
 #include "Functions.h"
 #include "Boundary_Condition.h"
+#include "Output_Writer.h"
 
 
 //C++ Enum used for easiness of coding in the input files
 enum Kernels_Type { Qubic_Spline=0, Quintic=1, Quintic_Spline=2 };
 enum Viscosity_Eq_Type { Morris=0, Shao=1, Incompressible_Full=2, Takeda=3 };
 enum Gradient_Type { Squared_density=0, Multiplied_density=1 };
+enum Interaction_Mode_Type { Pair_Mode=0, Gather_Mode=1 };
 
 namespace SPH {
 
@@ -47,6 +62,7 @@ public:
 	typedef void (*PtVel) (Vec3_t & position, Vec3_t & Vel, double & Den, Boundary & bdry);
 	typedef void (*PtOut) (Particle * Particles, double & Prop1, double & Prop2,  double & Prop3);
 	typedef void (*PtDom) (Domain & dom);
+	typedef size_t (*PtRefine) (Domain & dom, Particle * P);
     // Constructor
     Domain();
 
@@ -54,6 +70,7 @@ public:
     ~Domain();
 
     // Domain Part
+    size_t AddMaterial			(MaterialProps const & M);		//Add a material to the material table, returns its index for Particle::MatID
     void AddSingleParticle	(int tag, Vec3_t const & x, double Mass, double Density, double h, bool Fixed);		//Add one particle
     void AddBoxLength				(int tag, Vec3_t const &V, double Lx, double Ly, double Lz,double r, double Density,
 																	double h,int type, int rotation, bool random, bool Fixed);									//Add a cube of particles with a defined dimensions
@@ -63,23 +80,38 @@ public:
     void CheckParticleLeave	();													//Check if any particles leave the domain, they will be deleted
 
     void YZPlaneCellsNeighbourSearch(int q1);						//Create pairs of particles in cells of XZ plan
+    void CellNeighbourSearch	(int q1, int q2, int q3, size_t T);	//Create pairs of particles of cell (q1,q2,q3) in the list of thread T
+    void AddPair				(int P1, int P2, size_t T);		//Add a pair of particles to the pair list of thread T
     void MainNeighbourSearch				();									//Create pairs of particles in the whole domain
+    void GatherListGenerate					();									//Create the full neighbour list of each particle from the pairs (gather mode)
     void StartAcceleration					(Vec3_t const & a = Vec3_t(0.0,0.0,0.0));	//Add a fixed acceleration such as the Gravity
     void PrimaryComputeAcceleration	();									//Compute the solid boundary properties
     void LastComputeAcceleration		();									//Compute the acceleration due to the other particles
-    void CalcForce11		(Particle * P1, Particle * P2);	//Calculates the contact force between fluid-fluid particles
-    void CalcForce2233	(Particle * P1, Particle * P2);	//Calculates the contact force between soil-soil/solid-solid particles
-    void CalcForce12		(Particle * P1, Particle * P2);	//Calculates the contact force between fluid-solid particles
-    void CalcForce13		(Particle * P1, Particle * P2);	//Calculates the contact force between fluid-soil particles
+    template <typename KP> void PairForces	(KP const & Ker);		//Runs CalcForce over all of the pairs with the kernel Ker
+    template <typename KP> void PairGeometry	(KP const & Ker);		//Fills the geometry of the same material pairs once per step
+    template <typename KP> void PairSums		(KP const & Ker);		//Geometry of the pairs, then sums of the fixed and FSI particles from their neighbours
+    template <typename KP> void PairGeometry	(size_t P1, size_t P2, KP const & Ker, PairGeom & G);	//Geometry of one pair
+    template <typename KP> double TIKernel	(size_t i, size_t j, double h, KP const & Ker) const;	//Kernel at the initial distance for the tensile instability
+    // The flags select the particles to be updated, both (pair mode with locks) or only one of them (gather mode without locks)
+    // KP is one of the kernel policies of Kernels.h, G is the geometry of the pair (see PairGeometry)
+    template <typename KP> void CalcForce11		(size_t i, size_t j, KP const & Ker, PairGeom const & G, bool Ui=true, bool Uj=true);		//Calculates the contact force between fluid-fluid particles (packed arrays)
+    template <typename KP> void CalcForce11Batch	(PairList const & L, size_t Begin, size_t End, KP const & Ker);	//Runs the same material pairs [Begin,End) of L, free Newtonian fluid pairs in SIMD blocks
+    template <typename KP> void CalcForce2233	(size_t i, size_t j, KP const & Ker, PairGeom const & G, bool U1=true, bool U2=true);		//Calculates the contact force between soil-soil/solid-solid particles
+    template <typename KP> void CalcForce12		(Particle * P1, Particle * P2, KP const & Ker, bool U1=true, bool U2=true);	//Calculates the contact force between fluid-solid particles
+    template <typename KP> void CalcForce13		(Particle * P1, Particle * P2, KP const & Ker, bool U1=true, bool U2=true);	//Calculates the contact force between fluid-soil particles
     void Move						(double dt);										//Move particles
 
     void Solve					(double tf, double dt, double dtOut, char const * TheFileKey, size_t maxidx);		///< The solving function
 
-    void CellInitiate		();															//Find the size of the domain as a cube, make cells and HOCs
-    void ListGenerate		();															//Generate linked-list
-    void CellReset			();															//Reset HOCs and particles' LL to initial value of -1
+    void CellInitiate		();															//Find the size of the domain as a cube, make cells and the cell list
+    void ListGenerate		();															//Sort particles into the cells (parallel counting sort)
+    void CellReset			();															//Reset the lists that are rebuilt by ListGenerate
+    int  CellIndex			(int i, int j, int k) const;					//Index of cell (i,j,k) in the cell list
+    int  ParticleCell		(size_t a);												//Index of the cell of particle a, the cell numbers are saved in Particle::CC
+    void Reorder				();															//Sort particles along a Morton curve to improve memory locality
+    void Refine					();															//Split and merge particles to the levels given by RefineLevel
 
-    void WriteXDMF			(char const * FileKey);					//Save a XDMF file for the visualization
+    void WriteXDMF			(char const * FileKey);					//Save a XDMF file for the visualization (waits for the background output)
 
 
     void InFlowBCLeave	();
@@ -89,8 +121,11 @@ public:
 		void Kernel_Set									(Kernels_Type const & KT);
 		void Viscosity_Eq_Set						(Viscosity_Eq_Type const & VQ);
 		void Gradient_Approach_Set			(Gradient_Type const & GT);
+		void Interaction_Mode_Set				(Interaction_Mode_Type const & IM);
     // Data
     Array <Particle*>				Particles; 	///< Array of particles
+    Array <MaterialProps>			Materials;	///< Material table, particles refer to their material by Particle::MatID
+    ParticleData				PD;		///< Packed (structure of arrays) copy of particles for the interaction loops
     double					R;		///< Particle Radius in addrandombox
 
 		double					sqrt_h_a;				//Coefficient for determining Time Step based on acceleration (can be defined by user)
@@ -111,17 +146,43 @@ public:
     Vec3_t                 			DomSize;	///< Each component of the vector is the domain size in that direction if periodic boundary condition is defined in that direction as well
     double					rhomax;
 
-    int						*** HOC;	///< Array of "Head of Chain" for each cell
+    int						* CellStart;	///< Position of the first particle of each cell in CellPart
+    int						* CellCount;	///< No of particles in each cell
+    int						* CellPart;	///< Particle indices sorted by cell
+    int						* StaticStart;	///< Position of the first fixed particle of each cell in StaticPart (StaticBoundary)
+    int						* StaticCount;	///< No of fixed particles in each cell (StaticBoundary)
+    int						* StaticPart;	///< Fixed particle indices sorted by cell (StaticBoundary)
 
     size_t					SWIType;	///< Selecting variable to choose Soil-Water Interaction type
     bool					FSI;		///< Selecting variable to choose Fluid-Structure Interaction
 
     double 					XSPH;		///< Velocity correction factor
+    double					VerletSkin;	///< Skin distance of Verlet neighbour lists (0 => neighbour search at every time step)
+    size_t					KernelTableSize;	///< No of intervals of the tabulated kernel (0 => analytic kernels, 1000 intervals give a relative error of about 2e-6)
+    bool					StaticBoundary;	///< Fixed particles are sorted once into a static cell list and only searched from free particles (default false, only for models whose fixed particles never move or change, rebuilt at every step with MPI)
+    bool					FluidBatch;	///< Free Newtonian fluid pairs are computed in SIMD blocks in pair mode (default true)
+    double					CFLFactor;	///< Safety factor of the time step controller with acoustic and viscous limits at each step (0 => user time step and acceleration limit only)
+    size_t					TimeBins;	///< Levels of the block time stepping, particles move with deltat/2^b for b<=TimeBins (0 => one global time step, >0 needs the gather mode)
+    size_t					SleepSteps;	///< Free soil/solid particles below the sleeping thresholds for SleepSteps steps are put to sleep (0 => never)
+    double					SleepVelocity;	///< Velocity threshold of the sleeping particles, a sleeping particle is woken by a faster neighbour
+    double					SleepAcceleration;	///< Acceleration threshold of the sleeping particles
+    double					SleepStrainRate;	///< Strain rate (norm) threshold of the sleeping particles
+    size_t					RefineStep;	///< Particles are split and merged every RefineStep time steps (0 => never), particle indices are not kept
+    size_t					RefineMax;	///< Max refinement level, a particle of level L has the mass of the initial particle / 2^(Dimension*L)
+    size_t					ReorderStep;	///< Particles are reordered along a Morton curve every ReorderStep time steps (0 => never), particle indices are not kept
     double 					InitialDist;	///< Initial distance of particles for Inflow BC
 
     double					AvgVelocity;	///< Average velocity of the last two column for x periodic constant velocity
 
     size_t					Nproc;		///< No of threads which are going to use in parallel calculation
+    bool					AsyncOutput;	///< The output files of Solve are written by a background thread from staging buffers (default true)
+    OutputProfile				Output;		///< Fields, quantization and compression of the output files (default all of the fields in float without filters)
+    bool					TimeSeries;	///< All outputs of Solve are appended to one FileKey.hdf5 with a temporal XDMF collection in FileKey.xmf (default false)
+    bool					NUMA;		///< Pins the threads and places each particle on the NUMA node of the thread moving it (first touch, default false)
+    int						Rank;		///< Rank of this process (USE_MPI, 0 otherwise)
+    int						NRanks;		///< No of processes, each one solves the particles of its subdomain (USE_MPI, 1 otherwise)
+    size_t					BalanceStep;	///< The subdomains are rebalanced every BalanceStep time steps (USE_MPI, 0 => only at the start)
+    bool					Distributed;	///< Each rank built only a part of the model before Solve, e.g. the rank 0 all of it and the others nothing (USE_MPI, default false => all ranks built the whole model)
     omp_lock_t 					dom_lock;	///< Open MP lock to lock Interactions array
     Boundary					BC;
     PtOut					UserOutput;
@@ -132,36 +193,112 @@ public:
     Vec3_t					DomMin;
     PtDom					GeneralBefore;	///< Pointer to a function: to modify particles properties before CalcForce function
     PtDom					GeneralAfter;	///< Pointer to a function: to modify particles properties after CalcForce function
+    PtRefine					RefineLevel;	///< Pointer to a function: the requested refinement level of a particle (region or criteria of the refinement), called serially
     size_t					Scheme;		///< Integration scheme: 0 = Modified Verlet, 1 = Leapfrog
 
-    Array<Array<std::pair<size_t,size_t> > >	SMPairs;
-    Array<Array<std::pair<size_t,size_t> > >	NSMPairs;
-    Array<Array<std::pair<size_t,size_t> > >	FSMPairs;
+    Array<PairList>				SMPairs;
+    Array<PairList>				NSMPairs;
+    Array<PairList>				FSMPairs;
     Array< size_t > 				FixedParticles;
     Array< size_t >				FreeFSIParticles;
 
-    Array<std::pair<size_t,size_t> >		Initial;
+    PairList					Initial;
     Mat3_t I;
     String					OutputName[3];
 
 
 	private:
 		void Periodic_X_Correction	(Vec3_t & x, double const & h, Particle * P1, Particle * P2);		//Corrects xij for the periodic boundary condition
+		void Periodic_X_Correction	(Vec3_t & x, double const & h, int const * CC1, int const * CC2);	//Corrects xij for the periodic boundary condition using cell numbers
 		void AdaptiveTimeStep				();		//Uses the minimum time step to smoothly vary the time step
-
+		bool VerletCheck						();		//Checks if the Verlet neighbour lists must be rebuilt
+		void VerletRecord						();		//Saves the particles' positions at the neighbour search
+		void PairSlice							(size_t N, size_t T, size_t & Begin, size_t & End) const;	//Range of a pair list processed by thread T
+		double TimeStepLimit				(Particle const * P) const;	//Largest stable time step of a free particle
+		void BlockActivate					();		//Marks the particles integrated at the current sub-step of the block time stepping
+		void BlockMove							();		//Assigns the time bins of the active particles and moves them
+		void TensileInstability3D		(bool Fixed);	//Artificial stress TIR of the free (or fixed) soil/solid particles in 3D
+		bool Quiet									(Particle const * P) const;	//The particle is below the sleeping thresholds
+		void SleepCheck							();		//Puts the quiet soil/solid particles to sleep and wakes the disturbed ones
+
+		void PinThreads							();		//Binds each thread to one CPU if the OpenMP runtime does not bind them (NUMA)
+		void FirstTouch							();		//Copies each particle by the thread which owns it in the static schedule (NUMA)
+		void NUMAReport							();		//Prints the CPU and node of the threads and the node of their particles (NUMA)
+
+		void StaticListGenerate			();		//Sorts the fixed particles into the static cell list
+		void PeriodicCells					(int * Start, int * Count);	//Ghost cells of the periodic BC point to the cells of the opposite side
+
+		void SolveSteps			(double tf, double dt, double dtOut, char const * TheFileKey, size_t maxidx);	//Time loop of Solve, which aborts all of the MPI ranks if it throws on one of them
 		void PrintInput			(char const * FileKey);		//Print out some initial parameters as a file
+		void Snapshot				(char const * FileKey, OutputFrame & F);	//Copies the output fields of the particles into the staging frame F
+		void WriteOutput		(char const * FileKey);		//Output of Solve, in the background with AsyncOutput
 		void InitialChecks	();		//Checks some parameter before proceeding to the solution
 		void TimestepCheck	();		//Checks the user time step with CFL approach
 
+#ifdef USE_MPI
+		// Domain decomposition (Decomposition.cpp), the ghost particles of the other subdomains are kept at the end of Particles
+		void InitMPI				();		//Initialises MPI if needed, sets Rank and NRanks
+		void Decompose			();		//Recursive coordinate bisection of the particles into NRanks boxes of the same No of particles
+		void Bisect					(int R0, int R1, Vec3_t const & Min, Vec3_t const & Max);	//Splits the box [Min,Max) among the ranks [R0,R1)
+		int  SubdomainOf		(Vec3_t const & x) const;	//Rank of the box containing x
+		void Exchange				(Array< Array<double> > const & Send, Array<double> & Recv, Array<int> & RecvCount);	//All to all exchange of Send[r] with rank r
+		void Migrate				(bool Replicated);	//Sends the particles outside the own box to their owners in chunks (Replicated => the others have them)
+		void HaloExchange		();		//Copies the particles within the cut-off of the other boxes to them as ghosts
+		void HaloUpdate			();		//Sends the values computed by PrimaryComputeAcceleration to the ghosts
+		void HaloClear			();		//Deletes the ghost particles
+
+		Array<Vec3_t>		SubMin;					//Low corner of the box of each rank
+		Array<Vec3_t>		SubMax;					//High corner of the box of each rank
+		Array< Array<size_t> >	HaloList;	//Owned particles sent to each rank as ghosts
+		Array<int>			HaloCount;			//No of ghosts received from each rank
+#endif
+		size_t					NGhost;					//No of ghost particles at the end of Particles (USE_MPI)
+
 		size_t					VisEq;					//Choose viscosity Eq based on different SPH discretisation
 		size_t					KernelType;			//Choose a kernel
 		size_t					GradientType;		//Choose a Gradient approach 1/Rho i^2 + 1/Rho j^2 or 1/(Rho i * Rho j)
+		TabulatedKernel	KernelTable;		//Lookup table of the kernel, used if KernelTableSize > 0
+		size_t					InteractionMode;	//Choose pair mode (each pair once, locks) or gather mode (each particle gathers from all of its pairs)
 		double 					Cellfac;				//Define the compact support of a kernel
 
+		int						* CellBuffer;		//Single allocation of CellStart, CellCount, CellCost, SearchCells, SearchCost and CellHist
+		int						* CellHist;			//Particle counters of each thread and cell for the counting sort
+		int						* CellCost;			//No of pairs found in each cell by the last neighbour search (load balance)
+		int						* SearchCells;	//Non-empty cells in the order of the neighbour search
+		int						* SearchCost;		//Prefix sum of the cost of SearchCells, used to split them among the threads
+		int						* PartBuffer;		//Single allocation of CellPart and PartCell
+		int						* PartCell;			//Cell index of each particle
+		int							PartCapacity;		//Allocated size of CellPart and PartCell
+		int						* StaticBuffer;	//Single allocation of StaticStart, StaticCount and StaticPart
+		bool						StaticRebuild;	//The static cell list must be rebuilt (new cells or particle indices changed)
+
+		int						* NeighStart;		//Position of the first pair of each particle in NeighPairs (gather mode)
+		int						* NeighFill;		//Filling position of each particle in NeighPairs
+		int							NeighCapacity;	//Allocated size of NeighStart and NeighFill
+		PairList::Pair_t		* NeighPairs;	//Pairs of each particle, every pair is stored for both particles
+		size_t					NeighPairsCapacity;	//Allocated size of NeighPairs
+
+		bool						VerletRebuild;	//Forces a new neighbour search (particles deleted or recycled)
+		size_t					VerletBuilds;		//No of neighbour searches with Verlet lists
+		Array<Vec3_t>		VerletX;				//Positions of particles at the last neighbour search
+
 		double					Time;    				//Current time of simulation at each solving step
 		double					deltat;					//Time Step
     double					deltatmin;			//Minimum Time Step
     double					deltatint;			//Initial Time Step
+		size_t					TimeSub;				//Current sub-step of the block time stepping
+		size_t					BlockUpdates;		//No of particle moves with the block time stepping
+		size_t					BlockFullUpdates;	//No of particle moves that a global time step would have done
+		size_t					SleepUpdates;		//No of particle steps skipped by the sleeping particles
+		size_t					SleepFullUpdates;	//No of free particle steps
+		Array<char>				SleepWake;		//Sleeping particles woken by a pair of the step (SleepCheck)
+		double					PackTime;		//Wall time of ParticleData::Pack and Unpack
+		double					ForceTime;		//Wall time of the pair force loops, packing included
+		Array<size_t>		Families;				//Family of the parent particle of each split (particle refinement)
+		size_t					RefineSplits;		//No of split particles
+		size_t					RefineMerges;		//No of merged families
+		OutputSeries		Series;					//Time series file of the outputs (TimeSeries), closed after the writer stops
+		OutputWriter		Writer;					//Background writer of the output files with two staging frames
 
 };
 
@@ -169,5 +306,8 @@ public:
 
 #include "Interaction.cpp"
 #include "Domain.cpp"
+#ifdef USE_MPI
+#include "Decomposition.cpp"
+#endif
 
 #endif // SPH_DOMAIN_H
@@ -24,33 +24,16 @@ namespace SPH {
 
 	inline double Kernel(size_t const & Dim, size_t const & KT, double const & q, double const & h)
 	{
-		double C;
-
 		switch (KT)
 		{
 			case 0:	// Qubic Spline
-				Dim == 2 ? C = 10.0/(7.0*h*h*M_PI) : C = 1.0/(h*h*h*M_PI);
-
-				if 			(q<1.0)	return C*(1.0-(3.0/2.0)*q*q+(3.0/4.0)*q*q*q);
-				else if (q<2.0)	return C*((1.0/4.0)*(2.0-q)*(2.0-q)*(2.0-q));
-				else						return 0.0;
-				break;
+				return (Dim == 2) ? QubicSplineKernel<2>().Kernel(q,h) : QubicSplineKernel<3>().Kernel(q,h);
 
 			case 1:	// Quintic
-				Dim ==2 ? C = 7.0/(4.0*h*h*M_PI) : C = 7.0/(8.0*h*h*h*M_PI);
-
-				if			(q<2.0)	return C*pow((1.0-q/2.0),4.0)*(2.0*q+1.0);
-				else						return 0.0;
-				break;
+				return (Dim == 2) ? QuinticKernel<2>().Kernel(q,h) : QuinticKernel<3>().Kernel(q,h);
 
 			case 2:	// Quintic Spline
-				Dim ==2 ? C = 7.0/(478.0*h*h*M_PI) : C = 1.0/(120.0*h*h*h*M_PI);
-
-				if			(q<1.0)	return C*(pow((3.0-q),5.0)-6.0*pow((2.0-q),5.0)+15.0*pow((1.0-q),5.0));
-				else if (q<2.0)	return C*(pow((3.0-q),5.0)-6.0*pow((2.0-q),5.0));
-				else if (q<3.0)	return C*(pow((3.0-q),5.0));
-				else						return 0.0;
-				break;
+				return (Dim == 2) ? QuinticSplineKernel<2>().Kernel(q,h) : QuinticSplineKernel<3>().Kernel(q,h);
 
 			default:
 				std::cout << "Kernel Type No is out of range. Please correct it and run again" << std::endl;
@@ -64,36 +47,16 @@ namespace SPH {
 
 	inline double GradKernel(size_t const & Dim, size_t const & KT, double const & q, double const & h)
 	{
-		double C;
-
 		switch (KT)
 		{
 			case 0:	// Qubic Spline
-				Dim ==2 ? C = 10.0/(7.0*h*h*h*M_PI) : C = 1.0/(h*h*h*h*M_PI);
-
-				if 			(q==0.0)	return C/h    *(-3.0+(9.0/2.0)*q);
-				else if (q<1.0)		return C/(q*h)*(-3.0*q+(9.0/4.0)*q*q);
-				else if (q<2.0)		return C/(q*h)*((-3.0/4.0)*(2.0-q)*(2.0-q));
-				else							return 0.0;
-				break;
+				return (Dim == 2) ? QubicSplineKernel<2>().GradKernel(q,h) : QubicSplineKernel<3>().GradKernel(q,h);
 
 			case 1:	// Quintic
-				Dim ==2 ? C = 7.0/(4.0*h*h*h*M_PI) : C = 7.0/(8.0*h*h*h*h*M_PI);
-
-				if 			(q==0.0)	return C*-5.0/h*(pow((1.0-q/2.0),3.0)-3.0*q/2.0*pow((1.0-q/2.0),2.0));
-				else if (q<2.0)		return C/(q*h)*-5.0*q*pow((1.0-q/2.0),3.0);
-				else							return 0.0;
-				break;
+				return (Dim == 2) ? QuinticKernel<2>().GradKernel(q,h) : QuinticKernel<3>().GradKernel(q,h);
 
 			case 2:	// Quintic Spline
-				Dim ==2 ? C = 7.0/(478.0*h*h*h*M_PI) : C = 1.0/(120.0*h*h*h*h*M_PI);
-
-				if			(q==0.0)	return C/h*    (20.0*pow((3.0-q),3.0)-120.0*pow((2.0-q),3.0)+300.0*pow((1.0-q),3.0));
-				else if (q<1.0)		return C/(q*h)*(-5.0*pow((3.0-q),4.0)+30.0*pow((2.0-q),4.0)-75.0*pow((1.0-q),4.0));
-				else if (q<2.0)		return C/(q*h)*(-5.0*pow((3.0-q),4.0)+30.0*pow((2.0-q),4.0));
-				else if (q<3.0)		return C/(q*h)*(-5.0*pow((3.0-q),4.0));
-				else							return 0.0;
-				break;
+				return (Dim == 2) ? QuinticSplineKernel<2>().GradKernel(q,h) : QuinticSplineKernel<3>().GradKernel(q,h);
 
 			default:
 				std::cout << "Kernel Type No is out of range. Please correct it and run again" << std::endl;
@@ -107,33 +70,16 @@ namespace SPH {
 
 	inline double LaplaceKernel(size_t const & Dim, size_t const & KT, double const & q, double const & h)
 	{
-		double C;
-
 		switch (KT)
 		{
 			case 0:	// Qubic Spline
-				Dim ==2 ? C = 10.0/(7.0*h*h*h*h*M_PI) : C = 1.0/(h*h*h*h*h*M_PI);
-
-				if			(q<1.0)	return C*(-3.0+(9.0/2.0)*q)  + C*(Dim-1.0)/q * (-3.0*q+(9.0/4.0)*q*q);
-				else if (q<2.0) return C*((3.0/2.0)*(2.0-q)) + C*(Dim-1.0)/q * ((-3.0/4.0)*(2.0-q)*(2.0-q));
-				else						return 0.0;
-				break;
+				return (Dim == 2) ? QubicSplineKernel<2>().LaplaceKernel(q,h) : QubicSplineKernel<3>().LaplaceKernel(q,h);
 
 			case 1:	// Quintic
-				Dim ==2 ? C = 7.0/(4.0*h*h*h*h*M_PI) : C = 7.0/(8.0*h*h*h*h*h*M_PI);
-
-				if 			(q<2.0)	return C*pow((1.0-q/2.0),2.0)*(10.0*q-5.0) + C*(Dim-1.0)/q * -5.0*q*pow((1.0-q/2.0),3.0);
-				else						return 0.0;
-				break;
+				return (Dim == 2) ? QuinticKernel<2>().LaplaceKernel(q,h) : QuinticKernel<3>().LaplaceKernel(q,h);
 
 			case 2:	// Quintic Spline
-				Dim ==2 ? C = 7.0/(478.0*h*h*h*h*M_PI) : C = 1.0/(120.0*h*h*h*h*h*M_PI);
-
-				if			(q<1.0)	return C*(20.0*pow((3.0-q),3.0)-120.0*pow((2-q),3.0)+300.0*pow((1-q),3.0))	+ C*(Dim-1.0)/q * (-5.0*pow((3.0-q),4.0)+30.0*pow((2.0-q),4.0)-75.0*pow((1.0-q),4.0));
-				else if (q<2.0)	return C*(20.0*pow((3.0-q),3.0)-120.0*pow((2-q),3.0))												+ C*(Dim-1.0)/q * (-5.0*pow((3.0-q),4.0)+30.0*pow((2.0-q),4.0));
-				else if (q<3.0)	return C*(20.0*pow((3.0-q),3.0))																						+ C*(Dim-1.0)/q * (-5.0*pow((3.0-q),4.0));
-				else						return 0.0;
-				break;
+				return (Dim == 2) ? QuinticSplineKernel<2>().LaplaceKernel(q,h) : QuinticSplineKernel<3>().LaplaceKernel(q,h);
 
 			default:
 				std::cout << "Kernel Type No is out of range. Please correct it and run again" << std::endl;
@@ -147,33 +93,16 @@ namespace SPH {
 
 	inline double SecDerivativeKernel(size_t const & Dim, size_t const & KT, double const & q, double const & h)
 	{
-		double C;
-
 		switch (KT)
 		{
 			case 0:	// Qubic Spline
-				Dim ==2 ? C = 10.0/(7.0*h*h*h*h*M_PI) : C = 1.0/(h*h*h*h*h*M_PI);
-
-				if 			(q<1.0)	return C*(-3.0+(9.0/2.0)*q);
-				else if (q<2.0)	return C*((3.0/2.0)*(2.0-q));
-				else						return 0.0;
-				break;
+				return (Dim == 2) ? QubicSplineKernel<2>().SecDerivativeKernel(q,h) : QubicSplineKernel<3>().SecDerivativeKernel(q,h);
 
 			case 1:	// Quintic
-				Dim ==2 ? C = 7.0/(4.0*h*h*h*h*M_PI) : C = 7.0/(8.0*h*h*h*h*h*M_PI);
-
-				if			(q<2.0)	return C*pow((1.0-q/2.0),2.0)*(10.0*q-5.0);
-				else						return 0.0;
-				break;
+				return (Dim == 2) ? QuinticKernel<2>().SecDerivativeKernel(q,h) : QuinticKernel<3>().SecDerivativeKernel(q,h);
 
 			case 2:	// Quintic Spline
-				Dim ==2 ? C = 7.0/(478.0*h*h*h*h*M_PI) : C = 1.0/(120.0*h*h*h*h*h*M_PI);
-
-				if			(q<1.0)	return C*(20.0*pow((3.0-q),3.0)-120.0*pow((2.0-q),3.0)+300.0*pow((1.0-q),3.0));
-				else if (q<2.0)	return C*(20.0*pow((3.0-q),3.0)-120.0*pow((2.0-q),3.0));
-				else if (q<3.0)	return C*(20.0*pow((3.0-q),3.0));
-				else						return 0.0;
-				break;
+				return (Dim == 2) ? QuinticSplineKernel<2>().SecDerivativeKernel(q,h) : QuinticSplineKernel<3>().SecDerivativeKernel(q,h);
 
 			default:
 				std::cout << "Kernel Type No is out of range. Please correct it and run again" << std::endl;
@@ -297,8 +226,8 @@ namespace SPH {
 		}
 	}
 
-	inline void Viscous_Force(size_t const & VisEq, Vec3_t & VI, double const & Mu, double const & di,  double const & dj, double const & GK, Vec3_t const & vab,
-															size_t const & Dimension, double const & KernelType, double const & rij, double const & h, Vec3_t const & xij, Vec3_t const & vij)
+	template <typename KP> inline void Viscous_Force(size_t const & VisEq, Vec3_t & VI, double const & Mu, double const & di,  double const & dj, double const & GK, Vec3_t const & vab,
+															KP const & Ker, double const & rij, double const & h, Vec3_t const & xij, Vec3_t const & vij)
 	{
 		switch (VisEq)
 		{
@@ -311,13 +240,13 @@ namespace SPH {
 				break;
 
 			case 2:	//Real Viscosity (considering incompressible fluid)
-				VI = -Mu/(di*dj)*LaplaceKernel(Dimension, KernelType, rij/h, h)*vab;
+				VI = -Mu/(di*dj)*Ker.LaplaceKernel(rij/h, h)*vab;
 				break;
 
 			case 3:	//Takeda et al 1994
-				VI = -Mu/(di*dj)*( LaplaceKernel(Dimension, KernelType, rij/h, h)*vab +
+				VI = -Mu/(di*dj)*( Ker.LaplaceKernel(rij/h, h)*vab +
 						1.0/3.0*(GK*vij + dot(vij,xij) * xij / (rij*rij) *
-						(-GK+SecDerivativeKernel(Dimension, KernelType, rij/h, h) ) ) );
+						(-GK+Ker.SecDerivativeKernel(rij/h, h) ) ) );
 				break;
 				
 			default:
@@ -347,6 +276,61 @@ namespace SPH {
 								0.0   , 0.0   , Val(2);
 	}
 
+	inline __attribute__((always_inline)) void JacobiRotation (double & App, double & Aqq, double & Apq, double & Arp, double & Arq,
+					double & V0p, double & V1p, double & V2p, double & V0q, double & V1q, double & V2q)
+	{
+		// Rotation in the (p,q) plane which zeroes Apq of a symmetric 3x3 matrix (r is the third index), the
+		// eigenvectors are accumulated in the columns p and q of V. It has no branches, Apq = 0 gives t = 0.
+		// Forced inline so the omp simd loop of TensileInstabilityR can be vectorised
+		double d	= Aqq - App;
+		double t	= 2.0*Apq*copysign(1.0,d)/(fabs(d) + sqrt(d*d + 4.0*Apq*Apq) + 1.0e-300);
+		double c	= 1.0/sqrt(1.0 + t*t);
+		double s	= t*c;
+		double rp	= Arp;
+		double vp;
+
+		App	-= t*Apq;
+		Aqq	+= t*Apq;
+		Apq	 = 0.0;
+		Arp	 = c*rp - s*Arq;
+		Arq	 = s*rp + c*Arq;
+		vp = V0p; V0p = c*vp - s*V0q; V0q = s*vp + c*V0q;
+		vp = V1p; V1p = c*vp - s*V1q; V1q = s*vp + c*V1q;
+		vp = V2p; V2p = c*vp - s*V2q; V2q = s*vp + c*V2q;
+	}
+
+	inline void TensileInstabilityR (size_t N, double const * S00, double const * S11, double const * S22, double const * S01, double const * S02, double const * S12,
+					double const * F, double * R00, double * R11, double * R22, double * R01, double * R02, double * R12)
+	{
+		// Artificial stress R = V diag(-F*max(Val,0)) V^T of the tensile instability from the principal stresses of N
+		// symmetric stresses, cyclic Jacobi with a fixed No of sweeps (converged to round-off for 3x3) in a SIMD loop
+		#pragma omp simd
+		for (size_t n=0; n<N; n++)
+		{
+			double A00 = S00[n], A11 = S11[n], A22 = S22[n], A01 = S01[n], A02 = S02[n], A12 = S12[n];
+			double V00 = 1.0, V01 = 0.0, V02 = 0.0;
+			double V10 = 0.0, V11 = 1.0, V12 = 0.0;
+			double V20 = 0.0, V21 = 0.0, V22 = 1.0;
+			// Five sweeps written out, a loop inside the SIMD loop is not vectorised
+			#define SPH_JACOBI_SWEEP \
+				JacobiRotation(A00, A11, A01, A02, A12, V00, V10, V20, V01, V11, V21); /* (p,q,r) = (0,1,2) */ \
+				JacobiRotation(A00, A22, A02, A01, A12, V00, V10, V20, V02, V12, V22); /* (p,q,r) = (0,2,1) */ \
+				JacobiRotation(A11, A22, A12, A01, A02, V01, V11, V21, V02, V12, V22); /* (p,q,r) = (1,2,0) */
+			SPH_JACOBI_SWEEP SPH_JACOBI_SWEEP SPH_JACOBI_SWEEP SPH_JACOBI_SWEEP SPH_JACOBI_SWEEP
+			#undef SPH_JACOBI_SWEEP
+
+			double L0 = -F[n]*std::max(A00, 0.0);
+			double L1 = -F[n]*std::max(A11, 0.0);
+			double L2 = -F[n]*std::max(A22, 0.0);
+			R00[n] = L0*V00*V00 + L1*V01*V01 + L2*V02*V02;
+			R11[n] = L0*V10*V10 + L1*V11*V11 + L2*V12*V12;
+			R22[n] = L0*V20*V20 + L1*V21*V21 + L2*V22*V22;
+			R01[n] = L0*V00*V10 + L1*V01*V11 + L2*V02*V12;
+			R02[n] = L0*V00*V20 + L1*V01*V21 + L2*V02*V22;
+			R12[n] = L0*V10*V20 + L1*V11*V21 + L2*V12*V22;
+		}
+	}
+
 	inline Mat3_t abab (Mat3_t const & A, Mat3_t const & B)
 	{
 		Mat3_t M;
@@ -356,4 +340,28 @@ namespace SPH {
 		return M;
 	}
 
+	inline unsigned long long MortonKey (size_t const & Dim, unsigned int const & i, unsigned int const & j, unsigned int const & k)
+	{
+		// Interleaves the bits of the grid coordinates, 32 bits each in 2D and 21 bits each in 3D
+		unsigned long long key = 0;
+		if (Dim == 2)
+		{
+			for (size_t b=0; b<32; b++)
+			{
+				key |= ((unsigned long long)((i >> b) & 1u)) << (2*b);
+				key |= ((unsigned long long)((j >> b) & 1u)) << (2*b+1);
+			}
+		}
+		else
+		{
+			for (size_t b=0; b<21; b++)
+			{
+				key |= ((unsigned long long)((i >> b) & 1u)) << (3*b);
+				key |= ((unsigned long long)((j >> b) & 1u)) << (3*b+1);
+				key |= ((unsigned long long)((k >> b) & 1u)) << (3*b+2);
+			}
+		}
+		return key;
+	}
+
 }; // namespace SPH
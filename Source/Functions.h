@@ -22,6 +22,7 @@
 #define SPH_SPECIAL_FUNCTIONS_H
 
 #include "matvec.h"
+#include "Kernels.h"
 
 namespace SPH {
 
@@ -41,13 +42,22 @@ namespace SPH {
 
 	void   Seepage							(size_t const & ST, double const & k, double const & k2, double const & mu,  double const & rho, double & SF1, double & SF2);
 
+	template <typename KP>
 	void   Viscous_Force				(size_t const & VisEq, Vec3_t & VI, double const & Mu, double const & di,  double const & dj, double const & GK, Vec3_t const & vab,
-																size_t const & Dimension, double const & KernelType, double const & rij, double const & h, Vec3_t const & xij, Vec3_t const & vij);
+																KP const & Ker, double const & rij, double const & h, Vec3_t const & xij, Vec3_t const & vij);
 
 	void   Rotation							(Mat3_t Input, Mat3_t & Vectors, Mat3_t & VectorsT, Mat3_t & Values);
 
+	void   JacobiRotation			(double & App, double & Aqq, double & Apq, double & Arp, double & Arq,
+																double & V0p, double & V1p, double & V2p, double & V0q, double & V1q, double & V2q);
+
+	void   TensileInstabilityR	(size_t N, double const * S00, double const * S11, double const * S22, double const * S01, double const * S02, double const * S12,
+																double const * F, double * R00, double * R11, double * R22, double * R01, double * R02, double * R12);
+
 	Mat3_t abab									(Mat3_t const & A, Mat3_t const & B);
 
+	unsigned long long MortonKey	(size_t const & Dim, unsigned int const & i, unsigned int const & j, unsigned int const & k);
+
 }; // namespace SPH
 
 #include "Functions.cpp"
@@ -22,114 +22,126 @@
 
 namespace SPH {
 
-inline void Domain::CalcForce11(Particle * P1, Particle * P2)
+template <typename KP> inline double Domain::TIKernel(size_t i, size_t j, double h, KP const & Ker) const
 {
-	double h		= (P1->h+P2->h)/2;
-	Vec3_t xij	= P1->x - P2->x;
+	// The value does not change in time, it is taken from PD.TIKernel when both particles share h and TIInitDist
+	if (PD.TIInitDist[i] == PD.TIInitDist[j] && PD.h[i] == PD.h[j]) return PD.TIKernel[i];
+	return Ker.Kernel((PD.TIInitDist[i] + PD.TIInitDist[j])/(2.0*h), h);
+}
 
-	Periodic_X_Correction(xij, h, P1, P2);
-	double rij	= norm(xij);
+template <typename KP> inline void Domain::CalcForce11(size_t i, size_t j, KP const & Ker, PairGeom const & G, bool Ui, bool Uj)
+{
+	// Locks are only needed when both particles are updated (pair mode)
+	bool Lock	= Ui && Uj;
+
+	// Fluid-fluid pairs run on the packed arrays (PD), see ParticleData::Pack
+	double h		= (PD.h[i]+PD.h[j])/2;
+	Vec3_t xij	= G.Xij();
+	double rij	= G.rij;
 
 	if ((rij/h)<=Cellfac)
 	{
+		MaterialProps const & Mi	= PD.Props(i);
+		MaterialProps const & Mj	= PD.Props(j);
 		double di=0.0,dj=0.0,mi=0.0,mj=0.0;
-		double Alpha	= (P1->Alpha + P2->Alpha)/2.0;
-		double Beta	= (P1->Beta + P2->Beta)/2.0;
-		Vec3_t vij	= P1->v - P2->v;
+		double Alpha	= (Mi.Alpha + Mj.Alpha)/2.0;
+		double Beta	= (Mi.Beta + Mj.Beta)/2.0;
+		Vec3_t vij	= PD.Velocity(i) - PD.Velocity(j);
 
 
-		if (!P1->IsFree)
+		if (!PD.IsFree[i])
 		{
-			di = DensitySolid(P2->PresEq, P2->Cs, P2->P0,P1->Pressure, P2->RefDensity);
-			mi = P1->FPMassC * P2->Mass;
+			di = DensitySolid(Mj.PresEq, Mj.Cs, Mj.P0,PD.Pressure[i], PD.RefDensity[j]);
+			mi = PD.FPMassC[i] * PD.Mass[j];
 		}
 		else
 		{
-			di = P1->Density;
-			mi = P1->Mass;
+			di = PD.Density[i];
+			mi = PD.Mass[i];
 		}
 
-		if (!P2->IsFree)
+		if (!PD.IsFree[j])
 		{
-			dj = DensitySolid(P1->PresEq, P1->Cs, P1->P0,P2->Pressure, P1->RefDensity);
-			mj = P2->FPMassC * P1->Mass;
+			dj = DensitySolid(Mi.PresEq, Mi.Cs, Mi.P0,PD.Pressure[j], PD.RefDensity[i]);
+			mj = PD.FPMassC[j] * PD.Mass[i];
 		}
 		else
 		{
-			dj = P2->Density;
-			mj = P2->Mass;
+			dj = PD.Density[j];
+			mj = PD.Mass[j];
 		}
 
-		double GK	= GradKernel(Dimension, KernelType, rij/h, h);
-		double K	= Kernel(Dimension, KernelType, rij/h, h);
+		double GK	= G.GK;
+		double K	= G.W;
 
 		// Artificial Viscosity
 		double PIij = 0.0;
 		if (Alpha!=0.0 || Beta!=0.0)
 		{
 			double Ci,Cj;
-			if (!P1->IsFree) Ci = SoundSpeed(P2->PresEq, P2->Cs, di, P2->RefDensity); else Ci = SoundSpeed(P1->PresEq, P1->Cs, di, P1->RefDensity);
-			if (!P2->IsFree) Cj = SoundSpeed(P1->PresEq, P1->Cs, dj, P1->RefDensity); else Cj = SoundSpeed(P2->PresEq, P2->Cs, dj, P2->RefDensity);
+			if (!PD.IsFree[i]) Ci = SoundSpeed(Mj.PresEq, Mj.Cs, di, PD.RefDensity[j]); else Ci = SoundSpeed(Mi.PresEq, Mi.Cs, di, PD.RefDensity[i]);
+			if (!PD.IsFree[j]) Cj = SoundSpeed(Mi.PresEq, Mi.Cs, dj, PD.RefDensity[i]); else Cj = SoundSpeed(Mj.PresEq, Mj.Cs, dj, PD.RefDensity[j]);
 			double MUij = h*dot(vij,xij)/(rij*rij+0.01*h*h);						///<(2.75) Li, Liu Book
 			if (dot(vij,xij)<0) PIij = (-Alpha*0.5*(Ci+Cj)*MUij+Beta*MUij*MUij)/(0.5*(di+dj));		///<(2.74) Li, Liu Book
 		}
 
 		// Tensile Instability
 		double TIij = 0.0;
-		if (P1->TI > 0.0 || P2->TI > 0.0)
+		if (Mi.TI > 0.0 || Mj.TI > 0.0)
 		{
 			double Ri,Rj;
 			Ri = 0.0;
 			Rj = 0.0;
-			if ((P1->Pressure+P2->Pressure) < 0.0)
+			if ((PD.Pressure[i]+PD.Pressure[j]) < 0.0)
 			{
-				if (P1->Pressure < 0.0) Ri = -P1->Pressure/(di*di);
-				if (P2->Pressure < 0.0) Rj = -P2->Pressure/(dj*dj);
+				if (PD.Pressure[i] < 0.0) Ri = -PD.Pressure[i]/(di*di);
+				if (PD.Pressure[j] < 0.0) Rj = -PD.Pressure[j]/(dj*dj);
 			}
-			TIij = (P1->TI*Ri + P2->TI*Rj)*pow((K/Kernel(Dimension, KernelType, (P1->TIInitDist + P2->TIInitDist)/(2.0*h), h)),(P1->TIn+P2->TIn)/2.0);
+			TIij = (Mi.TI*Ri + Mj.TI*Rj)*pow((K/TIKernel(i, j, h, Ker)),(Mi.TIn+Mj.TIn)/2.0);
 		}
 
 		// Real Viscosity
-		Mat3_t StrainRate;
+		Sym3_t StrainRate;
 		set_to_zero(StrainRate);
 		Vec3_t VI = 0.0;
 			Vec3_t vab=0.0;
-		if ((P1->NoSlip || P2->NoSlip) || (P1->IsFree*P2->IsFree))
+		if ((PD.NoSlip[i] || PD.NoSlip[j]) || (PD.IsFree[i]*PD.IsFree[j]))
 		{
 			double Mu = 0.0;
-			if (P1->IsFree*P2->IsFree)
+			if (PD.IsFree[i]*PD.IsFree[j])
 			{
 				vab	= vij;
-				Mu	= 2.0*P1->Mu*P2->Mu/(P1->Mu+P2->Mu);
+				Mu	= 2.0*PD.Mu[i]*PD.Mu[j]/(PD.Mu[i]+PD.Mu[j]);
 			}
 			else
 			{
 				// No-Slip velocity correction
-				if (P1->IsFree)	vab = P1->v - (2.0*P2->v-P2->NSv); else vab = (2.0*P1->v-P1->NSv) - P2->v;
-				if (!P1->IsFree) Mu = P2->Mu;
-				if (!P2->IsFree) Mu = P1->Mu;
-			}
-			if (P1->T0>0.0 || P2->T0>0.0 || (P1->LES*P2->LES))
-			{
-				StrainRate =	2.0*vab(0)*xij(0)            , vab(0)*xij(1)+vab(1)*xij(0) , vab(0)*xij(2)+vab(2)*xij(0) ,
-											vab(0)*xij(1)+vab(1)*xij(0)  , 2.0*vab(1)*xij(1)           , vab(1)*xij(2)+vab(2)*xij(1) ,
-						 					vab(0)*xij(2)+vab(2)*xij(0)  , vab(1)*xij(2)+vab(2)*xij(1) , 2.0*vab(2)*xij(2)           ;
-				StrainRate = -GK * StrainRate;
+				if (PD.IsFree[i])	vab = PD.Velocity(i) - (2.0*PD.Velocity(j)-PD.NSVelocity(j)); else vab = (2.0*PD.Velocity(i)-PD.NSVelocity(i)) - PD.Velocity(j);
+				if (!PD.IsFree[i]) Mu = PD.Mu[j];
+				if (!PD.IsFree[j]) Mu = PD.Mu[i];
 			}
+			if (Mi.T0>0.0 || Mj.T0>0.0 || (Mi.LES*Mj.LES))
+				StrainRate = -GK * SymDyad(vab,xij);
 
-			Viscous_Force(VisEq, VI, Mu, di, dj, GK, vab, Dimension, KernelType, rij, h, xij, vij);
+			Viscous_Force(VisEq, VI, Mu, di, dj, GK, vab, Ker, rij, h, xij, vij);
 		}
 
 		// XSPH Monaghan
-		if (XSPH != 0.0 && (P1->IsFree*P2->IsFree))
+		if (XSPH != 0.0 && (PD.IsFree[i]*PD.IsFree[j]))
 		{
-			omp_set_lock(&P1->my_lock);
-			P1->VXSPH		+= XSPH*mj/(0.5*(di+dj))*K*-vij;
-			omp_unset_lock(&P1->my_lock);
+			if (Ui)
+			{
+				if (Lock) omp_set_lock(&PD.Lock[i]);
+				PD.VXSPH[i]		+= XSPH*mj/(0.5*(di+dj))*K*-vij;
+				if (Lock) omp_unset_lock(&PD.Lock[i]);
+			}
 
-			omp_set_lock(&P2->my_lock);
-			P2->VXSPH		+= XSPH*mi/(0.5*(di+dj))*K*vij;
-			omp_unset_lock(&P2->my_lock);
+			if (Uj)
+			{
+				if (Lock) omp_set_lock(&PD.Lock[j]);
+				PD.VXSPH[j]		+= XSPH*mi/(0.5*(di+dj))*K*vij;
+				if (Lock) omp_unset_lock(&PD.Lock[j]);
+			}
 		}
 
 		// Calculating the forces for the particle 1 & 2
@@ -137,66 +149,194 @@ inline void Domain::CalcForce11(Particle * P1, Particle * P2)
 		double temp1	= 0.0;
 
 		if (GradientType == 0)
-			temp		= -1.0*( P1->Pressure/(di*di) + P2->Pressure/(dj*dj) + PIij + TIij ) * GK*xij + VI;
+			temp		= -1.0*( PD.Pressure[i]/(di*di) + PD.Pressure[j]/(dj*dj) + PIij + TIij ) * GK*xij + VI;
 		else
-			temp		= -1.0*( (P1->Pressure + P2->Pressure)/(di*dj)       + PIij + TIij ) * GK*xij + VI;
+			temp		= -1.0*( (PD.Pressure[i] + PD.Pressure[j])/(di*dj)       + PIij + TIij ) * GK*xij + VI;
 
 		if (Dimension == 2) temp(2) = 0.0;
 		temp1		= dot( vij , GK*xij );
 
-		omp_set_lock(&P1->my_lock);
-			P1->a					+= mj * temp;
-			P1->dDensity	+= mj * (di/dj) * temp1;
+		if (Ui)
+		{
+			if (Lock) omp_set_lock(&PD.Lock[i]);
+				PD.a[i]					+= mj * temp;
+				PD.dDensity[i]	+= mj * (di/dj) * temp1;
 
-			if (P1->IsFree)
-			{
-				if (P1->T0>0.0 || P1->LES)	P1->StrainRate		= P1->StrainRate + mj/dj*StrainRate;
-				if (SWIType == 1)						P1->S							= P1->S + mj/dj*vab(0)*xij(1)*-GK;
-				P1->ZWab	+= mj/dj* K;
-			}
-			else
-				P1->ZWab	= 1.0;
+				if (PD.IsFree[i])
+				{
+					if (Mi.T0>0.0 || Mi.LES)	PD.StrainRate[i]	+= mj/dj*StrainRate;
+					if (SWIType == 1)						PD.S[i]						= PD.S[i] + mj/dj*vab(0)*xij(1)*-GK;
+					PD.ZWab[i]	+= mj/dj* K;
+				}
+				else
+					PD.ZWab[i]	= 1.0;
+
+				if (PD.ShepardOn[i])
+					PD.SumDen[i] += mj*K;
+			if (Lock) omp_unset_lock(&PD.Lock[i]);
+		}
 
-			if (P1->Shepard)
-				if (P1->ShepardCounter == P1->ShepardStep)
-					P1->SumDen += mj*K;
-		omp_unset_lock(&P1->my_lock);
 
+		if (Uj)
+		{
+			if (Lock) omp_set_lock(&PD.Lock[j]);
+				PD.a[j]					-= mi * temp;
+				PD.dDensity[j]	+= mi * (dj/di) * temp1;
 
-		omp_set_lock(&P2->my_lock);
-			P2->a					-= mi * temp;
-			P2->dDensity	+= mi * (dj/di) * temp1;
+				if (PD.IsFree[j])
+				{
+					if (Mj.T0>0.0 || Mj.LES)	PD.StrainRate[j]	+= mi/di*StrainRate;
+					if (SWIType ==1)						PD.S[j]		 				= PD.S[j] + mi/di*vab(0)*xij(1)*-GK;
+					PD.ZWab[j]	+= mi/di* K;
+				}
+				else
+					PD.ZWab[j]	= 1.0;
 
-			if (P2->IsFree)
+				if (PD.ShepardOn[j])
+					PD.SumDen[j] += mi*K;
+			if (Lock) omp_unset_lock(&PD.Lock[j]);
+		}
+    }
+}
+
+template <typename KP> inline void Domain::CalcForce11Batch(PairList const & L, size_t Begin, size_t End, KP const & Ker)
+{
+	// Free-free fluid pairs without tensile instability, non-Newtonian or LES terms are gathered in blocks,
+	// the pair terms are computed in a SIMD loop and scattered in the order of the list, so the sums are
+	// the same as CalcForce11. The other pairs of the block take the scalar path at their place.
+	const size_t B = 64;
+	size_t	Slot[B];		// Position of the pair in the block arrays, B => scalar path
+	double	xx[B], xy[B], xz[B], vx[B], vy[B], vz[B];
+	double	GK[B], rij[B], h[B], di[B], dj[B], Pi[B], Pj[B], Ci[B], Cj[B], Alpha[B], Beta[B], Mu[B];
+	double	tx[B], ty[B], tz[B], t1[B];
+
+	bool	Batch	= (VisEq < 2) && (SWIType != 1);
+	bool	Dim2	= (Dimension == 2);
+	// The options are applied as 0/1 weights, a select (or branch) in the SIMD loop stops the vectorization
+	double	wMorris	= (VisEq == 0)       ? 1.0 : 0.0;
+	double	wGrad0	= (GradientType == 0) ? 1.0 : 0.0;
+
+	for (size_t b=Begin; b<End; b+=B)
+	{
+		size_t e = std::min(b+B, End);
+
+		// Gather
+		size_t m = 0;
+		for (size_t n=b; n<e; n++)
+		{
+			size_t i = L[n].first;
+			size_t j = L[n].second;
+			Slot[n-b] = B;
+			if (!Batch || PD.Material[i] != 1 || !(PD.IsFree[i] && PD.IsFree[j])) continue;
+			MaterialProps const & Mi = PD.Props(i);
+			MaterialProps const & Mj = PD.Props(j);
+			if (Mi.TI > 0.0 || Mj.TI > 0.0 || Mi.T0 > 0.0 || Mj.T0 > 0.0 || Mi.LES || Mj.LES) continue;
+
+			PairGeom const & G = L.Geom(n);
+			double hij = (PD.h[i]+PD.h[j])/2;
+			if ((G.rij/hij)>Cellfac) continue;
+
+			Slot[n-b]	= m;
+			xx[m]		= G.xij[0];
+			xy[m]		= G.xij[1];
+			xz[m]		= G.xij[2];
+			vx[m]		= double(PD.v[3*i  ]) - PD.v[3*j  ];
+			vy[m]		= double(PD.v[3*i+1]) - PD.v[3*j+1];
+			vz[m]		= double(PD.v[3*i+2]) - PD.v[3*j+2];
+			GK[m]		= G.GK;
+			rij[m]		= G.rij;
+			h[m]		= hij;
+			di[m]		= PD.Density[i];
+			dj[m]		= PD.Density[j];
+			Pi[m]		= PD.Pressure[i];
+			Pj[m]		= PD.Pressure[j];
+			Ci[m]		= SoundSpeed(Mi.PresEq, Mi.Cs, di[m], PD.RefDensity[i]);
+			Cj[m]		= SoundSpeed(Mj.PresEq, Mj.Cs, dj[m], PD.RefDensity[j]);
+			Alpha[m]	= (Mi.Alpha + Mj.Alpha)/2.0;
+			Beta[m]		= (Mi.Beta + Mj.Beta)/2.0;
+			Mu[m]		= 2.0*PD.Mu[i]*PD.Mu[j]/(PD.Mu[i]+PD.Mu[j]);
+			m++;
+		}
+
+		// Pressure, artificial viscosity, real viscosity (Morris or Shao) and continuity terms.
+		// Both forms of each term are computed and weighted, so the loop has no branches.
+		#pragma omp simd
+		for (size_t s=0; s<m; s++)
+		{
+			double vx_x	= vx[s]*xx[s] + vy[s]*xy[s] + vz[s]*xz[s];
+			double MUij	= h[s]*vx_x/(rij[s]*rij[s]+0.01*h[s]*h[s]);
+			double PIij	= (-Alpha[s]*0.5*(Ci[s]+Cj[s])*MUij+Beta[s]*MUij*MUij)/(0.5*(di[s]+dj[s]));
+			double wApp	= 0.5 - 0.5*copysign(1.0, vx_x);				// 1 for approaching particles
+			double VIm	= 2.0*Mu[s]/(di[s]*dj[s]);
+			double VIs	= 8.0*Mu[s]/((di[s]+dj[s])*(di[s]+dj[s]));
+			double Pg0	= Pi[s]/(di[s]*di[s]) + Pj[s]/(dj[s]*dj[s]);
+			double Pg1	= (Pi[s] + Pj[s])/(di[s]*dj[s]);
+			double VI	= (wMorris*VIm + (1.0-wMorris)*VIs)*GK[s];
+			double c	= -1.0*((wGrad0*Pg0 + (1.0-wGrad0)*Pg1) + wApp*PIij)*GK[s];
+			tx[s]	= c*xx[s] + VI*vx[s];
+			ty[s]	= c*xy[s] + VI*vy[s];
+			tz[s]	= c*xz[s] + VI*vz[s];
+			t1[s]	= vx[s]*(GK[s]*xx[s]) + vy[s]*(GK[s]*xy[s]) + vz[s]*(GK[s]*xz[s]);
+		}
+
+		// Scatter
+		for (size_t n=b; n<e; n++)
+		{
+			size_t i = L[n].first;
+			size_t j = L[n].second;
+			size_t s = Slot[n-b];
+			if (s == B)
 			{
-				if (P2->T0>0.0 || P2->LES)	P2->StrainRate		= P2->StrainRate + mi/di*StrainRate;
-				if (SWIType ==1)						P2->S		 					= P2->S + mi/di*vab(0)*xij(1)*-GK;
-				P2->ZWab	+= mi/di* K;
+				if (PD.Material[i] == 1)
+					CalcForce11(i, j, Ker, L.Geom(n));
+				else
+					CalcForce2233(i, j, Ker, L.Geom(n));
+				continue;
 			}
-			else
-				P2->ZWab	= 1.0;
 
-			if (P2->Shepard)
-				if (P2->ShepardCounter == P2->ShepardStep)
-					P2->SumDen += mi*K;
-		omp_unset_lock(&P2->my_lock);
-    }
+			double K	= L.Geom(n).W;
+			double mi	= PD.Mass[i];
+			double mj	= PD.Mass[j];
+			Vec3_t temp	(tx[s], ty[s], Dim2 ? 0.0 : tz[s]);
+			Vec3_t vij	(vx[s], vy[s], vz[s]);
+
+			omp_set_lock(&PD.Lock[i]);
+				if (XSPH != 0.0) PD.VXSPH[i]	+= XSPH*mj/(0.5*(di[s]+dj[s]))*K*-vij;
+				PD.a[i]		+= mj * temp;
+				PD.dDensity[i]	+= mj * (di[s]/dj[s]) * t1[s];
+				PD.ZWab[i]	+= mj/dj[s]* K;
+				if (PD.ShepardOn[i]) PD.SumDen[i] += mj*K;
+			omp_unset_lock(&PD.Lock[i]);
+
+			omp_set_lock(&PD.Lock[j]);
+				if (XSPH != 0.0) PD.VXSPH[j]	+= XSPH*mi/(0.5*(di[s]+dj[s]))*K*vij;
+				PD.a[j]		-= mi * temp;
+				PD.dDensity[j]	+= mi * (dj[s]/di[s]) * t1[s];
+				PD.ZWab[j]	+= mi/di[s]* K;
+				if (PD.ShepardOn[j]) PD.SumDen[j] += mi*K;
+			omp_unset_lock(&PD.Lock[j]);
+		}
+	}
 }
 
-inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
+template <typename KP> inline void Domain::CalcForce2233(size_t i, size_t j, KP const & Ker, PairGeom const & G, bool U1, bool U2)
 {
-	double h	= (P1->h+P2->h)/2;
-	Vec3_t xij	= P1->x - P2->x;
+	bool Lock	= U1 && U2;
 
-	Periodic_X_Correction(xij, h, P1, P2);
+	Particle * P1	= Particles[i];
+	Particle * P2	= Particles[j];
+	MaterialProps const & M1	= Materials[P1->MatID];
+	MaterialProps const & M2	= Materials[P2->MatID];
 
-	double rij	= norm(xij);
+	double h	= (P1->h+P2->h)/2;
+	Vec3_t xij	= G.Xij();
+	double rij	= G.rij;
 
 	if ((rij/h)<=Cellfac)
 	{
 		double di=0.0,dj=0.0,mi=0.0,mj=0.0;
-		double Alpha	= (P1->Alpha + P2->Alpha)/2.0;
-		double Beta	= (P1->Beta + P2->Beta)/2.0;
+		double Alpha	= (M1.Alpha + M2.Alpha)/2.0;
+		double Beta	= (M1.Beta + M2.Beta)/2.0;
 
 		if (P1->Material*P2->Material == 9)
 		{
@@ -207,7 +347,7 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
 		{
 			if (!P1->IsFree)
 			{
-				di = DensitySolid(P2->PresEq, P2->Cs, P2->P0,P1->Pressure, P2->RefDensity);
+				di = DensitySolid(M2.PresEq, M2.Cs, M2.P0,P1->Pressure, P2->RefDensity);
 				mi = P1->FPMassC * P2->Mass;
 			}
 			else
@@ -217,7 +357,7 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
 			}
 			if (!P2->IsFree)
 			{
-				dj = DensitySolid(P1->PresEq, P1->Cs, P1->P0,P2->Pressure, P1->RefDensity);
+				dj = DensitySolid(M1.PresEq, M1.Cs, M1.P0,P2->Pressure, P1->RefDensity);
 				mj = P2->FPMassC * P1->Mass;
 			}
 			else
@@ -228,41 +368,38 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
 		}
 
 		Vec3_t vij	= P1->v - P2->v;
-		double GK	= GradKernel(Dimension, KernelType, rij/h, h);
-		double K	= Kernel(Dimension, KernelType, rij/h, h);
+		double GK	= G.GK;
+		double K	= G.W;
 
 		// Artificial Viscosity
-		Mat3_t PIij;
+		Sym3_t PIij;
 		set_to_zero(PIij);
 		if (Alpha!=0.0 || Beta!=0.0)
 		{
 			double MUij = h*dot(vij,xij)/(rij*rij+0.01*h*h);					///<(2.75) Li, Liu Book
 			double Cij;
 			if (P1->Material*P2->Material == 9)
-				Cij = 0.5*(P1->Cs+P2->Cs);
+				Cij = 0.5*(M1.Cs+M2.Cs);
 			else
 			{
 				double Ci,Cj;
-				if (!P1->IsFree) Ci = SoundSpeed(P2->PresEq, P2->Cs, di, P2->RefDensity); else Ci = SoundSpeed(P1->PresEq, P1->Cs, di, P1->RefDensity);
-				if (!P2->IsFree) Cj = SoundSpeed(P1->PresEq, P1->Cs, dj, P1->RefDensity); else Cj = SoundSpeed(P2->PresEq, P2->Cs, dj, P2->RefDensity);
+				if (!P1->IsFree) Ci = SoundSpeed(M2.PresEq, M2.Cs, di, P2->RefDensity); else Ci = SoundSpeed(M1.PresEq, M1.Cs, di, P1->RefDensity);
+				if (!P2->IsFree) Cj = SoundSpeed(M1.PresEq, M1.Cs, dj, P1->RefDensity); else Cj = SoundSpeed(M2.PresEq, M2.Cs, dj, P2->RefDensity);
 				Cij = 0.5*(Ci+Cj);
 			}
-			if (dot(vij,xij)<0) PIij = (Alpha*Cij*MUij+Beta*MUij*MUij)/(0.5*(di+dj)) * I;		///<(2.74) Li, Liu Book
+			if (dot(vij,xij)<0) PIij = (Alpha*Cij*MUij+Beta*MUij*MUij)/(0.5*(di+dj)) * Sym3_t(I);		///<(2.74) Li, Liu Book
 		}
 
-		Mat3_t Sigmaj,Sigmai;
-		set_to_zero(Sigmaj);
-		set_to_zero(Sigmai);
-		Sigmai = P1->Sigma;
-		Sigmaj = P2->Sigma;
+		Sym3_t const & Sigmai = P1->Solid->Sigma;
+		Sym3_t const & Sigmaj = P2->Solid->Sigma;
 
 //		if (P1->IsFree) Sigmai = P1->Sigma; else  Sigmai = P2->Sigma;
 //		if (P2->IsFree) Sigmaj = P2->Sigma; else  Sigmaj = P1->Sigma;
 
 		// Tensile Instability
-		Mat3_t TIij;
+		Sym3_t TIij;
 		set_to_zero(TIij);
-		if (P1->TI > 0.0 || P2->TI > 0.0) TIij = pow((K/Kernel(Dimension, KernelType, (P1->TIInitDist + P2->TIInitDist)/(2.0*h), h)),(P1->TIn+P2->TIn)/2.0)*(P1->TIR+P2->TIR);
+		if (M1.TI > 0.0 || M2.TI > 0.0) TIij = pow((K/TIKernel(i, j, h, Ker)),(M1.TIn+M2.TIn)/2.0)*(P1->Solid->TIR+P2->Solid->TIR);
 
 		// NoSlip BC velocity correction
 		Vec3_t vab = 0.0;
@@ -285,21 +422,12 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
 			}
 		}
 
-		Mat3_t StrainRate,RotationRate;
-		set_to_zero(StrainRate);
+		Sym3_t StrainRate;
+		Mat3_t RotationRate;
 		set_to_zero(RotationRate);
 
 		// Calculation strain rate tensor
-		StrainRate(0,0) = 2.0*vab(0)*xij(0);
-		StrainRate(0,1) = vab(0)*xij(1)+vab(1)*xij(0);
-		StrainRate(0,2) = vab(0)*xij(2)+vab(2)*xij(0);
-		StrainRate(1,0) = StrainRate(0,1);
-		StrainRate(1,1) = 2.0*vab(1)*xij(1);
-		StrainRate(1,2) = vab(1)*xij(2)+vab(2)*xij(1);
-		StrainRate(2,0) = StrainRate(0,2);
-		StrainRate(2,1) = StrainRate(1,2);
-		StrainRate(2,2) = 2.0*vab(2)*xij(2);
-		StrainRate	= -0.5 * GK * StrainRate;
+		StrainRate	= -0.5 * GK * SymDyad(vab,xij);
 
 		// Calculation rotation rate tensor
 		RotationRate(0,1) = vab(0)*xij(1)-vab(1)*xij(0);
@@ -313,13 +441,19 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
 		// XSPH Monaghan
 		if (XSPH != 0.0  && (P1->IsFree*P2->IsFree))
 		{
-			omp_set_lock(&P1->my_lock);
-			P1->VXSPH += XSPH*mj/(0.5*(di+dj))*K*-vij;
-			omp_unset_lock(&P1->my_lock);
+			if (U1)
+			{
+				if (Lock) omp_set_lock(&P1->my_lock);
+				P1->VXSPH += XSPH*mj/(0.5*(di+dj))*K*-vij;
+				if (Lock) omp_unset_lock(&P1->my_lock);
+			}
 
-			omp_set_lock(&P2->my_lock);
-			P2->VXSPH += XSPH*mi/(0.5*(di+dj))*K*vij;
-			omp_unset_lock(&P2->my_lock);
+			if (U2)
+			{
+				if (Lock) omp_set_lock(&P2->my_lock);
+				P2->VXSPH += XSPH*mi/(0.5*(di+dj))*K*vij;
+				if (Lock) omp_unset_lock(&P2->my_lock);
+			}
 		}
 
 		// Calculating the forces for the particle 1 & 2
@@ -335,49 +469,59 @@ inline void Domain::CalcForce2233(Particle * P1, Particle * P2)
 		temp1 = dot( vij , GK*xij );
 
 		// Locking the particle 1 for updating the properties
-		omp_set_lock(&P1->my_lock);
-			P1->a		+= mj * temp;
-			P1->dDensity	+= mj * (di/dj) * temp1;
+		if (U1)
+		{
+			if (Lock) omp_set_lock(&P1->my_lock);
+				P1->a		+= mj * temp;
+				P1->dDensity	+= mj * (di/dj) * temp1;
 
-			if (P1->IsFree)
-			{
-				P1->ZWab	+= mj/dj* K;
-				P1->StrainRate	 = P1->StrainRate + mj/dj*StrainRate;
-				P1->RotationRate = P1->RotationRate + mj/dj*RotationRate;
-				if (SWIType ==1) P1->S = P1->S + mj/dj*vab(0)*xij(1)*-GK;
-			}
-			else
-				P1->ZWab	= 1.0;
+				if (P1->IsFree)
+				{
+					P1->ZWab	+= mj/dj* K;
+					P1->StrainRate	+= mj/dj*StrainRate;
+					P1->Solid->RotationRate = P1->Solid->RotationRate + mj/dj*RotationRate;
+					if (SWIType ==1) P1->S = P1->S + mj/dj*vab(0)*xij(1)*-GK;
+				}
+				else
+					P1->ZWab	= 1.0;
 
-			if (P1->Shepard)
-				if (P1->ShepardCounter == P1->ShepardStep)
-					P1->SumDen += mj*    K;
-		omp_unset_lock(&P1->my_lock);
+				if (P1->Shepard)
+					if (P1->ShepardCounter == P1->ShepardStep)
+						P1->SumDen += mj*    K;
+			if (Lock) omp_unset_lock(&P1->my_lock);
+		}
 
 		// Locking the particle 2 for updating the properties
-		omp_set_lock(&P2->my_lock);
-			P2->a		-= mi * temp;
-			P2->dDensity	+= mi * (dj/di) * temp1;
-			if (P2->IsFree)
-			{
-				P2->ZWab	+= mi/di* K;
-				P2->StrainRate	 = P2->StrainRate + mi/di*StrainRate;
-				P2->RotationRate = P2->RotationRate + mi/di*RotationRate;
-				if (SWIType ==1) P2->S = P2->S + mi/di*vab(0)*xij(1)*-GK;
-			}
-			else
-				P2->ZWab	= 1.0;
+		if (U2)
+		{
+			if (Lock) omp_set_lock(&P2->my_lock);
+				P2->a		-= mi * temp;
+				P2->dDensity	+= mi * (dj/di) * temp1;
+				if (P2->IsFree)
+				{
+					P2->ZWab	+= mi/di* K;
+					P2->StrainRate	+= mi/di*StrainRate;
+					P2->Solid->RotationRate = P2->Solid->RotationRate + mi/di*RotationRate;
+					if (SWIType ==1) P2->S = P2->S + mi/di*vab(0)*xij(1)*-GK;
+				}
+				else
+					P2->ZWab	= 1.0;
 
-			if (P2->Shepard)
-				if (P2->ShepardCounter == P2->ShepardStep)
-					P2->SumDen += mi*    K;
+				if (P2->Shepard)
+					if (P2->ShepardCounter == P2->ShepardStep)
+						P2->SumDen += mi*    K;
 
-		omp_unset_lock(&P2->my_lock);
+			if (Lock) omp_unset_lock(&P2->my_lock);
+		}
 	}
 }
 
-inline void Domain::CalcForce12(Particle * P1, Particle * P2)
+template <typename KP> inline void Domain::CalcForce12(Particle * P1, Particle * P2, KP const & Ker, bool U1, bool U2)
 {
+	bool Lock	= U1 && U2;
+	MaterialProps const & M1	= Materials[P1->MatID];
+	MaterialProps const & M2	= Materials[P2->MatID];
+
 	double h	= (P1->h+P2->h)/2;
 //	double h	= std::max(P1->h,P2->h);
 	Vec3_t xij	= P1->x - P2->x;
@@ -390,18 +534,18 @@ inline void Domain::CalcForce12(Particle * P1, Particle * P2)
 	{
 		double di=0.0,dj=0.0,mi=0.0,mj=0.0;
 		Vec3_t vij	= P1->v - P2->v;
-		double GK	= GradKernel(Dimension, KernelType, rij/h, h);
+		double GK	= Ker.GradKernel(rij/h, h);
 
 		if (P1->Material == 1)
 		{
 			di = P1->Density;
 			mi = P1->Mass;
-			dj = DensitySolid(P1->PresEq, P1->Cs, P1->P0,P2->FSIPressure, P1->RefDensity);
+			dj = DensitySolid(M1.PresEq, M1.Cs, M1.P0,P2->FSIPressure, P1->RefDensity);
 			mj = P1->Mass;
 		}
 		else
 		{
-			di = DensitySolid(P2->PresEq, P2->Cs, P2->P0,P1->FSIPressure, P2->RefDensity);
+			di = DensitySolid(M2.PresEq, M2.Cs, M2.P0,P1->FSIPressure, P2->RefDensity);
 			mi = P2->Mass;
 			dj = P2->Density;
 			mj = P2->Mass;
@@ -416,24 +560,24 @@ inline void Domain::CalcForce12(Particle * P1, Particle * P2)
 			double Ci,Cj;
 			if (P1->Material == 1)
 			{
-				Alpha	= P1->Alpha;
-				Beta	= P1->Beta;
-				Ci	= SoundSpeed(P1->PresEq, P1->Cs, di, P1->RefDensity);
-				Cj	= SoundSpeed(P1->PresEq, P1->Cs, dj, P1->RefDensity);
+				Alpha	= M1.Alpha;
+				Beta	= M1.Beta;
+				Ci	= SoundSpeed(M1.PresEq, M1.Cs, di, P1->RefDensity);
+				Cj	= SoundSpeed(M1.PresEq, M1.Cs, dj, P1->RefDensity);
 			}
 			else
 			{
-				Alpha	= P2->Alpha;
-				Beta	= P2->Beta;
-				Ci 	= SoundSpeed(P2->PresEq, P2->Cs, di, P2->RefDensity);
-				Cj 	= SoundSpeed(P2->PresEq, P2->Cs, dj, P2->RefDensity);
+				Alpha	= M2.Alpha;
+				Beta	= M2.Beta;
+				Ci 	= SoundSpeed(M2.PresEq, M2.Cs, di, P2->RefDensity);
+				Cj 	= SoundSpeed(M2.PresEq, M2.Cs, dj, P2->RefDensity);
 			}
 			double MUij = h*dot(vij,xij)/(rij*rij+0.01*h*h);						///<(2.75) Li, Liu Book
 			if (dot(vij,xij)<0) PIij = (-Alpha*0.5*(Ci+Cj)*MUij+Beta*MUij*MUij)/(0.5*(di+dj));		///<(2.74) Li, Liu Book
 		}
 
 		// Real Viscosity
-		Mat3_t StrainRate;
+		Sym3_t StrainRate;
 		set_to_zero(StrainRate);
 		Vec3_t VI = 0.0;
 		Vec3_t vab=0.0;
@@ -448,15 +592,10 @@ inline void Domain::CalcForce12(Particle * P1, Particle * P2)
 			vab = (2.0*P1->v-P1->FSINSv) - P2->v;
 			Mu = P2->Mu;
 		}
-		if ((P1->T0>0.0 || P2->T0>0.0) || (P1->LES || P2->LES))
-		{
-			StrainRate =	2.0*vab(0)*xij(0)            , vab(0)*xij(1)+vab(1)*xij(0) , vab(0)*xij(2)+vab(2)*xij(0) ,
-					vab(0)*xij(1)+vab(1)*xij(0)  , 2.0*vab(1)*xij(1)           , vab(1)*xij(2)+vab(2)*xij(1) ,
-					 vab(0)*xij(2)+vab(2)*xij(0) , vab(1)*xij(2)+vab(2)*xij(1) , 2.0*vab(2)*xij(2)           ;
-			StrainRate = -GK * StrainRate;
-		}
+		if ((M1.T0>0.0 || M2.T0>0.0) || (M1.LES || M2.LES))
+			StrainRate = -GK * SymDyad(vab,xij);
 
-		Viscous_Force(VisEq, VI, Mu, di, dj, GK, vab, Dimension, KernelType, rij, h, xij, vij);
+		Viscous_Force(VisEq, VI, Mu, di, dj, GK, vab, Ker, rij, h, xij, vij);
 
 
 		// Calculating the forces for the particle 1 & 2
@@ -472,15 +611,21 @@ inline void Domain::CalcForce12(Particle * P1, Particle * P2)
 			if (Dimension == 2) temp(2) = 0.0;
 			temp1		= dot( vij , GK*xij );
 
-			omp_set_lock(&P1->my_lock);
-				P1->a		+= mj * temp;
-				P1->dDensity	+= mj * (di/dj) * temp1;
-				if (P1->T0>0.0 || P1->LES)	P1->StrainRate	 = P1->StrainRate + mj/dj*StrainRate;
-			omp_unset_lock(&P1->my_lock);
+			if (U1)
+			{
+				if (Lock) omp_set_lock(&P1->my_lock);
+					P1->a		+= mj * temp;
+					P1->dDensity	+= mj * (di/dj) * temp1;
+					if (M1.T0>0.0 || M1.LES)	P1->StrainRate	+= mj/dj*StrainRate;
+				if (Lock) omp_unset_lock(&P1->my_lock);
+			}
 
-			omp_set_lock(&P2->my_lock);
-				P2->a		-= mi * temp;
-			omp_unset_lock(&P2->my_lock);
+			if (U2)
+			{
+				if (Lock) omp_set_lock(&P2->my_lock);
+					P2->a		-= mi * temp;
+				if (Lock) omp_unset_lock(&P2->my_lock);
+			}
 		}
 		else
 		{
@@ -491,23 +636,33 @@ inline void Domain::CalcForce12(Particle * P1, Particle * P2)
 			if (Dimension == 2) temp(2) = 0.0;
 			temp1		= dot( vij , GK*xij );
 
-			omp_set_lock(&P1->my_lock);
-				P1->a		+= mj * temp;
-			omp_unset_lock(&P1->my_lock);
+			if (U1)
+			{
+				if (Lock) omp_set_lock(&P1->my_lock);
+					P1->a		+= mj * temp;
+				if (Lock) omp_unset_lock(&P1->my_lock);
+			}
 
 
-			omp_set_lock(&P2->my_lock);
-				P2->a		-= mi * temp;
-				P2->dDensity	+= mi * (dj/di) * temp1;
-				if (P2->T0>0.0 || P2->LES)	P2->StrainRate	 = P2->StrainRate + mi/di*StrainRate;
-			omp_unset_lock(&P2->my_lock);
+			if (U2)
+			{
+				if (Lock) omp_set_lock(&P2->my_lock);
+					P2->a		-= mi * temp;
+					P2->dDensity	+= mi * (dj/di) * temp1;
+					if (M2.T0>0.0 || M2.LES)	P2->StrainRate	+= mi/di*StrainRate;
+				if (Lock) omp_unset_lock(&P2->my_lock);
+			}
 		}
 
     }
 }
 
-inline void Domain::CalcForce13(Particle * P1, Particle * P2)
+template <typename KP> inline void Domain::CalcForce13(Particle * P1, Particle * P2, KP const & Ker, bool U1, bool U2)
 {
+	bool Lock	= U1 && U2;
+	MaterialProps const & M1	= Materials[P1->MatID];
+	MaterialProps const & M2	= Materials[P2->MatID];
+
 	double h	= std::min(P1->h,P2->h);
 	Vec3_t xij	= P1->x - P2->x;
 
@@ -517,7 +672,7 @@ inline void Domain::CalcForce13(Particle * P1, Particle * P2)
 
 	if ((rij/h)<=Cellfac)
 	{
-		double K	= Kernel(Dimension, KernelType, rij/h, h)/(P1->Density*P2->Density);
+		double K	= Ker.Kernel(rij/h, h)/(P1->Density*P2->Density);
 		double SF1=0.0,SF2=0.0;
 		Vec3_t SFt=0.0,v=0.0;
 		switch(SWIType)
@@ -526,32 +681,44 @@ inline void Domain::CalcForce13(Particle * P1, Particle * P2)
 				if (P1->Material == 3 )
 				{
 					v = P2->v-P1->v;
-					Seepage(P1->SeepageType, P1->k, P1->k2, P2->MuRef, P2->RefDensity, SF1, SF2);
+					Seepage(M1.SeepageType, P1->k, P1->k2, M2.MuRef, P2->RefDensity, SF1, SF2);
 					SFt = (SF1*v + SF2*norm(v)*v) *K;
 					if (Dimension == 2) SFt(2) = 0.0;
 
-					omp_set_lock(&P1->my_lock);
-						P1->a += P2->Mass*SFt;
-					omp_unset_lock(&P1->my_lock);
+					if (U1)
+					{
+						if (Lock) omp_set_lock(&P1->my_lock);
+							P1->a += P2->Mass*SFt;
+						if (Lock) omp_unset_lock(&P1->my_lock);
+					}
 
-					omp_set_lock(&P2->my_lock);
-						P2->a -= P1->Mass*SFt;
-					omp_unset_lock(&P2->my_lock);
+					if (U2)
+					{
+						if (Lock) omp_set_lock(&P2->my_lock);
+							P2->a -= P1->Mass*SFt;
+						if (Lock) omp_unset_lock(&P2->my_lock);
+					}
 				}
 				else
 				{
 					v = P1->v-P2->v;
-					Seepage(P2->SeepageType, P2->k, P2->k2, P1->MuRef, P1->RefDensity, SF1, SF2);
+					Seepage(M2.SeepageType, P2->k, P2->k2, M1.MuRef, P1->RefDensity, SF1, SF2);
 					SFt = (SF1*v + SF2*norm(v)*v) *K;
 					if (Dimension == 2) SFt(2) = 0.0;
 
-					omp_set_lock(&P1->my_lock);
-						P1->a -= P2->Mass*SFt;
-					omp_unset_lock(&P1->my_lock);
+					if (U1)
+					{
+						if (Lock) omp_set_lock(&P1->my_lock);
+							P1->a -= P2->Mass*SFt;
+						if (Lock) omp_unset_lock(&P1->my_lock);
+					}
 
-					omp_set_lock(&P2->my_lock);
-						P2->a += P1->Mass*SFt;
-					omp_unset_lock(&P2->my_lock);
+					if (U2)
+					{
+						if (Lock) omp_set_lock(&P2->my_lock);
+							P2->a += P1->Mass*SFt;
+						if (Lock) omp_unset_lock(&P2->my_lock);
+					}
 				}
 				break;
 			case 1:
@@ -560,82 +727,106 @@ inline void Domain::CalcForce13(Particle * P1, Particle * P2)
 					v = P2->v-P1->v;
 					if (P1->ZWab<0.25)
 					{
-						double Cd = 24.0*(P2->MuRef/P2->RefDensity)/(P1->d*norm(v)+0.01*h*h) + 2.0;
-						SFt = (3.0/(4.0*P1->d)*P2->RefDensity*(1.0-P1->n0)*Cd*norm(v)*v) *K;
-						SFt(1) += (P2->RefDensity*(1.0-P1->n0)*norm(v)*fabs(P2->S-P1->S)) *K;
+						double Cd = 24.0*(M2.MuRef/P2->RefDensity)/(M1.d*norm(v)+0.01*h*h) + 2.0;
+						SFt = (3.0/(4.0*M1.d)*P2->RefDensity*(1.0-M1.n0)*Cd*norm(v)*v) *K;
+						SFt(1) += (P2->RefDensity*(1.0-M1.n0)*norm(v)*fabs(P2->S-P1->S)) *K;
 					}
 					else
 					{
-						Seepage(P1->SeepageType, P1->k, P1->k2, P2->MuRef, P2->RefDensity, SF1, SF2);
+						Seepage(M1.SeepageType, P1->k, P1->k2, M2.MuRef, P2->RefDensity, SF1, SF2);
 						SFt = (SF1*v + SF2*norm(v)*v) *K;
 					}
 					if (Dimension == 2) SFt(2) = 0.0;
 
-					omp_set_lock(&P1->my_lock);
-						P1->a += P2->Mass*SFt;
-					omp_unset_lock(&P1->my_lock);
+					if (U1)
+					{
+						if (Lock) omp_set_lock(&P1->my_lock);
+							P1->a += P2->Mass*SFt;
+						if (Lock) omp_unset_lock(&P1->my_lock);
+					}
 
-					omp_set_lock(&P2->my_lock);
-						P2->a -= P1->Mass*SFt;
-					omp_unset_lock(&P2->my_lock);
+					if (U2)
+					{
+						if (Lock) omp_set_lock(&P2->my_lock);
+							P2->a -= P1->Mass*SFt;
+						if (Lock) omp_unset_lock(&P2->my_lock);
+					}
 				}
 				else
 				{
 					v = P1->v-P2->v;
 					if (P2->ZWab<0.25)
 					{
-						double Cd = 24.0*(P1->MuRef/P1->RefDensity)/(P2->d*norm(v)+0.01*h*h) + 2.0;
-						SFt = (3.0/(4.0*P2->d)*P1->RefDensity*(1.0-P2->n0)*Cd*norm(v)*v) *K;
-						SFt(1) += (P1->RefDensity*(1.0-P2->n0)*norm(v)*fabs(P1->S-P2->S)) *K;;
+						double Cd = 24.0*(M1.MuRef/P1->RefDensity)/(M2.d*norm(v)+0.01*h*h) + 2.0;
+						SFt = (3.0/(4.0*M2.d)*P1->RefDensity*(1.0-M2.n0)*Cd*norm(v)*v) *K;
+						SFt(1) += (P1->RefDensity*(1.0-M2.n0)*norm(v)*fabs(P1->S-P2->S)) *K;;
 					}
 					else
 					{
-						Seepage(P2->SeepageType, P2->k, P2->k2, P1->MuRef, P1->RefDensity, SF1, SF2);
+						Seepage(M2.SeepageType, P2->k, P2->k2, M1.MuRef, P1->RefDensity, SF1, SF2);
 						SFt = (SF1*v + SF2*norm(v)*v) *K;
 					}
 					if (Dimension == 2) SFt(2) = 0.0;
 
-					omp_set_lock(&P1->my_lock);
-						P1->a -= P2->Mass*SFt;
-					omp_unset_lock(&P1->my_lock);
+					if (U1)
+					{
+						if (Lock) omp_set_lock(&P1->my_lock);
+							P1->a -= P2->Mass*SFt;
+						if (Lock) omp_unset_lock(&P1->my_lock);
+					}
 
-					omp_set_lock(&P2->my_lock);
-						P2->a += P1->Mass*SFt;
-					omp_unset_lock(&P2->my_lock);
+					if (U2)
+					{
+						if (Lock) omp_set_lock(&P2->my_lock);
+							P2->a += P1->Mass*SFt;
+						if (Lock) omp_unset_lock(&P2->my_lock);
+					}
 				}
 				break;
 			case 2:
 				if (P1->Material == 3 )
 				{
-					double GK	= GradKernel(Dimension, KernelType, rij/h, h)/(P1->Density*P2->Density);
+					double GK	= Ker.GradKernel(rij/h, h)/(P1->Density*P2->Density);
 					v = P2->v-P1->v;
-					Seepage(P1->SeepageType, P1->k, P1->k2, P2->MuRef, P2->RefDensity, SF1, SF2);
+					Seepage(M1.SeepageType, P1->k, P1->k2, M2.MuRef, P2->RefDensity, SF1, SF2);
 					SFt = (SF1*v + SF2*norm(v)*v) *K;
 					if (Dimension == 2) SFt(2) = 0.0;
 
-					omp_set_lock(&P1->my_lock);
-						P1->a += P2->Mass*SFt - P2->Mass*P2->Pressure*GK*xij;
-					omp_unset_lock(&P1->my_lock);
+					if (U1)
+					{
+						if (Lock) omp_set_lock(&P1->my_lock);
+							P1->a += P2->Mass*SFt - P2->Mass*P2->Pressure*GK*xij;
+						if (Lock) omp_unset_lock(&P1->my_lock);
+					}
 
-					omp_set_lock(&P2->my_lock);
-						P2->a -= P1->Mass*SFt;
-					omp_unset_lock(&P2->my_lock);
+					if (U2)
+					{
+						if (Lock) omp_set_lock(&P2->my_lock);
+							P2->a -= P1->Mass*SFt;
+						if (Lock) omp_unset_lock(&P2->my_lock);
+					}
 				}
 				else
 				{
-					double GK	= GradKernel(Dimension, KernelType, rij/h, h)/(P1->Density*P2->Density);
+					double GK	= Ker.GradKernel(rij/h, h)/(P1->Density*P2->Density);
 					v = P1->v-P2->v;
-					Seepage(P2->SeepageType, P2->k, P2->k2, P1->MuRef, P1->RefDensity, SF1, SF2);
+					Seepage(M2.SeepageType, P2->k, P2->k2, M1.MuRef, P1->RefDensity, SF1, SF2);
 					SFt = (SF1*v + SF2*norm(v)*v) *K;
 					if (Dimension == 2) SFt(2) = 0.0;
 
-					omp_set_lock(&P1->my_lock);
-						P1->a -= P2->Mass*SFt;
-					omp_unset_lock(&P1->my_lock);
+					if (U1)
+					{
+						if (Lock) omp_set_lock(&P1->my_lock);
+							P1->a -= P2->Mass*SFt;
+						if (Lock) omp_unset_lock(&P1->my_lock);
+					}
 
-					omp_set_lock(&P2->my_lock);
-						P2->a += P1->Mass*SFt + P1->Mass*P1->Pressure*GK*xij;
-					omp_unset_lock(&P2->my_lock);
+					if (U2)
+					{
+						if (Lock) omp_set_lock(&P2->my_lock);
+							P2->a += P1->Mass*SFt + P1->Mass*P1->Pressure*GK*xij;
+						if (Lock) omp_unset_lock(&P2->my_lock);
+					}
 				}
 				break;
 			case 3:
@@ -0,0 +1,222 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#include "Kernels.h"
+
+namespace SPH {
+
+	// Qubic Spline, Monaghan & Lattanzio 1985
+	template <size_t Dim> inline double QubicSplineKernel<Dim>::Kernel (double const & q, double const & h) const
+	{
+		double C = (Dim == 2 ? 10.0/(7.0*M_PI) : 1.0/M_PI)/(Dim == 2 ? h*h : h*h*h);
+
+		if 			(q<1.0)	return C*(1.0-1.5*q*q+0.75*q*q*q);
+		else if (q<2.0)	return C*0.25*(2.0-q)*(2.0-q)*(2.0-q);
+		else						return 0.0;
+	}
+
+	template <size_t Dim> inline double QubicSplineKernel<Dim>::GradKernel (double const & q, double const & h) const
+	{
+		double C = (Dim == 2 ? 10.0/(7.0*M_PI) : 1.0/M_PI)/(Dim == 2 ? h*h*h*h : h*h*h*h*h);
+
+		if 			(q<1.0)	return C*(-3.0+2.25*q);
+		else if (q<2.0)	return C/q*(-0.75*(2.0-q)*(2.0-q));
+		else						return 0.0;
+	}
+
+	template <size_t Dim> inline double QubicSplineKernel<Dim>::LaplaceKernel (double const & q, double const & h) const
+	{
+		double C = (Dim == 2 ? 10.0/(7.0*M_PI) : 1.0/M_PI)/(Dim == 2 ? h*h*h*h : h*h*h*h*h);
+
+		if			(q<1.0)	return C*((-3.0+4.5*q) + (Dim-1.0)*(-3.0+2.25*q));
+		else if (q<2.0) return C*(1.5*(2.0-q) + (Dim-1.0)/q*(-0.75*(2.0-q)*(2.0-q)));
+		else						return 0.0;
+	}
+
+	template <size_t Dim> inline double QubicSplineKernel<Dim>::SecDerivativeKernel (double const & q, double const & h) const
+	{
+		double C = (Dim == 2 ? 10.0/(7.0*M_PI) : 1.0/M_PI)/(Dim == 2 ? h*h*h*h : h*h*h*h*h);
+
+		if 			(q<1.0)	return C*(-3.0+4.5*q);
+		else if (q<2.0)	return C*1.5*(2.0-q);
+		else						return 0.0;
+	}
+
+	// Quintic, Wendland 1995
+	template <size_t Dim> inline double QuinticKernel<Dim>::Kernel (double const & q, double const & h) const
+	{
+		double C = (Dim == 2 ? 7.0/(4.0*M_PI) : 7.0/(8.0*M_PI))/(Dim == 2 ? h*h : h*h*h);
+		double t = 1.0-0.5*q;
+
+		if			(q<2.0)	return C*t*t*t*t*(2.0*q+1.0);
+		else						return 0.0;
+	}
+
+	template <size_t Dim> inline double QuinticKernel<Dim>::GradKernel (double const & q, double const & h) const
+	{
+		double C = (Dim == 2 ? 7.0/(4.0*M_PI) : 7.0/(8.0*M_PI))/(Dim == 2 ? h*h*h*h : h*h*h*h*h);
+		double t = 1.0-0.5*q;
+
+		if 			(q<2.0)	return C*-5.0*t*t*t;
+		else						return 0.0;
+	}
+
+	template <size_t Dim> inline double QuinticKernel<Dim>::LaplaceKernel (double const & q, double const & h) const
+	{
+		double C = (Dim == 2 ? 7.0/(4.0*M_PI) : 7.0/(8.0*M_PI))/(Dim == 2 ? h*h*h*h : h*h*h*h*h);
+		double t = 1.0-0.5*q;
+
+		if 			(q<2.0)	return C*(t*t*(10.0*q-5.0) + (Dim-1.0)*-5.0*t*t*t);
+		else						return 0.0;
+	}
+
+	template <size_t Dim> inline double QuinticKernel<Dim>::SecDerivativeKernel (double const & q, double const & h) const
+	{
+		double C = (Dim == 2 ? 7.0/(4.0*M_PI) : 7.0/(8.0*M_PI))/(Dim == 2 ? h*h*h*h : h*h*h*h*h);
+		double t = 1.0-0.5*q;
+
+		if			(q<2.0)	return C*t*t*(10.0*q-5.0);
+		else						return 0.0;
+	}
+
+	// Quintic Spline, Morris et al 1997
+	template <size_t Dim> inline double QuinticSplineKernel<Dim>::Kernel (double const & q, double const & h) const
+	{
+		double C = (Dim == 2 ? 7.0/(478.0*M_PI) : 1.0/(120.0*M_PI))/(Dim == 2 ? h*h : h*h*h);
+		double a = 3.0-q, b = 2.0-q, c = 1.0-q;
+
+		if			(q<1.0)	return C*(a*a*a*a*a-6.0*b*b*b*b*b+15.0*c*c*c*c*c);
+		else if (q<2.0)	return C*(a*a*a*a*a-6.0*b*b*b*b*b);
+		else if (q<3.0)	return C*(a*a*a*a*a);
+		else						return 0.0;
+	}
+
+	template <size_t Dim> inline double QuinticSplineKernel<Dim>::GradKernel (double const & q, double const & h) const
+	{
+		double C = (Dim == 2 ? 7.0/(478.0*M_PI) : 1.0/(120.0*M_PI))/(Dim == 2 ? h*h*h*h : h*h*h*h*h);
+		double a = 3.0-q, b = 2.0-q, c = 1.0-q;
+
+		if			(q==0.0)	return C*-120.0;
+		else if (q<1.0)		return C/q*(-5.0*a*a*a*a+30.0*b*b*b*b-75.0*c*c*c*c);
+		else if (q<2.0)		return C/q*(-5.0*a*a*a*a+30.0*b*b*b*b);
+		else if (q<3.0)		return C/q*(-5.0*a*a*a*a);
+		else							return 0.0;
+	}
+
+	template <size_t Dim> inline double QuinticSplineKernel<Dim>::LaplaceKernel (double const & q, double const & h) const
+	{
+		double C = (Dim == 2 ? 7.0/(478.0*M_PI) : 1.0/(120.0*M_PI))/(Dim == 2 ? h*h*h*h : h*h*h*h*h);
+
+		if (q==0.0) return C*Dim*-120.0;
+		return SecDerivativeKernel(q,h) + (Dim-1.0)*GradKernel(q,h);
+	}
+
+	template <size_t Dim> inline double QuinticSplineKernel<Dim>::SecDerivativeKernel (double const & q, double const & h) const
+	{
+		double C = (Dim == 2 ? 7.0/(478.0*M_PI) : 1.0/(120.0*M_PI))/(Dim == 2 ? h*h*h*h : h*h*h*h*h);
+		double a = 3.0-q, b = 2.0-q, c = 1.0-q;
+
+		if			(q<1.0)	return C*(20.0*a*a*a-120.0*b*b*b+300.0*c*c*c);
+		else if (q<2.0)	return C*(20.0*a*a*a-120.0*b*b*b);
+		else if (q<3.0)	return C*(20.0*a*a*a);
+		else						return 0.0;
+	}
+
+	inline TabulatedKernel::TabulatedKernel ()
+	{
+		Size	= 0;
+		Dim	= 2;
+		Support	= 0.0;
+		InvDq	= 0.0;
+	}
+
+	template <typename KP> inline void SampleKernel (KP const & Ker, double const & Support, size_t const & N,
+							Array<double> & TW, Array<double> & TG, Array<double> & TL, Array<double> & TS)
+	{
+		// Sampling with h=1 gives the kernels without the h^Dim factors
+		for (size_t i=0; i<=N; i++)
+		{
+			double q = (i == N) ? Support : Support*i/N;
+			TW[i] = Ker.Kernel(q, 1.0);
+			TG[i] = Ker.GradKernel(q, 1.0);
+			TL[i] = Ker.LaplaceKernel(q, 1.0);
+			TS[i] = Ker.SecDerivativeKernel(q, 1.0);
+		}
+	}
+
+	inline void TabulatedKernel::Build (size_t const & D, size_t const & KT, size_t const & N)
+	{
+		if (N<1) throw new Fatal("TabulatedKernel::Build: The No of intervals must be positive");
+
+		Dim	= D;
+		Size	= N;
+		Support	= (KT == 2) ? 3.0 : 2.0;
+		InvDq	= N/Support;
+		TW.Resize(N+1);
+		TG.Resize(N+1);
+		TL.Resize(N+1);
+		TS.Resize(N+1);
+
+		switch (KT)
+		{
+			case 0:
+				if (Dim == 2) SampleKernel(QubicSplineKernel<2>(), Support, N, TW, TG, TL, TS); else SampleKernel(QubicSplineKernel<3>(), Support, N, TW, TG, TL, TS);
+				break;
+			case 1:
+				if (Dim == 2) SampleKernel(QuinticKernel<2>(), Support, N, TW, TG, TL, TS); else SampleKernel(QuinticKernel<3>(), Support, N, TW, TG, TL, TS);
+				break;
+			case 2:
+				if (Dim == 2) SampleKernel(QuinticSplineKernel<2>(), Support, N, TW, TG, TL, TS); else SampleKernel(QuinticSplineKernel<3>(), Support, N, TW, TG, TL, TS);
+				break;
+			default:
+				throw new Fatal("TabulatedKernel::Build: Kernel Type No is out of range");
+		}
+	}
+
+	inline double TabulatedKernel::Interpolate (Array<double> const & T, double const & q) const
+	{
+		if (q>=Support) return 0.0;
+		double x	= q*InvDq;
+		size_t i	= (size_t) x;
+		if (i >= Size) i = Size-1;	// q just below the support can round to the last node
+		return T[i] + (x-i)*(T[i+1]-T[i]);
+	}
+
+	inline double TabulatedKernel::Kernel (double const & q, double const & h) const
+	{
+		return Interpolate(TW, q)/(Dim == 2 ? h*h : h*h*h);
+	}
+
+	inline double TabulatedKernel::GradKernel (double const & q, double const & h) const
+	{
+		return Interpolate(TG, q)/(Dim == 2 ? h*h*h*h : h*h*h*h*h);
+	}
+
+	inline double TabulatedKernel::LaplaceKernel (double const & q, double const & h) const
+	{
+		return Interpolate(TL, q)/(Dim == 2 ? h*h*h*h : h*h*h*h*h);
+	}
+
+	inline double TabulatedKernel::SecDerivativeKernel (double const & q, double const & h) const
+	{
+		return Interpolate(TS, q)/(Dim == 2 ? h*h*h*h : h*h*h*h*h);
+	}
+
+}; // namespace SPH
@@ -0,0 +1,93 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#ifndef SPH_KERNELS_H
+#define SPH_KERNELS_H
+
+#include <math.h>
+
+#include "array.h"
+
+namespace SPH {
+
+	// Kernel policies: the interaction functions are instantiated on one of these classes, so the
+	// kernel type and the dimension are resolved at compile time. All of them return the same
+	// values as SPH::Kernel, GradKernel, LaplaceKernel and SecDerivativeKernel (see Functions.h).
+
+	template <size_t Dim> class QubicSplineKernel
+	{
+	public:
+		double Kernel			(double const & q, double const & h) const;
+		double GradKernel		(double const & q, double const & h) const;
+		double LaplaceKernel		(double const & q, double const & h) const;
+		double SecDerivativeKernel	(double const & q, double const & h) const;
+	};
+
+	template <size_t Dim> class QuinticKernel
+	{
+	public:
+		double Kernel			(double const & q, double const & h) const;
+		double GradKernel		(double const & q, double const & h) const;
+		double LaplaceKernel		(double const & q, double const & h) const;
+		double SecDerivativeKernel	(double const & q, double const & h) const;
+	};
+
+	template <size_t Dim> class QuinticSplineKernel
+	{
+	public:
+		double Kernel			(double const & q, double const & h) const;
+		double GradKernel		(double const & q, double const & h) const;
+		double LaplaceKernel		(double const & q, double const & h) const;
+		double SecDerivativeKernel	(double const & q, double const & h) const;
+	};
+
+	// Lookup table of any of the kernels above with linear interpolation in q
+	class TabulatedKernel
+	{
+	public:
+		// Constructor
+		TabulatedKernel			();
+
+		// Methods
+		void   Build			(size_t const & Dim, size_t const & KT, size_t const & N);	///< Sample kernel KT with N intervals over its support
+		double Kernel			(double const & q, double const & h) const;
+		double GradKernel		(double const & q, double const & h) const;
+		double LaplaceKernel		(double const & q, double const & h) const;
+		double SecDerivativeKernel	(double const & q, double const & h) const;
+
+		size_t	Size;		///< No of intervals of the tables (0 => not built)
+
+	private:
+		double	Interpolate		(Array<double> const & T, double const & q) const;
+
+		size_t	Dim;		///< Dimension
+		double	Support;	///< Support of the kernel in q
+		double	InvDq;		///< 1/(interval of q)
+		Array<double>	TW;	///< Kernel*h^Dim
+		Array<double>	TG;	///< GradKernel*h^(Dim+2)
+		Array<double>	TL;	///< LaplaceKernel*h^(Dim+2)
+		Array<double>	TS;	///< SecDerivativeKernel*h^(Dim+2)
+	};
+
+}; // namespace SPH
+
+#include "Kernels.cpp"
+
+#endif // SPH_KERNELS_H
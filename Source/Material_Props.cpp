@@ -0,0 +1,65 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#include "Material_Props.h"
+
+namespace SPH {
+
+	inline MaterialProps::MaterialProps(int Type0)
+	{
+		Type		= Type0;
+		PresEq		= 0;
+		Cs		= 0.0;
+		P0		= 0.0;
+		Alpha		= 0.0;
+		Beta		= 0.0;
+		MuRef		= 0.0;
+		T0		= 0.0;
+		m		= 300.0;
+		VisM		= 0;
+		LES		= false;
+		CSmag		= 0.17;
+		G		= 0.0;
+		K		= 0.0;
+		Sigmay		= 0.0;
+		Fail		= 0;
+		TI		= 0.0;
+		TIn		= 4.0;
+		c		= 0.0;
+		phi		= 0.0;
+		psi		= 0.0;
+		n0		= 0.0;
+		d		= 0.0;
+		RhoF		= 0.0;
+		VarPorosity	= false;
+		SeepageType	= 0;
+		Init();
+	}
+
+	inline void MaterialProps::Init()
+	{
+		DPAlpha2D	= tan(phi) / sqrt(9.0+12.0*tan(phi)*tan(phi));
+		DPKf2D		= 3.0 * c  / sqrt(9.0+12.0*tan(phi)*tan(phi));
+		DPAlpha3D	= (2.0*  sin(phi)) / (sqrt(3.0)*(3.0-sin(phi)));
+		DPKf3D		= (6.0*c*cos(phi)) / (sqrt(3.0)*(3.0-sin(phi)));
+		SinPsi		= sin(psi);
+	}
+
+}; // namespace SPH
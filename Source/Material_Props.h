@@ -0,0 +1,83 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#ifndef SPH_MATERIAL_PROPS_H
+#define SPH_MATERIAL_PROPS_H
+
+#include <math.h>
+
+namespace SPH {
+
+	// Constants of a material shared by all its particles, registered with Domain::AddMaterial.
+	// A particle only stores the index of its material (Particle::MatID).
+	class MaterialProps
+	{
+	public:
+		// Constructor
+		MaterialProps	(int Type0=1);
+
+		// Methods
+		void Init	();	///< Computes the derived constants, called by Domain::InitialChecks
+
+		// Data
+		int	Type;		///< Material type: 1 = Fluid, 2 = Solid, 3 = Soil
+
+		size_t	PresEq;		///< Selecting variable to choose an equation of state
+		double	Cs;		///< Speed of sound
+		double	P0;		///< background pressure for equation of state
+
+		double 	Alpha;		///< Artificial viscosity coefficient
+		double 	Beta;		///< Artificial viscosity coefficient
+		double 	MuRef;		///< Reference Dynamic viscosity coefficient
+		double 	T0;		///< Yield stress for Bingham fluids
+		double 	m;		///< Normalization value for Bingham fluids
+		size_t	VisM;		///< Non-Newtonian viscosity method
+		bool	LES;		///< Large eddy simulation using sub-particle scale
+		double	CSmag;		///< Coefficient of Smagorinsky-Lilly model
+
+		double 	G;		///< Shear modulus
+		double 	K;		///< Bulk modulus
+		double	Sigmay;		///< Tensile yield stress
+		size_t	Fail;		///< Failure criteria
+		double	TI;		///< Tensile instability factor
+		double	TIn;		///< Tensile instability power
+
+		double	c;		///< Cohesion
+		double	phi;		///< Friction angel
+		double	psi;		///< Dilation angel
+		double	n0;		///< Initial Prosity
+		double	d;		///< effective particle size
+		double	RhoF;		///< Density of water or any other fluids
+		bool	VarPorosity;	///< If yes, it will calculate porosity and permeability based on new calculated porosity
+		size_t	SeepageType;	///< Selecting variable to choose a Seepage method
+
+		// Derived constants (Init)
+		double	DPAlpha2D;	///< Drucker-Prager alpha for plane strain
+		double	DPKf2D;		///< Drucker-Prager kf for plane strain
+		double	DPAlpha3D;	///< Drucker-Prager alpha for 3D
+		double	DPKf3D;		///< Drucker-Prager kf for 3D
+		double	SinPsi;		///< sin(psi) of the non-associated flow rule
+	};
+
+}; // namespace SPH
+
+#include "Material_Props.cpp"
+
+#endif // SPH_MATERIAL_PROPS_H
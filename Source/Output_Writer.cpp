@@ -0,0 +1,537 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#include "Output_Writer.h"
+
+namespace SPH {
+
+inline OutputProfile::OutputProfile ()
+{
+	Fields		= Out_All;
+	Half		= 0;
+	PositionBits	= 0;
+	Deflate		= 0;
+	Shuffle		= false;
+	Chunk		= 16384;
+}
+
+inline hid_t HalfFloat ()
+{
+	// IEEE 754 half precision: sign bit 15, 5 exponent bits from bit 10, 10 mantissa bits and exponent bias 15
+	static hid_t Type = -1;
+	if (Type < 0)
+	{
+		Type = H5Tcopy(H5T_IEEE_F32LE);
+		H5Tset_fields(Type, 15, 10, 5, 0, 10);
+		H5Tset_size(Type, 2);
+		H5Tset_ebias(Type, 15);
+	}
+	return Type;
+}
+
+inline hid_t OutputProfile::FileType (unsigned Field, hid_t MemType) const
+{
+	return (Half & Field) ? HalfFloat() : MemType;
+}
+
+inline hid_t OutputProfile::Properties (unsigned Field, int Rank, hsize_t const * Dims, bool Chunked, int Digits) const
+{
+	hid_t Plist	= H5Pcreate(H5P_DATASET_CREATE);
+	bool Quantized	= (Field==Out_Position && PositionBits>0);
+	bool Filtered	= (Field!=0 && (Quantized || Deflate>0 || Shuffle));
+	if (!Chunked && !Filtered) return Plist;
+
+	H5Pset_chunk(Plist, Rank, Dims);
+	if (!Filtered) return Plist;
+
+	// The positions are rounded to Digits decimals and stored as integers relative to the minimum of each chunk,
+	// then the bytes of the stored values are shuffled and compressed
+	if (Quantized)	H5Pset_scaleoffset(Plist, H5Z_SO_FLOAT_DSCALE, Digits);
+	if (Shuffle)	H5Pset_shuffle(Plist);
+	if (Deflate>0)	H5Pset_deflate(Plist, Deflate);
+	return Plist;
+}
+
+inline OutputFrame::OutputFrame ()
+{
+	N		= 0;
+	Capacity	= 0;
+	Position = Velocity = Acceleration = Pressure = Density = Mass = h = Sigma = Strain = NULL;
+	Prop[0] = Prop[1] = Prop[2] = NULL;
+	Tag		= NULL;
+	Time		= 0.0;
+	Series		= NULL;
+	PositionDigits	= 0;
+}
+
+inline OutputFrame::~OutputFrame ()
+{
+	Free();
+}
+
+inline void OutputFrame::Free ()
+{
+	if (Capacity == 0) return;
+	delete [] Position;	delete [] Velocity;	delete [] Acceleration;
+	delete [] Pressure;	delete [] Density;	delete [] Mass;	delete [] h;
+	delete [] Prop[0];	delete [] Prop[1];	delete [] Prop[2];
+	delete [] Tag;		delete [] Sigma;	delete [] Strain;
+	Capacity = 0;
+}
+
+inline void OutputFrame::Resize (size_t N0)
+{
+	N = N0;
+	if (N <= Capacity) return;
+
+	// Some margin for the inflow particles
+	size_t NewCap = N + N/4 + 16;
+	Free();
+	Position	= new float[3*NewCap];
+	Velocity	= new float[3*NewCap];
+	Acceleration	= new float[3*NewCap];
+	Pressure	= new float[NewCap];
+	Density		= new float[NewCap];
+	Mass		= new float[NewCap];
+	h		= new float[NewCap];
+	Prop[0]		= new float[NewCap];
+	Prop[1]		= new float[NewCap];
+	Prop[2]		= new float[NewCap];
+	Tag		= new int  [NewCap];
+	Sigma		= new float[6*NewCap];
+	Strain		= new float[6*NewCap];
+	Capacity	= NewCap;
+}
+
+inline void WriteField (hid_t File, char const * Dataset, unsigned Field, hid_t Type, size_t Cols, OutputFrame const & F, void const * Data)
+{
+    // One dimensional dataset of Cols values per particle
+    if (!(F.Profile.Fields & Field)) return;
+
+    hsize_t Dims	= Cols*F.N;
+    hsize_t Chunk	= Cols*std::min(F.N, std::max<size_t>(1, F.Profile.Chunk));
+    hid_t Space	= H5Screate_simple(1, &Dims, NULL);
+    hid_t Plist	= (Dims>0) ? F.Profile.Properties(Field, 1, &Chunk, false, F.PositionDigits) : H5Pcreate(H5P_DATASET_CREATE);
+    hid_t Set	= H5Dcreate2(File, Dataset, F.Profile.FileType(Field, Type), Space, H5P_DEFAULT, Plist, H5P_DEFAULT);
+    H5Pclose(Plist);
+    H5Sclose(Space);
+    if (Set < 0) throw new Fatal("WriteFrame: Could not create the dataset %s in %s.hdf5", Dataset, F.Key.CStr());
+    herr_t Status = H5Dwrite(Set, Type, H5S_ALL, H5S_ALL, H5P_DEFAULT, Data);
+    H5Dclose(Set);
+    if (Status < 0) throw new Fatal("WriteFrame: Could not write the dataset %s in %s.hdf5", Dataset, F.Key.CStr());
+}
+
+inline void WriteFrame (OutputFrame const & F)
+{
+    if (F.Series != NULL)
+    {
+        F.Series->Append(F);
+        return;
+    }
+
+    String fn(F.Key);
+    fn.append(".hdf5");
+    hid_t file_id;
+    file_id = H5Fcreate(fn.CStr(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if (file_id < 0) throw new Fatal("WriteFrame: Could not create the file %s", fn.CStr());
+
+    size_t N = F.N;
+    int data[1];
+    String dsname;
+    hsize_t dims[1];
+    dims[0]=1;
+    data[0]=N;
+    dsname.Printf("/NP");
+    H5LTmake_dataset_int(file_id,dsname.CStr(),1,dims,data);
+    try
+    {
+        WriteField(file_id, "Position",		Out_Position,		H5T_NATIVE_FLOAT, 3, F, F.Position);
+        WriteField(file_id, "Velocity",		Out_Velocity,		H5T_NATIVE_FLOAT, 3, F, F.Velocity);
+        WriteField(file_id, "Acceleration",	Out_Acceleration,	H5T_NATIVE_FLOAT, 3, F, F.Acceleration);
+        WriteField(file_id, "Tag",			Out_Tag,		H5T_NATIVE_INT,   1, F, F.Tag);
+        WriteField(file_id, "Pressure",		Out_Pressure,		H5T_NATIVE_FLOAT, 1, F, F.Pressure);
+        WriteField(file_id, "Density",		Out_Density,		H5T_NATIVE_FLOAT, 1, F, F.Density);
+        WriteField(file_id, F.Name[0].CStr(),	Out_Prop0,		H5T_NATIVE_FLOAT, 1, F, F.Prop[0]);
+        WriteField(file_id, F.Name[1].CStr(),	Out_Prop1,		H5T_NATIVE_FLOAT, 1, F, F.Prop[1]);
+        WriteField(file_id, F.Name[2].CStr(),	Out_Prop2,		H5T_NATIVE_FLOAT, 1, F, F.Prop[2]);
+        WriteField(file_id, "Mass",			Out_Mass,		H5T_NATIVE_FLOAT, 1, F, F.Mass);
+        WriteField(file_id, "h",			Out_h,			H5T_NATIVE_FLOAT, 1, F, F.h);
+        WriteField(file_id, "Sigma",		Out_Sigma,		H5T_NATIVE_FLOAT, 6, F, F.Sigma);
+        WriteField(file_id, "Strain",		Out_Strain,		H5T_NATIVE_FLOAT, 6, F, F.Strain);
+    }
+    catch (Fatal * e)
+    {
+        H5Fclose(file_id);
+        throw;
+    }
+
+   //Closing the file
+    herr_t Status = H5Fflush(file_id,H5F_SCOPE_GLOBAL);
+    H5Fclose(file_id);
+    if (Status < 0) throw new Fatal("WriteFrame: Could not write the file %s", fn.CStr());
+
+    //Writing xmf file
+    std::ostringstream oss;
+    oss << "<?xml version=\"1.0\" ?>\n";
+    oss << "<!DOCTYPE Xdmf SYSTEM \"Xdmf.dtd\" []>\n";
+    oss << "<Xdmf Version=\"2.0\">\n";
+    oss << " <Domain>\n";
+    oss << "   <Grid Name=\"SPHCenter\" GridType=\"Uniform\">\n";
+    oss << "     <Topology TopologyType=\"Polyvertex\" NumberOfElements=\"" << N << "\"/>\n";
+    oss << "     <Geometry GeometryType=\"XYZ\">\n";
+    oss << "       <DataItem Format=\"HDF\" NumberType=\"Float\" Precision=\"10\" Dimensions=\"" << N << " 3\" >\n";
+    oss << "        " << fn.CStr() <<":/Position \n";
+    oss << "       </DataItem>\n";
+    oss << "     </Geometry>\n";
+
+    // Attributes of the written fields
+    char const * Names[11]	= {"Tag", "Position", "Velocity", "Acceleration", "Density", "Pressure", F.Name[0].CStr(), F.Name[1].CStr(), F.Name[2].CStr(), "Sigma", "Strain"};
+    char const * Types[11]	= {"Scalar", "Vector", "Vector", "Vector", "Scalar", "Scalar", "Scalar", "Scalar", "Scalar", "Tensor6", "Tensor6"};
+    char const * Dims[11]	= {"", " 3", " 3", " 3", "", "", "", "", "", " 6", " 6"};
+    unsigned Fields[11]		= {Out_Tag, Out_Position, Out_Velocity, Out_Acceleration, Out_Density, Out_Pressure, Out_Prop0, Out_Prop1, Out_Prop2, Out_Sigma, Out_Strain};
+    for (size_t k=0; k<11; k++)
+    {
+        if (!(F.Profile.Fields & Fields[k])) continue;
+        oss << "     <Attribute Name=\"" << Names[k] << "\" AttributeType=\"" << Types[k] << "\" Center=\"Node\">\n";
+        if (k==0)
+            oss << "       <DataItem Dimensions=\"" << N << "\" NumberType=\"Int\" Format=\"HDF\">\n";
+        else
+            oss << "       <DataItem Dimensions=\"" << N << Dims[k] << "\" NumberType=\"Float\" Precision=\"10\" Format=\"HDF\">\n";
+        oss << "        " << fn.CStr() <<":/" << Names[k] << " \n";
+        oss << "       </DataItem>\n";
+        oss << "     </Attribute>\n";
+    }
+    oss << "   </Grid>\n";
+    oss << " </Domain>\n";
+    oss << "</Xdmf>\n";
+
+
+    fn = F.Key;
+    fn.append(".xmf");
+    std::ofstream of(fn.CStr(), std::ios::out);
+    of << oss.str();
+    of.close();
+}
+
+
+inline OutputSeries::OutputSeries ()
+{
+	File	= -1;
+	Digits	= 0;
+	Rows	= 0;
+}
+
+inline OutputSeries::~OutputSeries ()
+{
+	if (IsOpen()) Close();
+}
+
+inline void OutputSeries::Open (char const * FileKey)
+{
+	if (IsOpen()) Close();
+	Key	= FileKey;
+	Rows	= 0;
+	Time.Clear();
+	NP.Clear();
+	Offset.Clear();
+
+	String fn(Key);
+	fn.append(".hdf5");
+	File = H5Fcreate(fn.CStr(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+	if (File < 0) throw new Fatal("OutputSeries::Open: Could not create the file %s", fn.CStr());
+
+	fn = Key;
+	fn.append(".xmf");
+	Xmf.open(fn.CStr(), std::ios::in | std::ios::out | std::ios::trunc);
+	if (!Xmf) throw new Fatal("OutputSeries::Open: Could not create the file %s", fn.CStr());
+	Xmf << "<?xml version=\"1.0\" ?>\n";
+	Xmf << "<!DOCTYPE Xdmf SYSTEM \"Xdmf.dtd\" []>\n";
+	Xmf << "<Xdmf Version=\"2.0\">\n";
+	Xmf << " <Domain>\n";
+	Xmf << "   <Grid Name=\"SPHSeries\" GridType=\"Collection\" CollectionType=\"Temporal\">\n";
+	XmfEnd = Xmf.tellp();
+	Xmf << "   </Grid>\n";
+	Xmf << " </Domain>\n";
+	Xmf << "</Xdmf>\n";
+	Xmf.flush();
+}
+
+inline void OutputSeries::Extend (char const * Dataset, hid_t Type, unsigned Field, size_t Cols, size_t Start, size_t Count, void const * Data)
+{
+	if (Field!=0 && !(Profile.Fields & Field)) return;
+
+	// Vectors and tensors are stored as one row per particle
+	int Rank	= (Cols > 1) ? 2 : 1;
+	hsize_t Dims[2]	= {Start+Count, Cols};
+	hid_t Set;
+	if (H5Lexists(File, Dataset, H5P_DEFAULT) > 0)
+	{
+		Set = H5Dopen2(File, Dataset, H5P_DEFAULT);
+		if (Set < 0) throw new Fatal("OutputSeries::Extend: Could not open the dataset %s", Dataset);
+	}
+	else
+	{
+		hsize_t Zero[2]	= {0, Cols};
+		hsize_t Max[2]	= {H5S_UNLIMITED, Cols};
+		hsize_t Chunk[2]	= {std::max<hsize_t>(1, std::min<hsize_t>(Count, Profile.Chunk)), Cols};
+		hid_t Space	= H5Screate_simple(Rank, Zero, Max);
+		hid_t Plist	= Profile.Properties(Field, Rank, Chunk, true, Digits);
+		Set = H5Dcreate2(File, Dataset, Profile.FileType(Field, Type), Space, H5P_DEFAULT, Plist, H5P_DEFAULT);
+		H5Pclose(Plist);
+		H5Sclose(Space);
+		if (Set < 0) throw new Fatal("OutputSeries::Extend: Could not create the dataset %s", Dataset);
+	}
+
+	// A full disk must not leave a silently truncated series
+	herr_t Status = H5Dset_extent(Set, Dims);
+	if (Status >= 0 && Count > 0)
+	{
+		hsize_t First[2]	= {Start, 0};
+		hsize_t Size[2]		= {Count, Cols};
+		hid_t FileSpace	= H5Dget_space(Set);
+		hid_t MemSpace	= H5Screate_simple(Rank, Size, NULL);
+		H5Sselect_hyperslab(FileSpace, H5S_SELECT_SET, First, NULL, Size, NULL);
+		Status = H5Dwrite(Set, Type, MemSpace, FileSpace, H5P_DEFAULT, Data);
+		H5Sclose(MemSpace);
+		H5Sclose(FileSpace);
+	}
+	H5Dclose(Set);
+	if (Status < 0) throw new Fatal("OutputSeries::Extend: Could not write the rows %zd to %zd of the dataset %s in %s.hdf5", Start, Start+Count, Dataset, Key.CStr());
+}
+
+inline void OutputSeries::Append (OutputFrame const & F)
+{
+	size_t Frame = Time.Size();
+	// The datasets are created with the fields and storage of the first frame
+	if (Frame == 0)
+	{
+		for (size_t k=0; k<3; k++) Name[k] = F.Name[k];
+		Profile	= F.Profile;
+		Digits	= F.PositionDigits;
+	}
+
+	Extend("Position",	H5T_NATIVE_FLOAT, Out_Position,		3, Rows, F.N, F.Position);
+	Extend("Velocity",	H5T_NATIVE_FLOAT, Out_Velocity,		3, Rows, F.N, F.Velocity);
+	Extend("Acceleration",	H5T_NATIVE_FLOAT, Out_Acceleration,	3, Rows, F.N, F.Acceleration);
+	Extend("Tag",		H5T_NATIVE_INT,   Out_Tag,		1, Rows, F.N, F.Tag);
+	Extend("Pressure",	H5T_NATIVE_FLOAT, Out_Pressure,		1, Rows, F.N, F.Pressure);
+	Extend("Density",	H5T_NATIVE_FLOAT, Out_Density,		1, Rows, F.N, F.Density);
+	Extend(Name[0].CStr(),	H5T_NATIVE_FLOAT, Out_Prop0,		1, Rows, F.N, F.Prop[0]);
+	Extend(Name[1].CStr(),	H5T_NATIVE_FLOAT, Out_Prop1,		1, Rows, F.N, F.Prop[1]);
+	Extend(Name[2].CStr(),	H5T_NATIVE_FLOAT, Out_Prop2,		1, Rows, F.N, F.Prop[2]);
+	Extend("Mass",		H5T_NATIVE_FLOAT, Out_Mass,		1, Rows, F.N, F.Mass);
+	Extend("h",		H5T_NATIVE_FLOAT, Out_h,		1, Rows, F.N, F.h);
+	Extend("Sigma",		H5T_NATIVE_FLOAT, Out_Sigma,		6, Rows, F.N, F.Sigma);
+	Extend("Strain",	H5T_NATIVE_FLOAT, Out_Strain,		6, Rows, F.N, F.Strain);
+
+	unsigned long long n = F.N, o = Rows;
+	Extend("Time",		H5T_NATIVE_DOUBLE, 0, 1, Frame, 1, &F.Time);
+	Extend("NP",		H5T_NATIVE_ULLONG, 0, 1, Frame, 1, &n);
+	Extend("Offset",	H5T_NATIVE_ULLONG, 0, 1, Frame, 1, &o);
+	if (H5Fflush(File, H5F_SCOPE_GLOBAL) < 0) throw new Fatal("OutputSeries::Append: Could not write the file %s.hdf5", Key.CStr());
+
+	Time.Push(F.Time);
+	NP.Push(F.N);
+	Offset.Push(Rows);
+	Rows += F.N;
+	WriteIndex(false);
+}
+
+inline void OutputSeries::WriteSlab (std::ostream & os, size_t i, char const * Dataset, size_t Cols, char const * NumberType) const
+{
+	// Rows of frame i in a dataset of the current No of rows (first row, stride and count)
+	String fn(Key);
+	fn.append(".hdf5");
+	String C;
+	if (Cols > 1) C.Printf(" %zd", Cols);
+	os << "       <DataItem ItemType=\"HyperSlab\" Dimensions=\"" << NP[i] << C << "\" Type=\"HyperSlab\">\n";
+	if (Cols > 1)
+		os << "        <DataItem Dimensions=\"3 2\" Format=\"XML\"> " << Offset[i] << " 0 1 1 " << NP[i] << C << " </DataItem>\n";
+	else
+		os << "        <DataItem Dimensions=\"3 1\" Format=\"XML\"> " << Offset[i] << " 1 " << NP[i] << " </DataItem>\n";
+	os << "        <DataItem Dimensions=\"" << Rows << C << "\" NumberType=\"" << NumberType << "\" Precision=\"4\" Format=\"HDF\"> " << fn.CStr() << ":/" << Dataset << " </DataItem>\n";
+	os << "       </DataItem>\n";
+}
+
+inline void OutputSeries::WriteGrid (std::ostream & os, size_t i) const
+{
+	char const * Names[11]	= {"Tag", "Position", "Velocity", "Acceleration", "Density", "Pressure", Name[0].CStr(), Name[1].CStr(), Name[2].CStr(), "Sigma", "Strain"};
+	char const * Types[11]	= {"Scalar", "Vector", "Vector", "Vector", "Scalar", "Scalar", "Scalar", "Scalar", "Scalar", "Tensor6", "Tensor6"};
+	size_t Cols[11]		= {1, 3, 3, 3, 1, 1, 1, 1, 1, 6, 6};
+	unsigned Fields[11]	= {Out_Tag, Out_Position, Out_Velocity, Out_Acceleration, Out_Density, Out_Pressure, Out_Prop0, Out_Prop1, Out_Prop2, Out_Sigma, Out_Strain};
+
+	os << "    <Grid Name=\"SPHCenter\" GridType=\"Uniform\">\n";
+	os << "     <Time Value=\"" << Time[i] << "\"/>\n";
+	os << "     <Topology TopologyType=\"Polyvertex\" NumberOfElements=\"" << NP[i] << "\"/>\n";
+	os << "     <Geometry GeometryType=\"XYZ\">\n";
+	WriteSlab(os, i, "Position", 3, "Float");
+	os << "     </Geometry>\n";
+	for (size_t k=0; k<11; k++)
+	{
+		if (!(Profile.Fields & Fields[k])) continue;
+		os << "     <Attribute Name=\"" << Names[k] << "\" AttributeType=\"" << Types[k] << "\" Center=\"Node\">\n";
+		WriteSlab(os, i, Names[k], Cols[k], (k==0) ? "Int" : "Float");
+		os << "     </Attribute>\n";
+	}
+	os << "    </Grid>\n";
+}
+
+inline void OutputSeries::WriteIndex (bool Final)
+{
+	// The frames are added before the closing tags, the final index repeats all of them with the final No of rows
+	std::ostringstream oss;
+	oss.precision(12);
+	if (Final)
+	{
+		String fn(Key);
+		fn.append(".xmf");
+		Xmf.close();
+		Xmf.open(fn.CStr(), std::ios::out | std::ios::trunc);
+		oss << "<?xml version=\"1.0\" ?>\n";
+		oss << "<!DOCTYPE Xdmf SYSTEM \"Xdmf.dtd\" []>\n";
+		oss << "<Xdmf Version=\"2.0\">\n";
+		oss << " <Domain>\n";
+		oss << "   <Grid Name=\"SPHSeries\" GridType=\"Collection\" CollectionType=\"Temporal\">\n";
+		for (size_t i=0; i<Time.Size(); i++) WriteGrid(oss, i);
+	}
+	else
+	{
+		Xmf.seekp(XmfEnd);
+		WriteGrid(oss, Time.Size()-1);
+	}
+	Xmf << oss.str();
+	XmfEnd = Xmf.tellp();
+	Xmf << "   </Grid>\n";
+	Xmf << " </Domain>\n";
+	Xmf << "</Xdmf>\n";
+	Xmf.flush();
+	if (!Xmf) throw new Fatal("OutputSeries::WriteIndex: Could not write the file %s.xmf", Key.CStr());
+}
+
+inline void OutputSeries::Close ()
+{
+	if (!IsOpen()) return;
+	H5Fclose(File);
+	File = -1;
+	WriteIndex(true);
+	Xmf.close();
+}
+
+inline OutputWriter::OutputWriter ()
+{
+	Queued[0] = Queued[1] = false;
+	Fill	= 0;
+	Head	= 0;
+	Started	= false;
+	Stop	= false;
+	Error	= NULL;
+	pthread_mutex_init(&Mutex, NULL);
+	pthread_cond_init(&Cond, NULL);
+}
+
+inline OutputWriter::~OutputWriter ()
+{
+	if (Started)
+	{
+		pthread_mutex_lock(&Mutex);
+		Stop = true;
+		pthread_cond_broadcast(&Cond);
+		pthread_mutex_unlock(&Mutex);
+		pthread_join(Thread, NULL);
+	}
+	delete Error;
+	pthread_cond_destroy(&Cond);
+	pthread_mutex_destroy(&Mutex);
+}
+
+inline OutputFrame & OutputWriter::Acquire ()
+{
+	pthread_mutex_lock(&Mutex);
+	while (Queued[Fill]) pthread_cond_wait(&Cond, &Mutex);
+	Fatal * E	= Error;
+	Error		= NULL;
+	pthread_mutex_unlock(&Mutex);
+	if (E != NULL) throw E;
+	return Frames[Fill];
+}
+
+inline void OutputWriter::Submit ()
+{
+	pthread_mutex_lock(&Mutex);
+	if (!Started)
+	{
+		if (pthread_create(&Thread, NULL, &OutputWriter::Run, this) != 0)
+		{
+			pthread_mutex_unlock(&Mutex);
+			throw new Fatal("OutputWriter::Submit: Could not start the output thread");
+		}
+		Started = true;
+	}
+	Queued[Fill]	= true;
+	Fill		= 1 - Fill;
+	pthread_cond_broadcast(&Cond);
+	pthread_mutex_unlock(&Mutex);
+}
+
+inline void OutputWriter::Wait ()
+{
+	pthread_mutex_lock(&Mutex);
+	while (Queued[0] || Queued[1]) pthread_cond_wait(&Cond, &Mutex);
+	Fatal * E	= Error;
+	Error		= NULL;
+	pthread_mutex_unlock(&Mutex);
+	if (E != NULL) throw E;
+}
+
+inline void * OutputWriter::Run (void * Writer)
+{
+	OutputWriter & W = *static_cast<OutputWriter*>(Writer);
+	pthread_mutex_lock(&W.Mutex);
+	while (true)
+	{
+		while (!W.Queued[W.Head] && !W.Stop) pthread_cond_wait(&W.Cond, &W.Mutex);
+		if (!W.Queued[W.Head]) break;
+
+		// The frame is not touched by the solver until it is released. An error is kept for the solver thread,
+		// which throws it from Acquire or Wait, and the following frames are dropped.
+		if (W.Error == NULL)
+		{
+			Fatal * E = NULL;
+			pthread_mutex_unlock(&W.Mutex);
+			try
+			{
+				WriteFrame(W.Frames[W.Head]);
+			}
+			catch (Fatal * e)		{ E = e; }
+			catch (std::exception & e)	{ E = new Fatal("OutputWriter: %s", e.what()); }
+			catch (...)			{ E = new Fatal("OutputWriter: Some exception (...) occurred while writing %s", W.Frames[W.Head].Key.CStr()); }
+			pthread_mutex_lock(&W.Mutex);
+			W.Error = E;
+		}
+
+		W.Queued[W.Head]	= false;
+		W.Head			= 1 - W.Head;
+		pthread_cond_broadcast(&W.Cond);
+	}
+	pthread_mutex_unlock(&W.Mutex);
+	return NULL;
+}
+
+}; // namespace SPH
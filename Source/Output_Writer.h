@@ -0,0 +1,179 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#ifndef SPH_OUTPUT_WRITER_H
+#define SPH_OUTPUT_WRITER_H
+
+#include <fstream>    // for ofstream
+#include <sstream>    // for ostringstream
+#include <pthread.h>
+
+#include <hdf5.h>
+#include <hdf5_hl.h>
+
+#include "array.h"
+#include "fatal.h"
+
+namespace SPH {
+
+	class OutputSeries;
+
+	// Fields of the output files, OutputProfile::Fields and OutputProfile::Half are sums of these flags
+	enum Output_Field_Type { Out_Position=1, Out_Velocity=2, Out_Acceleration=4, Out_Pressure=8, Out_Density=16, Out_Mass=32, Out_h=64, Out_Tag=128,
+				 Out_Sigma=256, Out_Strain=512, Out_Prop0=1024, Out_Prop1=2048, Out_Prop2=4096,
+				 Out_Fluid=7423, Out_All=8191 };	// Out_Fluid => all of the fields but Sigma and Strain
+
+	// Contents and storage of the output files. The quantized and half precision fields are converted back
+	// to floats by the HDF5 library, so the readers (and the XDMF files) do not change.
+	class OutputProfile
+	{
+	public:
+		// Constructor
+		OutputProfile		();
+
+		// Methods
+		hid_t FileType		(unsigned Field, hid_t MemType) const;	///< Type of a field in the file
+		hid_t Properties	(unsigned Field, int Rank, hsize_t const * Dims, bool Chunked, int Digits) const;	///< Creation properties of a dataset with chunks of Dims and the filters of a field (Field 0 => no filters, Chunked => chunks without filters too), closed by the caller
+
+		// Data
+		unsigned	Fields;		///< Written fields (default Out_All, Out_Position is needed by the XDMF geometry)
+		unsigned	Half;		///< Fields stored as 16 bit floats, range 6e-5 to 65504 with 3 significant digits (default 0, not for Out_Position and Out_Tag)
+		size_t		PositionBits;	///< Positions are stored in fixed point with at least this No of bits over the domain box (scale-offset filter, 0 => float)
+		size_t		Deflate;	///< gzip level of the datasets, 1 to 9 (0 => no compression)
+		bool		Shuffle;	///< Byte shuffle filter of the datasets, helps gzip (default false)
+		size_t		Chunk;		///< No of particles in each chunk of the filtered datasets (default 16384)
+	};
+
+	// Staging buffers of one output file, the fields are copied from the particles by Domain::Snapshot.
+	// The buffers only grow, so the frames are reused by the following outputs.
+	class OutputFrame
+	{
+	public:
+		// Constructor & Destructor
+		OutputFrame		();
+		~OutputFrame		();
+
+		// Methods
+		void Resize		(size_t N0);	///< Set the No of particles, reallocate only if the capacity is exceeded
+
+		// Data
+		String	Key;		///< File name without the extension
+		String	Name[3];	///< Names of the user output properties
+		size_t	N;		///< No of particles
+		double	Time;		///< Simulation time of the output
+		OutputSeries * Series;	///< The frame is appended to this time series instead of its own files (NULL => own files)
+		OutputProfile	Profile;	///< Fields and storage of the output
+		int	PositionDigits;	///< Decimal digits of the fixed point positions (Profile.PositionBits>0)
+
+		float	* Position;	///< 3*N
+		float	* Velocity;	///< 3*N
+		float	* Acceleration;	///< 3*N
+		float	* Pressure;
+		float	* Density;
+		float	* Mass;
+		float	* h;
+		float	* Prop[3];	///< User output properties
+		int	* Tag;
+		float	* Sigma;	///< 6*N
+		float	* Strain;	///< 6*N
+
+	private:
+		OutputFrame		(OutputFrame const &);
+		void operator=		(OutputFrame const &);
+		void Free		();
+
+		size_t	Capacity;	// Allocated No of particles
+	};
+
+	void WriteFrame (OutputFrame const & F);	///< Writes the .hdf5 and .xmf files of a frame (or appends it to its time series)
+
+	// Time series of frames in one HDF5 file with extensible chunked datasets, the rows of all of the frames are
+	// appended to /Position, /Velocity, ... and /Time, /NP and /Offset give the time, No of particles and first row
+	// of each frame. The XDMF file is a temporal collection of hyperslabs of the datasets.
+	class OutputSeries
+	{
+	public:
+		// Constructor & Destructor
+		OutputSeries		();
+		~OutputSeries		();		///< Closes the series if it is open
+
+		// Methods
+		void Open		(char const * FileKey);		///< Creates FileKey.hdf5 and FileKey.xmf
+		void Append		(OutputFrame const & F);	///< Appends a frame to the datasets and to the XDMF collection
+		void Close		();				///< Closes the HDF5 file and writes the final XDMF index
+		bool IsOpen		() const { return File >= 0; }	///< The series is open
+
+	private:
+		OutputSeries		(OutputSeries const &);
+		void operator=		(OutputSeries const &);
+		void Extend		(char const * Dataset, hid_t Type, unsigned Field, size_t Cols, size_t Start, size_t Count, void const * Data);	// Writes rows [Start,Start+Count) of a dataset, creating and growing it if needed (Field 0 => not filtered)
+		void WriteSlab		(std::ostream & os, size_t i, char const * Dataset, size_t Cols, char const * NumberType) const;	// XDMF hyperslab of frame i in a dataset
+		void WriteGrid		(std::ostream & os, size_t i) const;	// XDMF grid of frame i
+		void WriteIndex		(bool Final);		// Adds the last frame to the XDMF file, or writes all of the frames with the final dataset sizes
+
+		hid_t			File;		// HDF5 file (<0 => closed)
+		String			Key;		// File name without the extension
+		String			Name[3];	// Names of the user output properties
+		OutputProfile		Profile;	// Fields and storage of the series (first frame)
+		int			Digits;		// Decimal digits of the fixed point positions (first frame)
+		size_t			Rows;		// No of rows of the particle datasets
+		Array<double>		Time;		// Time of each frame
+		Array<size_t>		NP;		// No of particles of each frame
+		Array<size_t>		Offset;		// First row of each frame
+		std::fstream		Xmf;		// XDMF index, kept open to append the frames
+		std::streampos		XmfEnd;		// Position of the closing tags in the XDMF file
+	};
+
+	// Background writer with two staging frames: one is filled by the solver while the other one is written.
+	// Only the writer thread calls HDF5 while frames are queued.
+	class OutputWriter
+	{
+	public:
+		// Constructor & Destructor
+		OutputWriter		();
+		~OutputWriter		();		///< Writes the queued frames and stops the thread
+
+		// Methods
+		OutputFrame & Acquire	();		///< Frame to be filled, waits if both frames are still queued (throws the error of the writer thread)
+		void Submit		();		///< Queues the acquired frame for the writer thread
+		void Wait		();		///< Waits until all of the queued frames are written (throws the error of the writer thread)
+
+	private:
+		OutputWriter		(OutputWriter const &);
+		void operator=		(OutputWriter const &);
+		static void * Run	(void * Writer);	// Loop of the writer thread
+
+		OutputFrame		Frames[2];
+		bool			Queued[2];	// The frame waits for (or is in) the writer
+		size_t			Fill;		// Frame returned by Acquire
+		size_t			Head;		// Next frame to write
+		bool			Started;	// The thread is running
+		bool			Stop;		// The thread must return when the queue is empty
+		Fatal			* Error;	// Error of the writer thread, thrown on the solver thread by Acquire or Wait
+		pthread_t		Thread;
+		pthread_mutex_t		Mutex;
+		pthread_cond_t		Cond;
+	};
+
+}; // namespace SPH
+
+#include "Output_Writer.cpp"
+
+#endif // SPH_OUTPUT_WRITER_H
@@ -0,0 +1,112 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#include "Pair_List.h"
+
+namespace SPH {
+
+	inline PairList::PairList ()
+	{
+		_values	= NULL;
+		_geom	= NULL;
+		_keep	= false;
+		_size	= 0;
+		_space	= 0;
+		_peak	= 0;
+	}
+
+	inline PairList::PairList (PairList const & Other)
+	{
+		_values	= NULL;
+		_geom	= NULL;
+		_keep	= false;
+		_size	= 0;
+		_space	= 0;
+		_peak	= 0;
+		(*this) = Other;
+	}
+
+	inline PairList::~PairList ()
+	{
+		if (_values!=NULL) free(_values);
+		if (_geom!=NULL)   free(_geom);
+	}
+
+	inline void PairList::Clear ()
+	{
+		_size = 0;
+	}
+
+	inline void PairList::Reserve (size_t N)
+	{
+		if (N <= _space) return;
+		Pair_t * tmp = static_cast<Pair_t*>(realloc(_values, N*sizeof(Pair_t)));
+		if (tmp==NULL) throw new Fatal("PairList::Reserve: Could not allocate memory for %zd pairs", N);
+		_values	= tmp;
+		if (_keep)
+		{
+			PairGeom * tmpg = static_cast<PairGeom*>(realloc(_geom, N*sizeof(PairGeom)));
+			if (tmpg==NULL) throw new Fatal("PairList::Reserve: Could not allocate memory for %zd pairs", N);
+			_geom	= tmpg;
+		}
+		_space	= N;
+	}
+
+	inline void PairList::KeepGeom (bool Keep)
+	{
+		if (Keep == _keep) return;
+		_keep = Keep;
+		if (!Keep)
+		{
+			if (_geom!=NULL) free(_geom);
+			_geom = NULL;
+		}
+		else if (_space>0)
+		{
+			_geom = static_cast<PairGeom*>(malloc(_space*sizeof(PairGeom)));
+			if (_geom==NULL) throw new Fatal("PairList::KeepGeom: Could not allocate memory for %zd pairs", _space);
+		}
+	}
+
+	inline size_t PairList::Bytes () const
+	{
+		return _space*(sizeof(Pair_t) + (_keep ? sizeof(PairGeom) : 0));
+	}
+
+	inline void PairList::Push (size_t P1, size_t P2)
+	{
+		if (_size==_space) Reserve(2*_space + 1024);
+		_values[_size].first	= P1;
+		_values[_size].second	= P2;
+		_size++;
+		if (_size > _peak) _peak = _size;
+	}
+
+	inline void PairList::operator= (PairList const & Other)
+	{
+		if (&Other==this) return;
+		KeepGeom(Other._keep);
+		Reserve(Other._size);
+		std::copy(Other._values, Other._values+Other._size, _values);
+		_size	= Other._size;
+		_peak	= Other._peak;
+	}
+
+}; // namespace SPH
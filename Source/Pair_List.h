@@ -0,0 +1,95 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#ifndef SPH_PAIR_LIST_H
+#define SPH_PAIR_LIST_H
+
+#include <cstdlib>    // for realloc
+#include <algorithm>  // for std::copy
+
+#include "fatal.h"
+#include "matvec.h"
+#include "Precision.h"
+
+namespace SPH {
+
+	// Geometry of a pair computed once per time step and shared by the interaction passes
+	struct PairGeom
+	{
+		Real_t	xij[3];		///< Distance vector (periodic corrected)
+		Real_t	rij;		///< Distance
+		Real_t	W;		///< Kernel
+		Real_t	GK;		///< Gradient of the kernel
+
+		Vec3_t	Xij	() const { return Vec3_t(xij[0], xij[1], xij[2]); }	///< Distance vector in double
+	};
+
+	// Particle indices of a pair, a trivially copyable type so the lists can be reallocated
+	struct PairIndex
+	{
+		unsigned int	first;
+		unsigned int	second;
+	};
+
+	inline bool operator< (PairIndex const & A, PairIndex const & B) { return A.first<B.first || (A.first==B.first && A.second<B.second); }
+
+	// List of particle pairs for the neighbour search. Indices are stored with 32 bits and
+	// the memory is kept by Clear(), so the lists grow during the first steps and are then reused.
+	// The lists whose passes read the geometry of the pairs keep a slot for it (KeepGeom), operator= copies the flag but not the geometry.
+	class PairList
+	{
+	public:
+		typedef PairIndex Pair_t;
+
+		// Constructor & Destructor
+		PairList		();
+		PairList		(PairList const & Other);
+		~PairList		();
+
+		// Methods
+		size_t		Size		() const { return _size; }		///< No of pairs
+		size_t		Capacity	() const { return _space; }		///< No of allocated pairs
+		size_t		Peak		() const { return _peak; }		///< Max No of pairs since the construction
+		void		Clear		();					///< Empty the list but keep the memory
+		void		Reserve		(size_t N);				///< Allocate memory for N pairs
+		void		Push		(size_t P1, size_t P2);			///< Add a pair, the indices must be below UINT_MAX (checked by Domain::InitialChecks)
+		void		KeepGeom	(bool Keep);				///< Allocate a geometry slot for each pair (default false)
+		size_t		Bytes		() const;				///< Allocated memory of the indices and geometry
+
+		// Operators
+		Pair_t		& operator[]	(size_t i)       { return _values[i]; }
+		Pair_t const	& operator[]	(size_t i) const { return _values[i]; }
+		PairGeom	& Geom		(size_t i)       { return _geom[i]; }	///< Geometry of pair i (filled by the domain, only with KeepGeom)
+		PairGeom const	& Geom		(size_t i) const { return _geom[i]; }
+		void		operator=	(PairList const & Other);
+
+	private:
+		Pair_t	* _values;
+		PairGeom* _geom;
+		bool	_keep;
+		size_t	_size;
+		size_t	_space;
+		size_t	_peak;
+	};
+}; // namespace SPH
+
+#include "Pair_List.cpp"
+
+#endif // SPH_PAIR_LIST_H
@@ -22,30 +22,31 @@
 
 namespace SPH {
 
+// Generations of the particles, unique in the program
+inline size_t NextGeneration ()
+{
+	static size_t Last = 0;
+	size_t g;
+	#pragma omp atomic capture
+	g = ++Last;
+	return g;
+}
+
 inline Particle::Particle(int Tag, Vec3_t const & x0, Vec3_t const & v0, double Mass0, double Density0, double h0,bool Fixed)
 {
 	ct = 0;
 	a = 0.0;
     x = x0;
     n = 0.0;
-    n0 = 0.0;
     k = 0.0;
     k2 = 0.0;
 
-    Cs		= 0.0;
-    P0		= 0.0;
-    PresEq	= 0;
-    Alpha	= 0.0;
-    Beta	= 0.0;
-
     va = 0.0;
     vb = 0.0;
     NSv = 0.0;
     FSINSv = 0.0;
     v = v0;
     VXSPH = 0.0;
-    TI		= 0.0;
-    TIn		= 4.0;
     TIInitDist  = 0.0;
 
     Densitya = 0.0;
@@ -61,67 +62,49 @@ inline Particle::Particle(int Tag, Vec3_t const & x0, Vec3_t const & v0, double
     FSIPressure=0.0;
     ID = Tag;
     CC[0]= CC[1] = CC[2] = 0;
-    LL=0;
     ZWab = 0.0;
     SumDen = 0.0;
     dDensity=0.0;
     ShearRate = 0.0;
-    MuRef = Mu = 0.0;
-		VisM = 0;
-    T0 = 0.0;
-    m = 300.0;
+    Mu = 0.0;
     SumKernel = 0.0;
     FSISumKernel = 0.0;
-    G = 0.0;
-    K = 0.0;
     Material = 0;
-    Fail = 0;
-    c = 0.0;
-    phi = 0.0;
-    psi = 0.0;
-    d =0.0;
-    Sigmay = 0.0;
+    MatID = 0;
     NoSlip = false;
     Shepard = false;
     InOut = 0;
     FirstStep = true;
+    TimeBin = 0;
+    dtLimit = 0.0;
+    Active = true;
+    Sleeping = false;
+    QuietSteps = 0;
+    Level = 0;
+    Family = 0;
+    Generation = NextGeneration();
     V = Mass/RefDensity;
-    RhoF = 0.0;
     IsSat = false;
     SatCheck = false;
     ShepardStep = 40;
     ShepardCounter = 0;
     S = 0.0;
-    VarPorosity = false;
-    SeepageType = 0;
     S = 0;
-	LES = false;
 	SBar = 0.0;
-	CSmag = 0.17;
 
 
 
-    set_to_zero(Strainb);
-    set_to_zero(Strain);
-    set_to_zero(Sigmab);
-    set_to_zero(Sigma);
-//    set_to_zero(FSISigma);
-    set_to_zero(Sigmaa);
-    set_to_zero(ShearStress);
-    set_to_zero(ShearStressb);
-    set_to_zero(TIR);
     set_to_zero(StrainRate);
-    set_to_zero(RotationRate);
     omp_init_lock(&my_lock);
 
 }
 
-inline void Particle::Move(double dt, Vec3_t Domainsize, Vec3_t domainmax, Vec3_t domainmin, size_t Scheme, Mat3_t I)
+inline void Particle::Move(double dt, Vec3_t Domainsize, Vec3_t domainmax, Vec3_t domainmin, size_t Scheme, Mat3_t I, MaterialProps const & M)
 {
 	if (Scheme == 0)
-		Move_MVerlet(I, dt);
+		Move_MVerlet(I, dt, M);
 	else
-		Move_Leapfrog(I, dt);
+		Move_Leapfrog(I, dt, M);
 
 
 	//Periodic BC particle position update
@@ -143,37 +126,35 @@ inline void Particle::Move(double dt, Vec3_t Domainsize, Vec3_t domainmax, Vec3_
 
 }
 
-inline void Particle::Mat1(double dt)
+inline void Particle::Mat1(double dt, MaterialProps const & M)
 {
-	Pressure 	= EOS(PresEq, Cs, P0,Density, RefDensity);
-	double temp	= (StrainRate(0,0)*StrainRate(0,0) + 2.0*StrainRate(0,1)*StrainRate(1,0) +
-			2.0*StrainRate(0,2)*StrainRate(2,0) + StrainRate(1,1)*StrainRate(1,1) +
-			2.0*StrainRate(1,2)*StrainRate(2,1) + StrainRate(2,2)*StrainRate(2,2));
+	Pressure 	= EOS(M.PresEq, M.Cs, M.P0,Density, RefDensity);
+	double temp	= DoubleDot(StrainRate,StrainRate);
 
 	ShearRate	= sqrt(0.5*temp);
 	SBar		= sqrt(2.0*temp);
 
 	// LES model
-	if (LES)
+	if (M.LES)
 	{
-		Mu	= MuRef + RefDensity*pow((CSmag*h),2.0)*SBar;
+		Mu	= M.MuRef + RefDensity*pow((M.CSmag*h),2.0)*SBar;
 	}
 
 	// Bingham viscosity calculation
-	if (T0>0.0)
+	if (M.T0>0.0)
 	{
-		switch (VisM)
+		switch (M.VisM)
 		{
 			case 0:
 			// Bingham
 				if (ShearRate !=0.0)
-					Mu = MuRef + T0*(1-exp(-m*ShearRate))/ShearRate;
+					Mu = M.MuRef + M.T0*(1-exp(-M.m*ShearRate))/ShearRate;
 				else
-					Mu = MuRef + T0*m;
+					Mu = M.MuRef + M.T0*M.m;
 				break;
 			case 1:
 			// Cross
-				Mu = (1000.0*MuRef + MuRef*MuRef*1000.0/T0*ShearRate)/(1+1000.0*MuRef/T0*ShearRate);
+				Mu = (1000.0*M.MuRef + M.MuRef*M.MuRef*1000.0/M.T0*ShearRate)/(1+1000.0*M.MuRef/M.T0*ShearRate);
 				break;
 			default:
 				std::cout << "Non-Newtonian Viscosity Type No is out of range. Please correct it and run again" << std::endl;
@@ -186,7 +167,7 @@ inline void Particle::Mat1(double dt)
 }
 
 
-inline void Particle::Move_MVerlet (Mat3_t I, double dt)
+inline void Particle::Move_MVerlet (Mat3_t I, double dt, MaterialProps const & M)
 {
 	if (FirstStep)
 	{
@@ -253,13 +234,13 @@ inline void Particle::Move_MVerlet (Mat3_t I, double dt)
 
 	switch (Material)
     {case 1:
-    	Mat1(dt);
+    	Mat1(dt, M);
 		break;
     case 2:
-    	Mat2MVerlet(dt);
+    	Mat2MVerlet(dt, M);
     	break;
     case 3:
-    	Mat3MVerlet(I,dt);
+    	Mat3MVerlet(I,dt, M);
     	break;
    default:
 	   	std::cout << "Material Type No is out of range. Please correct it and run again" << std::endl;
@@ -273,34 +254,35 @@ inline void Particle::Move_MVerlet (Mat3_t I, double dt)
 	if (ShepardCounter == ShepardStep) ShepardCounter = 0; else ShepardCounter++;
 }
 
-inline void Particle::Mat2MVerlet(double dt)
+inline void Particle::Mat2MVerlet(double dt, MaterialProps const & M)
 {
-	Pressure = EOS(PresEq, Cs, P0,Density, RefDensity);
+	Sym3_t & ShearStress	= Solid->ShearStress;	Sym3_t & ShearStressb	= Solidb->ShearStress;
+	Sym3_t & Sigma		= Solid->Sigma;
+	Sym3_t & Strain		= Solid->Strain;	Sym3_t & Strainb	= Solidb->Strain;
+	Mat3_t & RotationRate	= Solid->RotationRate;
+
+	Pressure = EOS(M.PresEq, M.Cs, M.P0,Density, RefDensity);
 
 	// Jaumann rate terms
-	Mat3_t RotationRateT, Stress,SRT,RS;
-	Trans(RotationRate,RotationRateT);
-	Mult(ShearStress,RotationRateT,SRT);
-	Mult(RotationRate,ShearStress,RS);
+	Sym3_t JR = Jaumann(ShearStress,RotationRate);
+	Sym3_t Stress;
 
 	// Elastic prediction step (ShearStress_e n+1)
 	Stress			= ShearStress;
 	if (ct == 30)
-		ShearStress	= dt*(2.0*G*(StrainRate-1.0/3.0*(StrainRate(0,0)+StrainRate(1,1)+StrainRate(2,2))*OrthoSys::I)+SRT+RS) + ShearStress;
+		ShearStress	= dt*(2.0*M.G*Deviator(StrainRate)+JR) + ShearStress;
 	else
-		ShearStress	= 2.0*dt*(2.0*G*(StrainRate-1.0/3.0*(StrainRate(0,0)+StrainRate(1,1)+StrainRate(2,2))*OrthoSys::I)+SRT+RS) + ShearStressb;
+		ShearStress	= 2.0*dt*(2.0*M.G*Deviator(StrainRate)+JR) + ShearStressb;
 	ShearStressb	= Stress;
 
-	if (Fail == 1)
+	if (M.Fail == 1)
 	{
-		double J2	= 0.5*(ShearStress(0,0)*ShearStress(0,0) + 2.0*ShearStress(0,1)*ShearStress(1,0) +
-						2.0*ShearStress(0,2)*ShearStress(2,0) + ShearStress(1,1)*ShearStress(1,1) +
-						2.0*ShearStress(1,2)*ShearStress(2,1) + ShearStress(2,2)*ShearStress(2,2));
+		double J2	= J2Invariant(ShearStress);
 		//Scale back
-		ShearStress	= std::min((Sigmay/sqrt(3.0*J2)),1.0)*ShearStress;
+		ShearStress	= std::min((M.Sigmay/sqrt(3.0*J2)),1.0)*ShearStress;
 	}
 
-	Sigma			= -Pressure * OrthoSys::I + ShearStress;
+	Sigma			= Iso(-Pressure) + ShearStress;
 
 	Stress	= Strain;
 	if (ct == 30)
@@ -310,52 +292,55 @@ inline void Particle::Mat2MVerlet(double dt)
 	Strainb	= Stress;
 
 
-	if (Fail > 1)
+	if (M.Fail > 1)
 	{
 		std::cout<<"Undefined failure criteria for solids"<<std::endl;
 		abort();
 	}
 }
 
-inline void Particle::Mat3MVerlet(Mat3_t I, double dt)
+inline void Particle::Mat3MVerlet(Mat3_t I, double dt, MaterialProps const & M)
 {
-	Mat3_t RotationRateT, Stress, SRT,RS;
+	Sym3_t & ShearStress	= Solid->ShearStress;
+	Sym3_t & Sigma		= Solid->Sigma;		Sym3_t & Sigmab		= Solidb->Sigma;
+	Sym3_t & Strain		= Solid->Strain;	Sym3_t & Strainb	= Solidb->Strain;
+	Mat3_t & RotationRate	= Solid->RotationRate;
+
+	Sym3_t JR, Stress;
 	double I1,J2,alpha,kf,I1strain;
 
 	// Jaumann rate terms
-	Trans(RotationRate,RotationRateT);
-	Mult(Sigma,RotationRateT,SRT);
-	Mult(RotationRate,Sigma,RS);
+	JR = Jaumann(Sigma,RotationRate);
 
 	// Volumetric strain
-	I1strain = StrainRate(0,0)+StrainRate(1,1)+StrainRate(2,2);
+	I1strain = Trace(StrainRate);
 
 	// Elastic prediction step (Sigma_e n+1)
 	Stress	= Sigma;
 	if (ct == 30)
-		Sigma	= dt*(I1strain*K*OrthoSys::I + 2.0*G*(StrainRate-1.0/3.0*I1strain*OrthoSys::I) + SRT + RS) + Sigma;
+		Sigma	= dt*(Iso(I1strain*M.K) + 2.0*M.G*Deviator(StrainRate) + JR) + Sigma;
 	else
-		Sigma	= 2.0*dt*( I1strain*K*OrthoSys::I + 2.0*G*(StrainRate-1.0/3.0*I1strain*OrthoSys::I) + SRT + RS) + Sigmab;
+		Sigma	= 2.0*dt*( Iso(I1strain*M.K) + 2.0*M.G*Deviator(StrainRate) + JR) + Sigmab;
 	Sigmab	= Stress;
 
-	if (Fail>1)
+	if (M.Fail>1)
 	{
 		if (I(2,2)==0.0)
 		{
 			// Drucker-Prager failure criterion for plane strain
-			alpha	= tan(phi) / sqrt(9.0+12.0*tan(phi)*tan(phi));
-			kf		= 3.0 * c  / sqrt(9.0+12.0*tan(phi)*tan(phi));
+			alpha	= M.DPAlpha2D;
+			kf		= M.DPKf2D;
 		}
 		else
 		{
 			// Drucker-Prager failure criterion for 3D
-			alpha	= (2.0*  sin(phi)) / (sqrt(3.0)*(3.0-sin(phi)));
-			kf		= (6.0*c*cos(phi)) / (sqrt(3.0)*(3.0-sin(phi)));
+			alpha	= M.DPAlpha3D;
+			kf		= M.DPKf3D;
 		}
 
 
 		// Bring back stress to the apex of the failure criteria
-		I1		= Sigma(0,0) + Sigma(1,1) + Sigma(2,2);
+		I1		= Trace(Sigma);
 		if ((kf-alpha*I1)<0.0)
 		{
 			double Ratio;
@@ -367,38 +352,33 @@ inline void Particle::Mat3MVerlet(Mat3_t I, double dt)
 		}
 
 		// Shear stress based on the elastic assumption (S_e n+1)
-		ShearStress = Sigma - 1.0/3.0* I1 *OrthoSys::I;
-		J2 			= 0.5*(ShearStress(0,0)*ShearStress(0,0) + 2.0*ShearStress(0,1)*ShearStress(1,0) +
-						2.0*ShearStress(0,2)*ShearStress(2,0) + ShearStress(1,1)*ShearStress(1,1) +
-						2.0*ShearStress(1,2)*ShearStress(2,1) + ShearStress(2,2)*ShearStress(2,2));
+		ShearStress = Sigma - Iso(I1/3.0);
+		J2 			= J2Invariant(ShearStress);
 
 
 		// Check the elastic prediction step by the failure criteria
 		if ((sqrt(J2)+alpha*I1-kf)>0.0)
 		{
 			// Shear stress based on the existing stress (S n)
-			ShearStress = Stress - 1.0/3.0*(Stress(0,0)+Stress(1,1)+Stress(2,2))*OrthoSys::I;
-			J2 			= 0.5*(ShearStress(0,0)*ShearStress(0,0) + 2.0*ShearStress(0,1)*ShearStress(1,0) +
-							2.0*ShearStress(0,2)*ShearStress(2,0) + ShearStress(1,1)*ShearStress(1,1) +
-							2.0*ShearStress(1,2)*ShearStress(2,1) + ShearStress(2,2)*ShearStress(2,2));
+			ShearStress = Deviator(Stress);
+			J2 			= J2Invariant(ShearStress);
 
 			if (sqrt(J2)>0.0)
 			{
-				Mat3_t temp, Plastic;
+				Sym3_t Plastic;
 				double sum,dLanda;
 
 				// calculating the plastic term based on the existing shear stress and strain rate
-				temp	= abab(ShearStress,StrainRate);
-				sum		= temp(0,0)+temp(0,1)+temp(0,2)+temp(1,0)+temp(1,1)+temp(1,2)+temp(2,0)+temp(2,1)+temp(2,2);
-				switch (Fail)
+				sum		= DoubleDot(ShearStress,StrainRate);
+				switch (M.Fail)
 				{
 				case 2:
-					dLanda	= 1.0/(9.0*alpha*alpha*K+G)*( (3.0*alpha*K*I1strain) + (G/sqrt(J2))*sum );
-					Plastic	= 3.0*alpha*K*I + G/sqrt(J2)*ShearStress;
+					dLanda	= 1.0/(9.0*alpha*alpha*M.K+M.G)*( (3.0*alpha*M.K*I1strain) + (M.G/sqrt(J2))*sum );
+					Plastic	= 3.0*alpha*M.K*Sym3_t(I) + M.G/sqrt(J2)*ShearStress;
 					break;
 				case 3:
-					dLanda	= 1.0/(9.0*alpha*K*3.0*sin(psi)+G)*( (3.0*alpha*K*I1strain) + (G/sqrt(J2))*sum );
-					Plastic	= 3.0*3.0*sin(psi)*K*I + G/sqrt(J2)*ShearStress;
+					dLanda	= 1.0/(9.0*alpha*M.K*3.0*M.SinPsi+M.G)*( (3.0*alpha*M.K*I1strain) + (M.G/sqrt(J2))*sum );
+					Plastic	= 3.0*3.0*M.SinPsi*M.K*Sym3_t(I) + M.G/sqrt(J2)*ShearStress;
 					break;
 				default:
 					std::cout << "Failure Type No is out of range. Please correct it and run again" << std::endl;
@@ -415,7 +395,7 @@ inline void Particle::Mat3MVerlet(Mat3_t I, double dt)
 			}
 
 			//Scale back
-			I1			= Sigma(0,0) + Sigma(1,1) + Sigma(2,2);
+			I1			= Trace(Sigma);
 			if ((kf-alpha*I1)<0.0)
 			{
 				double Ratio;
@@ -425,12 +405,10 @@ inline void Particle::Mat3MVerlet(Mat3_t I, double dt)
 				Sigma(2,2) -= 1.0/3.0*(I1-Ratio);
 				I1 			= Ratio;
 			}
-			ShearStress	= Sigma - 1.0/3.0* I1 *OrthoSys::I;
-			J2			= 0.5*(ShearStress(0,0)*ShearStress(0,0) + 2.0*ShearStress(0,1)*ShearStress(1,0) +
-							2.0*ShearStress(0,2)*ShearStress(2,0) + ShearStress(1,1)*ShearStress(1,1) +
-							2.0*ShearStress(1,2)*ShearStress(2,1) + ShearStress(2,2)*ShearStress(2,2));
+			ShearStress	= Sigma - Iso(I1/3.0);
+			J2			= J2Invariant(ShearStress);
 
-			if ((sqrt(J2)+alpha*I1-kf)>0.0 && sqrt(J2)>0.0) Sigma = I1/3.0*OrthoSys::I + (kf-alpha*I1)/sqrt(J2) * ShearStress;
+			if ((sqrt(J2)+alpha*I1-kf)>0.0 && sqrt(J2)>0.0) Sigma = Iso(I1/3.0) + (kf-alpha*I1)/sqrt(J2) * ShearStress;
 		}
 	}
 
@@ -441,26 +419,26 @@ inline void Particle::Mat3MVerlet(Mat3_t I, double dt)
 		Strain	= 2.0*dt*StrainRate + Strainb;
 	Strainb	= Stress;
 
-	if (VarPorosity)
+	if (M.VarPorosity)
 	{
 		if (IsFree)
 		{
-			double ev = (Strain(0,0)+Strain(1,1)+Strain(2,2));
-			n = (n0+ev)/(1.0+ev);
-			switch(SeepageType)
+			double ev = Trace(Strain);
+			n = (M.n0+ev)/(1.0+ev);
+			switch(M.SeepageType)
 			{
 				case 0:
 					break;
 				case 1:
-					k = n*n*n*d*d/(180.0*(1.0-n)*(1.0-n));
+					k = n*n*n*M.d*M.d/(180.0*(1.0-n)*(1.0-n));
 					break;
 				case 2:
-					k = n*n*n*d*d/(150.0*(1.0-n)*(1.0-n));
-					k2= 1.75*(1.0-n)/(n*n*n*d);
+					k = n*n*n*M.d*M.d/(150.0*(1.0-n)*(1.0-n));
+					k2= 1.75*(1.0-n)/(n*n*n*M.d);
 					break;
 				case 3:
-					k = n*n*n*d*d/(150.0*(1.0-n)*(1.0-n));
-					k2= 0.4/(n*n*d);
+					k = n*n*n*M.d*M.d/(150.0*(1.0-n)*(1.0-n));
+					k2= 0.4/(n*n*M.d);
 					break;
 				default:
 					std::cout << "Seepage Type No is out of range. Please correct it and run again" << std::endl;
@@ -473,54 +451,58 @@ inline void Particle::Mat3MVerlet(Mat3_t I, double dt)
 			}
 		}
 		else
-			n = n0;
+			n = M.n0;
 	}
 	else
-		n = n0;
+		n = M.n0;
 
 
 }
 
-inline void Particle::ScalebackMat3(size_t Dimension,size_t Scheme)
+inline void Particle::ScalebackMat3(size_t Dimension, size_t Scheme, MaterialProps const & M)
 {
+	Sym3_t & ShearStress	= Solid->ShearStress;
+	Sym3_t & Sigma		= Solid->Sigma;
 	double I1,J2,alpha,kf;
 
 	if (Dimension==0.0)
 	{
 		// Drucker-Prager failure criterion for plane strain
-		alpha	= tan(phi) / sqrt(9.0+12.0*tan(phi)*tan(phi));
-		kf		= 3.0 * c  / sqrt(9.0+12.0*tan(phi)*tan(phi));
+		alpha	= M.DPAlpha2D;
+		kf		= M.DPKf2D;
 	}
 	else
 	{
 		// Drucker-Prager failure criterion for 3D
-		alpha	= (2.0*  sin(phi)) / (sqrt(3.0)*(3.0-sin(phi)));
-		kf		= (6.0*c*cos(phi)) / (sqrt(3.0)*(3.0-sin(phi)));
+		alpha	= M.DPAlpha3D;
+		kf		= M.DPKf3D;
 	}
 
-	// Bring back stressb to the apex of the failure criteria
-	I1	= Sigmab(0,0) + Sigmab(1,1) + Sigmab(2,2);
-	if ((kf-alpha*I1)<0.0)
+	// Bring back stressb to the apex of the failure criteria (Modified Verlet)
+	if (Solidb != NULL)
 	{
-		double Ratio;
-		if (alpha == 0.0) Ratio =0.0; else Ratio = kf/alpha;
-		Sigmab(0,0) -= 1.0/3.0*(I1-Ratio);
-		Sigmab(1,1) -= 1.0/3.0*(I1-Ratio);
-		Sigmab(2,2) -= 1.0/3.0*(I1-Ratio);
-		I1 	     = Ratio;
-	}
+		Sym3_t & Sigmab = Solidb->Sigma;
+		I1	= Trace(Sigmab);
+		if ((kf-alpha*I1)<0.0)
+		{
+			double Ratio;
+			if (alpha == 0.0) Ratio =0.0; else Ratio = kf/alpha;
+			Sigmab(0,0) -= 1.0/3.0*(I1-Ratio);
+			Sigmab(1,1) -= 1.0/3.0*(I1-Ratio);
+			Sigmab(2,2) -= 1.0/3.0*(I1-Ratio);
+			I1 	     = Ratio;
+		}
 
-	ShearStress	= Sigmab - 1.0/3.0* I1 *OrthoSys::I;
-	J2			= 0.5*(ShearStress(0,0)*ShearStress(0,0) + 2.0*ShearStress(0,1)*ShearStress(1,0) +
-				2.0*ShearStress(0,2)*ShearStress(2,0) + ShearStress(1,1)*ShearStress(1,1) +
-				2.0*ShearStress(1,2)*ShearStress(2,1) + ShearStress(2,2)*ShearStress(2,2));
+		ShearStress	= Sigmab - Iso(I1/3.0);
+		J2			= J2Invariant(ShearStress);
 
-	if ((sqrt(J2)+alpha*I1-kf)>0.0 && sqrt(J2)>0.0) Sigmab = I1/3.0*OrthoSys::I + (kf-alpha*I1)/sqrt(J2) * ShearStress;
+		if ((sqrt(J2)+alpha*I1-kf)>0.0 && sqrt(J2)>0.0) Sigmab = Iso(I1/3.0) + (kf-alpha*I1)/sqrt(J2) * ShearStress;
+	}
 
 	// Bring back stress to the apex of the failure criteria
 	if (Scheme == 0)
 	{
-		I1	= Sigma(0,0) + Sigma(1,1) + Sigma(2,2);
+		I1	= Trace(Sigma);
 		if ((kf-alpha*I1)<0.0)
 		{
 			double Ratio;
@@ -531,16 +513,15 @@ inline void Particle::ScalebackMat3(size_t Dimension,size_t Scheme)
 			I1 	    = Ratio;
 		}
 
-		ShearStress	= Sigma - 1.0/3.0* I1 *OrthoSys::I;
-		J2			= 0.5*(ShearStress(0,0)*ShearStress(0,0) + 2.0*ShearStress(0,1)*ShearStress(1,0) +
-					2.0*ShearStress(0,2)*ShearStress(2,0) + ShearStress(1,1)*ShearStress(1,1) +
-					2.0*ShearStress(1,2)*ShearStress(2,1) + ShearStress(2,2)*ShearStress(2,2));
+		ShearStress	= Sigma - Iso(I1/3.0);
+		J2			= J2Invariant(ShearStress);
 
-		if ((sqrt(J2)+alpha*I1-kf)>0.0 && sqrt(J2)>0.0) Sigma = I1/3.0*OrthoSys::I + (kf-alpha*I1)/sqrt(J2) * ShearStress;
+		if ((sqrt(J2)+alpha*I1-kf)>0.0 && sqrt(J2)>0.0) Sigma = Iso(I1/3.0) + (kf-alpha*I1)/sqrt(J2) * ShearStress;
 	}
 	else
 	{
-		I1	= Sigmaa(0,0) + Sigmaa(1,1) + Sigmaa(2,2);
+		Sym3_t & Sigmaa = Solida->Sigma;
+		I1	= Trace(Sigmaa);
 		if ((kf-alpha*I1)<0.0)
 		{
 			double Ratio;
@@ -550,15 +531,53 @@ inline void Particle::ScalebackMat3(size_t Dimension,size_t Scheme)
 			Sigmaa(2,2) -= 1.0/3.0*(I1-Ratio);
 			I1 			= Ratio;
 		}
-		ShearStress	= Sigmaa - 1.0/3.0* I1 *OrthoSys::I;
-		J2			= 0.5*(ShearStress(0,0)*ShearStress(0,0) + 2.0*ShearStress(0,1)*ShearStress(1,0) +
-						2.0*ShearStress(0,2)*ShearStress(2,0) + ShearStress(1,1)*ShearStress(1,1) +
-						2.0*ShearStress(1,2)*ShearStress(2,1) + ShearStress(2,2)*ShearStress(2,2));
-		if ((sqrt(J2)+alpha*I1-kf)>0.0 && sqrt(J2)>0.0) Sigmaa = I1/3.0*OrthoSys::I + (kf-alpha*I1)/sqrt(J2) * ShearStress;
+		ShearStress	= Sigmaa - Iso(I1/3.0);
+		J2			= J2Invariant(ShearStress);
+		if ((sqrt(J2)+alpha*I1-kf)>0.0 && sqrt(J2)>0.0) Sigmaa = Iso(I1/3.0) + (kf-alpha*I1)/sqrt(J2) * ShearStress;
+	}
+}
+
+inline void Particle::Touch()
+{
+	Generation = NextGeneration();
+}
+
+inline void Particle::AllocateState(MaterialProps const & M, size_t Scheme)
+{
+	Material = M.Type;
+	Touch();
+	if (Material < 2)
+	{
+		Solid.Reset(NULL);
+		Solida.Reset(NULL);
+		Solidb.Reset(NULL);
+		return;
+	}
+
+	if (Solid == NULL)
+	{
+		Solid.Reset(new SolidState);
+		set_to_zero(Solid->ShearStress);
+		set_to_zero(Solid->Sigma);
+		set_to_zero(Solid->Strain);
+		set_to_zero(Solid->TIR);
+		set_to_zero(Solid->RotationRate);
+	}
+
+	// Modified Verlet keeps the state n-1, Leapfrog the state n+1/2
+	StatePtr<StressState> & Keep = (Scheme == 0 ? Solidb : Solida);
+	StatePtr<StressState> & Drop = (Scheme == 0 ? Solida : Solidb);
+	Drop.Reset(NULL);
+	if (Keep == NULL)
+	{
+		Keep.Reset(new StressState);
+		set_to_zero(Keep->ShearStress);
+		set_to_zero(Keep->Sigma);
+		set_to_zero(Keep->Strain);
 	}
 }
 
-inline void Particle::Move_Leapfrog(Mat3_t I, double dt)
+inline void Particle::Move_Leapfrog(Mat3_t I, double dt, MaterialProps const & M)
 {
 	if (FirstStep)
 	{
@@ -575,13 +594,13 @@ inline void Particle::Move_Leapfrog(Mat3_t I, double dt)
 
 	switch (Material)
     {case 1:
-    	Mat1(dt);
+    	Mat1(dt, M);
 		break;
     case 2:
-    	Mat2Leapfrog(dt);
+    	Mat2Leapfrog(dt, M);
     	break;
     case 3:
-    	Mat3Leapfrog(I,dt);
+    	Mat3Leapfrog(I,dt, M);
     	break;
    default:
 	   	std::cout << "Material Type No is out of range. Please correct it and run again" << std::endl;
@@ -595,34 +614,35 @@ inline void Particle::Move_Leapfrog(Mat3_t I, double dt)
 
 }
 
-inline void Particle::Mat2Leapfrog(double dt)
+inline void Particle::Mat2Leapfrog(double dt, MaterialProps const & M)
 {
-	Pressure = EOS(PresEq, Cs, P0,Density, RefDensity);
+	Sym3_t & ShearStress	= Solid->ShearStress;	Sym3_t & ShearStressa	= Solida->ShearStress;
+	Sym3_t & Sigma		= Solid->Sigma;
+	Sym3_t & Strain		= Solid->Strain;	Sym3_t & Straina	= Solida->Strain;
+	Mat3_t & RotationRate	= Solid->RotationRate;
+	Sym3_t ShearStressb, Strainb;
+
+	Pressure = EOS(M.PresEq, M.Cs, M.P0,Density, RefDensity);
 
 	// Jaumann rate terms
-	Mat3_t RotationRateT,SRT,RS;
-	Trans(RotationRate,RotationRateT);
-	Mult(ShearStress,RotationRateT,SRT);
-	Mult(RotationRate,ShearStress,RS);
+	Sym3_t JR = Jaumann(ShearStress,RotationRate);
 
 	// Elastic prediction step (ShearStress_e n+1)
 	if (FirstStep)
-		ShearStressa	= -dt/2.0*(2.0*G*(StrainRate-1.0/3.0*(StrainRate(0,0)+StrainRate(1,1)+StrainRate(2,2))*OrthoSys::I)+SRT+RS) + ShearStress;
+		ShearStressa	= -dt/2.0*(2.0*M.G*Deviator(StrainRate)+JR) + ShearStress;
 
 	ShearStressb	= ShearStressa;
-	ShearStressa	= dt*(2.0*G*(StrainRate-1.0/3.0*(StrainRate(0,0)+StrainRate(1,1)+StrainRate(2,2))*OrthoSys::I)+SRT+RS) + ShearStressa;
+	ShearStressa	= dt*(2.0*M.G*Deviator(StrainRate)+JR) + ShearStressa;
 
-	if (Fail == 1)
+	if (M.Fail == 1)
 	{
-		double J2	= 0.5*(ShearStressa(0,0)*ShearStressa(0,0) + 2.0*ShearStressa(0,1)*ShearStressa(1,0) +
-						2.0*ShearStressa(0,2)*ShearStressa(2,0) + ShearStressa(1,1)*ShearStressa(1,1) +
-						2.0*ShearStressa(1,2)*ShearStressa(2,1) + ShearStressa(2,2)*ShearStressa(2,2));
+		double J2	= J2Invariant(ShearStressa);
 		//Scale back
-		ShearStressa= std::min((Sigmay/sqrt(3.0*J2)),1.0)*ShearStressa;
+		ShearStressa= std::min((M.Sigmay/sqrt(3.0*J2)),1.0)*ShearStressa;
 	}
 	ShearStress	= 1.0/2.0*(ShearStressa+ShearStressb);
 
-	Sigma = -Pressure * OrthoSys::I + ShearStress;
+	Sigma = Iso(-Pressure) + ShearStress;
 
 	if (FirstStep)
 		Straina	= -dt/2.0*StrainRate + Strain;
@@ -631,50 +651,54 @@ inline void Particle::Mat2Leapfrog(double dt)
 	Strain	= 1.0/2.0*(Straina+Strainb);
 
 
-	if (Fail > 1)
+	if (M.Fail > 1)
 	{
 		std::cout<<"Undefined failure criteria for solids"<<std::endl;
 		abort();
 	}
 }
 
-inline void Particle::Mat3Leapfrog(Mat3_t I, double dt)
+inline void Particle::Mat3Leapfrog(Mat3_t I, double dt, MaterialProps const & M)
 {
-	Mat3_t RotationRateT, Stress, SRT,RS;
+	Sym3_t & ShearStress	= Solid->ShearStress;
+	Sym3_t & Sigma		= Solid->Sigma;		Sym3_t & Sigmaa		= Solida->Sigma;
+	Sym3_t & Strain		= Solid->Strain;	Sym3_t & Straina	= Solida->Strain;
+	Mat3_t & RotationRate	= Solid->RotationRate;
+	Sym3_t Sigmab, Strainb;
+
+	Sym3_t JR, Stress;
 	double I1,J2,alpha,kf,I1strain;
 
 	// Jaumann rate terms
-	Trans(RotationRate,RotationRateT);
-	Mult(Sigma,RotationRateT,SRT);
-	Mult(RotationRate,Sigma,RS);
+	JR = Jaumann(Sigma,RotationRate);
 
 	// Volumetric strain
-	I1strain = StrainRate(0,0)+StrainRate(1,1)+StrainRate(2,2);
+	I1strain = Trace(StrainRate);
 
 	// Elastic prediction step (Sigma_e n+1)
 	if (FirstStep)
-		Sigmaa	= -dt/2.0*(I1strain*K*OrthoSys::I + 2.0*G*(StrainRate-1.0/3.0*I1strain*OrthoSys::I) + SRT + RS) + Sigma;
+		Sigmaa	= -dt/2.0*(Iso(I1strain*M.K) + 2.0*M.G*Deviator(StrainRate) + JR) + Sigma;
 
 	Sigmab	= Sigmaa;
-	Sigmaa	= dt*(I1strain*K*OrthoSys::I + 2.0*G*(StrainRate-1.0/3.0*I1strain*OrthoSys::I) + SRT + RS) + Sigmaa;
+	Sigmaa	= dt*(Iso(I1strain*M.K) + 2.0*M.G*Deviator(StrainRate) + JR) + Sigmaa;
 
-	if (Fail>1)
+	if (M.Fail>1)
 	{
 		if (I(2,2)==0.0)
 		{
 			// Drucker-Prager failure criterion for plane strain
-			alpha	= tan(phi) / sqrt(9.0+12.0*tan(phi)*tan(phi));
-			kf		= 3.0 * c  / sqrt(9.0+12.0*tan(phi)*tan(phi));
+			alpha	= M.DPAlpha2D;
+			kf		= M.DPKf2D;
 		}
 		else
 		{
 			// Drucker-Prager failure criterion for 3D
-			alpha	= (2.0*  sin(phi)) / (sqrt(3.0)*(3.0-sin(phi)));
-			kf		= (6.0*c*cos(phi)) / (sqrt(3.0)*(3.0-sin(phi)));
+			alpha	= M.DPAlpha3D;
+			kf		= M.DPKf3D;
 		}
 
 		// Bring back stress to the apex of the failure criteria
-		I1		= Sigmaa(0,0) + Sigmaa(1,1) + Sigmaa(2,2);
+		I1		= Trace(Sigmaa);
 		if ((kf-alpha*I1)<0.0)
 		{
 			double Ratio;
@@ -686,38 +710,33 @@ inline void Particle::Mat3Leapfrog(Mat3_t I, double dt)
 		}
 
 		// Shear stress based on the elastic assumption (S_e n+1)
-		ShearStress = Sigmaa - 1.0/3.0* I1 *OrthoSys::I;
-		J2 			= 0.5*(ShearStress(0,0)*ShearStress(0,0) + 2.0*ShearStress(0,1)*ShearStress(1,0) +
-						2.0*ShearStress(0,2)*ShearStress(2,0) + ShearStress(1,1)*ShearStress(1,1) +
-						2.0*ShearStress(1,2)*ShearStress(2,1) + ShearStress(2,2)*ShearStress(2,2));
+		ShearStress = Sigmaa - Iso(I1/3.0);
+		J2 			= J2Invariant(ShearStress);
 
 
 		// Check the elastic prediction step by the failure criteria
 		if ((sqrt(J2)+alpha*I1-kf)>0.0)
 		{
 			// Shear stress based on the existing stress (S n)
-			ShearStress = Sigma - 1.0/3.0*(Sigma(0,0)+Sigma(1,1)+Sigma(2,2))*OrthoSys::I;
-			J2 			= 0.5*(ShearStress(0,0)*ShearStress(0,0) + 2.0*ShearStress(0,1)*ShearStress(1,0) +
-							2.0*ShearStress(0,2)*ShearStress(2,0) + ShearStress(1,1)*ShearStress(1,1) +
-							2.0*ShearStress(1,2)*ShearStress(2,1) + ShearStress(2,2)*ShearStress(2,2));
+			ShearStress = Deviator(Sigma);
+			J2 			= J2Invariant(ShearStress);
 
 			if (sqrt(J2)>0.0)
 			{
-				Mat3_t temp, Plastic;
+				Sym3_t Plastic;
 				double sum,dLanda;
 
 				// calculating the plastic term based on the existing shear stress and strain rate
-				temp	= abab(ShearStress,StrainRate);
-				sum		= temp(0,0)+temp(0,1)+temp(0,2)+temp(1,0)+temp(1,1)+temp(1,2)+temp(2,0)+temp(2,1)+temp(2,2);
-				switch (Fail)
+				sum		= DoubleDot(ShearStress,StrainRate);
+				switch (M.Fail)
 				{
 				case 2:
-					dLanda	= 1.0/(9.0*alpha*alpha*K+G)*( (3.0*alpha*K*I1strain) + (G/sqrt(J2))*sum );
-					Plastic	= 3.0*alpha*K*I + G/sqrt(J2)*ShearStress;
+					dLanda	= 1.0/(9.0*alpha*alpha*M.K+M.G)*( (3.0*alpha*M.K*I1strain) + (M.G/sqrt(J2))*sum );
+					Plastic	= 3.0*alpha*M.K*Sym3_t(I) + M.G/sqrt(J2)*ShearStress;
 					break;
 				case 3:
-					dLanda	= 1.0/(9.0*alpha*K*3.0*sin(psi)+G)*( (3.0*alpha*K*I1strain) + (G/sqrt(J2))*sum );
-					Plastic	= 3.0*3.0*sin(psi)*K*I + G/sqrt(J2)*ShearStress;
+					dLanda	= 1.0/(9.0*alpha*M.K*3.0*M.SinPsi+M.G)*( (3.0*alpha*M.K*I1strain) + (M.G/sqrt(J2))*sum );
+					Plastic	= 3.0*3.0*M.SinPsi*M.K*Sym3_t(I) + M.G/sqrt(J2)*ShearStress;
 					break;
 				default:
 					std::cout << "Failure Type No is out of range. Please correct it and run again" << std::endl;
@@ -729,7 +748,7 @@ inline void Particle::Mat3Leapfrog(Mat3_t I, double dt)
 				Sigmaa = Sigmaa - dt*(dLanda*Plastic);
 			}
 
-			I1	= Sigmaa(0,0) + Sigmaa(1,1) + Sigmaa(2,2);
+			I1	= Trace(Sigmaa);
 			if ((kf-alpha*I1)<0.0)
 			{
 				double Ratio;
@@ -739,11 +758,9 @@ inline void Particle::Mat3Leapfrog(Mat3_t I, double dt)
 				Sigmaa(2,2) -= 1.0/3.0*(I1-Ratio);
 				I1 			= Ratio;
 			}
-			ShearStress	= Sigmaa - 1.0/3.0* I1 *OrthoSys::I;
-			J2			= 0.5*(ShearStress(0,0)*ShearStress(0,0) + 2.0*ShearStress(0,1)*ShearStress(1,0) +
-							2.0*ShearStress(0,2)*ShearStress(2,0) + ShearStress(1,1)*ShearStress(1,1) +
-							2.0*ShearStress(1,2)*ShearStress(2,1) + ShearStress(2,2)*ShearStress(2,2));
-			if ((sqrt(J2)+alpha*I1-kf)>0.0 && sqrt(J2)>0.0) Sigmaa = I1/3.0*OrthoSys::I + (kf-alpha*I1)/sqrt(J2) * ShearStress;
+			ShearStress	= Sigmaa - Iso(I1/3.0);
+			J2			= J2Invariant(ShearStress);
+			if ((sqrt(J2)+alpha*I1-kf)>0.0 && sqrt(J2)>0.0) Sigmaa = Iso(I1/3.0) + (kf-alpha*I1)/sqrt(J2) * ShearStress;
 		}
 	}
 	Sigma = 1.0/2.0*(Sigmaa+Sigmab);
@@ -754,26 +771,26 @@ inline void Particle::Mat3Leapfrog(Mat3_t I, double dt)
 	Straina	= dt*StrainRate + Straina;
 	Strain	= 1.0/2.0*(Straina+Strainb);
 
-	if (VarPorosity)
+	if (M.VarPorosity)
 	{
 		if (IsFree)
 		{
-			double ev = (Strain(0,0)+Strain(1,1)+Strain(2,2));
-			n = (n0+ev)/(1.0+ev);
-			switch(SeepageType)
+			double ev = Trace(Strain);
+			n = (M.n0+ev)/(1.0+ev);
+			switch(M.SeepageType)
 			{
 				case 0:
 					break;
 				case 1:
-					k = n*n*n*d*d/(180.0*(1.0-n)*(1.0-n));
+					k = n*n*n*M.d*M.d/(180.0*(1.0-n)*(1.0-n));
 					break;
 				case 2:
-					k = n*n*n*d*d/(150.0*(1.0-n)*(1.0-n));
-					k2= 1.75*(1.0-n)/(n*n*n*d);
+					k = n*n*n*M.d*M.d/(150.0*(1.0-n)*(1.0-n));
+					k2= 1.75*(1.0-n)/(n*n*n*M.d);
 					break;
 				case 3:
-					k = n*n*n*d*d/(150.0*(1.0-n)*(1.0-n));
-					k2= 0.4/(n*n*d);
+					k = n*n*n*M.d*M.d/(150.0*(1.0-n)*(1.0-n));
+					k2= 0.4/(n*n*M.d);
 					break;
 				default:
 					std::cout << "Seepage Type No is out of range. Please correct it and run again" << std::endl;
@@ -786,10 +803,10 @@ inline void Particle::Mat3Leapfrog(Mat3_t I, double dt)
 			}
 		}
 		else
-			n = n0;
+			n = M.n0;
 	}
 	else
-		n = n0;
+		n = M.n0;
 
 
 }
@@ -822,4 +839,89 @@ inline void Particle::translate(double dt, Vec3_t Domainsize, Vec3_t domainmax,
 	}
 }
 
+// The state is written as doubles, the integers and flags are exact in a double
+template <typename T> inline void PackState (Array<double> & Buf, T Value)	{ Buf.Push(static_cast<double>(Value)); }
+inline void PackState (Array<double> & Buf, Vec3_t const & v)	{ for (size_t i=0; i<3; i++) Buf.Push(v(i)); }
+inline void PackState (Array<double> & Buf, Sym3_t const & S)	{ for (size_t i=0; i<6; i++) Buf.Push(S.c[i]); }
+inline void PackState (Array<double> & Buf, Mat3_t const & M)	{ for (size_t i=0; i<3; i++) for (size_t j=0; j<3; j++) Buf.Push(M(i,j)); }
+inline void PackState (Array<double> & Buf, StressState const & S)	{ PackState(Buf, S.ShearStress); PackState(Buf, S.Sigma); PackState(Buf, S.Strain); }
+
+template <typename T> inline void UnpackState (double const * & Buf, T & Value)	{ Value = static_cast<T>(*Buf++); }
+inline void UnpackState (double const * & Buf, bool & Value)	{ Value = (*Buf++ != 0.0); }
+inline void UnpackState (double const * & Buf, Vec3_t & v)	{ for (size_t i=0; i<3; i++) v(i) = *Buf++; }
+inline void UnpackState (double const * & Buf, Sym3_t & S)	{ for (size_t i=0; i<6; i++) S.c[i] = *Buf++; }
+inline void UnpackState (double const * & Buf, Mat3_t & M)	{ for (size_t i=0; i<3; i++) for (size_t j=0; j<3; j++) M(i,j) = *Buf++; }
+inline void UnpackState (double const * & Buf, StressState & S)	{ UnpackState(Buf, S.ShearStress); UnpackState(Buf, S.Sigma); UnpackState(Buf, S.Strain); }
+
+inline void Particle::Pack (Array<double> & Buf) const
+{
+	PackState(Buf, Shepard);	PackState(Buf, ShepardCounter);	PackState(Buf, ShepardStep);	PackState(Buf, ZWab);	PackState(Buf, SumDen);
+	PackState(Buf, IsFree);		PackState(Buf, InOut);		PackState(Buf, IsSat);		PackState(Buf, SatCheck);	PackState(Buf, NoSlip);
+	PackState(Buf, ID);		PackState(Buf, Material);	PackState(Buf, MatID);
+
+	PackState(Buf, x);	PackState(Buf, vb);	PackState(Buf, va);	PackState(Buf, v);
+	PackState(Buf, NSv);	PackState(Buf, FSINSv);	PackState(Buf, VXSPH);	PackState(Buf, a);
+
+	PackState(Buf, Pressure);	PackState(Buf, FSIPressure);
+	PackState(Buf, Density);	PackState(Buf, Densitya);	PackState(Buf, Densityb);	PackState(Buf, dDensity);
+	PackState(Buf, RefDensity);	PackState(Buf, FPMassC);	PackState(Buf, Mass);
+
+	PackState(Buf, StrainRate);	PackState(Buf, ShearRate);	PackState(Buf, SBar);
+	PackState(Buf, TIInitDist);	PackState(Buf, Mu);
+	PackState(Buf, n);	PackState(Buf, k);	PackState(Buf, k2);	PackState(Buf, V);	PackState(Buf, S);
+
+	PackState(Buf, h);	PackState(Buf, CC[0]);	PackState(Buf, CC[1]);	PackState(Buf, CC[2]);	PackState(Buf, ct);
+	PackState(Buf, SumKernel);	PackState(Buf, FSISumKernel);	PackState(Buf, FirstStep);
+	PackState(Buf, TimeBin);	PackState(Buf, dtLimit);	PackState(Buf, Active);
+	PackState(Buf, Sleeping);	PackState(Buf, QuietSteps);	PackState(Buf, Level);	PackState(Buf, Family);
+
+	// The optional solid state follows its flags
+	PackState(Buf, Solid != NULL);	PackState(Buf, Solida != NULL);	PackState(Buf, Solidb != NULL);
+	if (Solid != NULL)
+	{
+		PackState(Buf, static_cast<StressState const &>(*Solid));
+		PackState(Buf, Solid->RotationRate);
+		PackState(Buf, Solid->TIR);
+	}
+	if (Solida != NULL) PackState(Buf, *Solida);
+	if (Solidb != NULL) PackState(Buf, *Solidb);
+}
+
+inline void Particle::Unpack (double const * & Buf)
+{
+	UnpackState(Buf, Shepard);	UnpackState(Buf, ShepardCounter);	UnpackState(Buf, ShepardStep);	UnpackState(Buf, ZWab);	UnpackState(Buf, SumDen);
+	UnpackState(Buf, IsFree);	UnpackState(Buf, InOut);		UnpackState(Buf, IsSat);	UnpackState(Buf, SatCheck);	UnpackState(Buf, NoSlip);
+	UnpackState(Buf, ID);		UnpackState(Buf, Material);		UnpackState(Buf, MatID);
+
+	UnpackState(Buf, x);	UnpackState(Buf, vb);	UnpackState(Buf, va);	UnpackState(Buf, v);
+	UnpackState(Buf, NSv);	UnpackState(Buf, FSINSv);	UnpackState(Buf, VXSPH);	UnpackState(Buf, a);
+
+	UnpackState(Buf, Pressure);	UnpackState(Buf, FSIPressure);
+	UnpackState(Buf, Density);	UnpackState(Buf, Densitya);	UnpackState(Buf, Densityb);	UnpackState(Buf, dDensity);
+	UnpackState(Buf, RefDensity);	UnpackState(Buf, FPMassC);	UnpackState(Buf, Mass);
+
+	UnpackState(Buf, StrainRate);	UnpackState(Buf, ShearRate);	UnpackState(Buf, SBar);
+	UnpackState(Buf, TIInitDist);	UnpackState(Buf, Mu);
+	UnpackState(Buf, n);	UnpackState(Buf, k);	UnpackState(Buf, k2);	UnpackState(Buf, V);	UnpackState(Buf, S);
+
+	UnpackState(Buf, h);	UnpackState(Buf, CC[0]);	UnpackState(Buf, CC[1]);	UnpackState(Buf, CC[2]);	UnpackState(Buf, ct);
+	UnpackState(Buf, SumKernel);	UnpackState(Buf, FSISumKernel);	UnpackState(Buf, FirstStep);
+	UnpackState(Buf, TimeBin);	UnpackState(Buf, dtLimit);	UnpackState(Buf, Active);
+	UnpackState(Buf, Sleeping);	UnpackState(Buf, QuietSteps);	UnpackState(Buf, Level);	UnpackState(Buf, Family);
+
+	bool HasSolid, HasSolida, HasSolidb;
+	UnpackState(Buf, HasSolid);	UnpackState(Buf, HasSolida);	UnpackState(Buf, HasSolidb);
+	Solid.Reset (HasSolid  ? new SolidState  : NULL);
+	Solida.Reset(HasSolida ? new StressState : NULL);
+	Solidb.Reset(HasSolidb ? new StressState : NULL);
+	if (HasSolid)
+	{
+		UnpackState(Buf, static_cast<StressState &>(*Solid));
+		UnpackState(Buf, Solid->RotationRate);
+		UnpackState(Buf, Solid->TIR);
+	}
+	if (HasSolida) UnpackState(Buf, *Solida);
+	if (HasSolidb) UnpackState(Buf, *Solidb);
+}
+
 }; // namespace SPH
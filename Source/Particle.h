@@ -21,11 +21,49 @@
 #ifndef SPH_PARTICLE_H
 #define SPH_PARTICLE_H
 
+#include "array.h"
 #include "matvec.h"
 #include "Functions.h"
+#include "Sym_Tensor.h"
+#include "Material_Props.h"
 
 namespace SPH {
 
+	// Stress and strain of a solid or soil particle at one time level (history of the integration schemes)
+	class StressState
+	{
+	public:
+		Sym3_t	ShearStress;	///< Deviatoric shear stress tensor (deviatoric part of the Cauchy stress tensor)
+		Sym3_t	Sigma;		///< Cauchy stress tensor (Total Stress)
+		Sym3_t	Strain;		///< Total Strain
+	};
+
+	// Owning pointer of the optional particle state, the state is copied with the particle
+	template <typename T> class StatePtr
+	{
+	public:
+		StatePtr	()				: p(NULL) {}
+		StatePtr	(StatePtr const & B)		: p(B.p!=NULL ? new T(*B.p) : NULL) {}
+		~StatePtr	()				{ delete p; }
+
+		StatePtr & operator=	(StatePtr const & B)	{ if (this != &B) Reset(B.p!=NULL ? new T(*B.p) : NULL); return *this; }
+		void Reset		(T * q)			{ if (q != p) { delete p; p = q; } }	///< Takes the ownership of q
+		T * operator->		() const		{ return p; }
+		T & operator*		() const		{ return *p; }
+		operator T *		() const		{ return p; }
+
+	private:
+		T * p;
+	};
+
+	// Continuum state of a solid or soil particle, fluid particles do not allocate it
+	class SolidState : public StressState
+	{
+	public:
+		Mat3_t	RotationRate;	///< Global rotation tensor n
+		Sym3_t	TIR;		///< Tensile Instability stress tensor R
+	};
+
 	class Particle
 	{
 	public:
@@ -43,7 +81,8 @@ namespace SPH {
 		bool   	NoSlip;		///< No-Slip BC
 
 		int    	ID;		///< an Integer value to identify the particle set
-		int    	Material;	///< an Integer value to identify the particle material type: 1 = Fluid, 2 = Solid, 3 = Soil
+		int    	Material;	///< an Integer value to identify the particle material type: 1 = Fluid, 2 = Solid, 3 = Soil (set from the material table)
+		size_t	MatID;		///< Index of the particle material in Domain::Materials
 
 		Vec3_t	x;		///< Position of the particle n
 		Vec3_t	vb;		///< Velocity of the particle n-1 (Modified Verlet)
@@ -54,9 +93,6 @@ namespace SPH {
 		Vec3_t	VXSPH;		///< Mean Velocity of neighbor particles for updating the particle position (XSPH)
 		Vec3_t	a;		///< Acceleration of the particle n
 
-		size_t	PresEq;		///< Selecting variable to choose an equation of state
-		double	Cs;		///< Speed of sound
-		double	P0;		///< background pressure for equation of state
 		double 	Pressure;	///< Pressure of the particle n+1
 		double 	FSIPressure;	///< Pressure of the particle n+1 in FSI
 
@@ -68,66 +104,39 @@ namespace SPH {
 		double 	FPMassC;	///< Mass coefficient for fixed particles to avoid leaving particles
 		double 	Mass;		///< Mass of the particle
 
-		Mat3_t	StrainRate;	///< Global shear Strain rate tensor n
-		Mat3_t	RotationRate;	///< Global rotation tensor n
+		Sym3_t	StrainRate;	///< Global shear Strain rate tensor n
 		double	ShearRate;	///< Global shear rate for fluids
 		double	SBar;		///< shear component for LES
 
-		Mat3_t	ShearStress;	///< Deviatoric shear stress tensor (deviatoric part of the Cauchy stress tensor) n+1
-		Mat3_t	ShearStressa;	///< Deviatoric shear stress tensor (deviatoric part of the Cauchy stress tensor) n+1/2 (Leapfrog)
-		Mat3_t	ShearStressb;	///< Deviatoric shear stress tensor (deviatoric part of the Cauchy stress tensor) n-1 (Modified Verlet)
-
-		Mat3_t	Sigma;		///< Cauchy stress tensor (Total Stress) n+1
-		//    Mat3_t	FSISigma;	///< Cauchy stress tensor (Total Stress) n+1 in FSI
-		Mat3_t	Sigmaa;		///< Cauchy stress tensor (Total Stress) n+1/2 (Leapfrog)
-		Mat3_t	Sigmab;		///< Cauchy stress tensor (Total Stress) n-1 (Modified Verlet)
-
-		Mat3_t	Strain;		///< Total Strain n+1
-		Mat3_t	Straina;	///< Total Strain n+1/2 (Leapfrog)
-		Mat3_t	Strainb;	///< Total Strain n-1 (Modified Verlet)
+		// Allocated by AllocateState for solid and soil particles only (NULL for fluid particles)
+		StatePtr<SolidState>	Solid;	///< Stress, strain (n+1), rotation rate and tensile instability stress
+		StatePtr<StressState>	Solida;	///< Stress and strain n+1/2 (Leapfrog only)
+		StatePtr<StressState>	Solidb;	///< Stress and strain n-1 (Modified Verlet only)
 
-		Mat3_t	TIR;		///< Tensile Instability stress tensor R
-		double	TI;		///< Tensile instability factor
-		double	TIn;		///< Tensile instability power
 		double 	TIInitDist;	///< Initial distance of particles for calculation of tensile instability
+		double 	Mu;		///< Dynamic viscosity coefficient of the fluid particle (MuRef of the material, updated by the non-Newtonian and LES models)
 
-		double 	Alpha;		///< Dynamic viscosity coefficient of the fluid particle
-		double 	Beta;		///< Dynamic viscosity coefficient of the fluid particle
-		double 	Mu;		///< Dynamic viscosity coefficient of the fluid particle
-		double 	MuRef;		///< Reference Dynamic viscosity coefficient
-		double 	T0;		///< Yield stress for Bingham fluids
-		double 	m;		///< Normalization value for Bingham fluids
-		size_t	VisM;		///< Non-Newtonian viscosity method
-		bool		LES;		///< Large eddy simulation using sub-particle scale
-		double	CSmag;		///< Coefficient of Smagorinsky-Lilly model
-
-		double 	G;		///< Shear modulus
-		double 	K;		///< Bulk modulus
-		double	Sigmay;		///< Tensile yield stress
-		size_t	Fail;		///< Failure criteria
-
-		double	c;		///< Cohesion
-		double	phi;		///< Friction angel
-		double	psi;		///< Dilation angel
 		double	n;		///< Prosity
-		double	n0;		///< Initial Prosity
 		double	k;		///< Permeability
 		double	k2;		///< Second Permeability for the Forchheimer Eq
-		double	d;		///< effective particle size
 		double	V;		///< Volume of a particle
-		double	RhoF;		///< Density of water or any other fluids
-		bool		VarPorosity;	///< If yes, it will calculate porosity and permeability based on new calculated porosity
-		size_t	SeepageType;	///< Selecting variable to choose a Seepage method
 		double	S;		///< Velocity derivative for surface erosion
 
 
 		double 	h;		///< Smoothing length of the particle
-		int    	LL;		///< Linked-List variable to show the next particle in the list of a cell
 		int    	CC[3];		///< Current cell No for the particle (linked-list)
 		int			ct;		///< Correction step for the Modified Verlet Algorithm
 		double	SumKernel;	///< Summation of the kernel value for neighbour particles
 		double	FSISumKernel;	///< Summation of the kernel value for neighbour particles in FSI
 		bool		FirstStep;	///< to initialize the integration scheme
+		size_t	TimeBin;	///< Time bin of the block time stepping, the particle step is deltat/2^TimeBin
+		double	dtLimit;	///< Time step limit from the acceleration of the particle (block time stepping)
+		bool		Active;		///< The particle is integrated at the current sub-step (block time stepping)
+		bool		Sleeping;	///< The particle is at rest, it is not integrated and has no pairs with other sleeping particles
+		size_t	QuietSteps;	///< No of consecutive steps below the sleeping thresholds
+		size_t	Level;		///< Refinement level, No of splits from an initial particle
+		size_t	Family;		///< Split which created the particle (0 => initial particle)
+		size_t	Generation;	///< Unique No given at the construction and by Touch, ParticleData packs the cold state again when it changes (a copy shares it with the same cold state)
 
 		omp_lock_t my_lock;		///< Open MP lock
 
@@ -136,16 +145,20 @@ namespace SPH {
 		Particle						(int Tag, Vec3_t const & x0, Vec3_t const & v0, double Mass0, double Density0, double h0, bool Fixed=false);
 
 		// Methods
-		void Move						(double dt, Vec3_t Domainsize, Vec3_t domainmax, Vec3_t domainmin,size_t Scheme, Mat3_t I);	///< Update the important quantities of a particle
-		void Move_MVerlet		(Mat3_t I, double dt);										///< Update the important quantities of a particle
-		void Move_Leapfrog	(Mat3_t I, double dt);										///< Update the important quantities of a particle
+		void Move						(double dt, Vec3_t Domainsize, Vec3_t domainmax, Vec3_t domainmin,size_t Scheme, Mat3_t I, MaterialProps const & M);	///< Update the important quantities of a particle, M is the material of the particle
+		void Move_MVerlet		(Mat3_t I, double dt, MaterialProps const & M);					///< Update the important quantities of a particle
+		void Move_Leapfrog	(Mat3_t I, double dt, MaterialProps const & M);					///< Update the important quantities of a particle
 		void translate			(double dt, Vec3_t Domainsize, Vec3_t domainmax, Vec3_t domainmin);
-		void Mat1						(double dt);
-		void Mat2MVerlet		(double dt);
-		void Mat3MVerlet		(Mat3_t I, double dt);
-		void Mat2Leapfrog		(double dt);
-		void Mat3Leapfrog		(Mat3_t I, double dt);
-		void ScalebackMat3	(size_t Dimension, size_t Scheme);
+		void Mat1						(double dt, MaterialProps const & M);
+		void Mat2MVerlet		(double dt, MaterialProps const & M);
+		void Mat3MVerlet		(Mat3_t I, double dt, MaterialProps const & M);
+		void Mat2Leapfrog		(double dt, MaterialProps const & M);
+		void Mat3Leapfrog		(Mat3_t I, double dt, MaterialProps const & M);
+		void ScalebackMat3	(size_t Dimension, size_t Scheme, MaterialProps const & M);
+		void AllocateState	(MaterialProps const & M, size_t Scheme);	///< Sets the material type from M and allocates (Material > 1) or frees (fluid) the solid state for the integration scheme, the existing values are kept
+		void Touch				();	///< New generation, must be called after Material, NoSlip, MatID, FPMassC or TIInitDist are changed during a solution (user functions included)
+		void Pack				(Array<double> & Buf) const;	///< Appends the whole state of the particle to Buf (MPI halo and migration)
+		void Unpack			(double const * & Buf);	///< Reads the state written by Pack and advances Buf
 	};
 }; // namespace SPH
 
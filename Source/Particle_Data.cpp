@@ -0,0 +1,193 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#include "Particle_Data.h"
+
+namespace SPH {
+
+	// Cache line aligned array allocation
+	template <typename T> inline T * AlignedNew (size_t N)
+	{
+		void * p = NULL;
+		if (posix_memalign(&p, 64, (N>0 ? N : 1)*sizeof(T)) != 0)
+			throw new Fatal("ParticleData: Could not allocate memory for %zd particles", N);
+		T * t = static_cast<T*>(p);
+		for (size_t i=0; i<N; i++) new (t+i) T;
+		return t;
+	}
+
+	template <typename T> inline void AlignedDelete (T *& p)
+	{
+		free(p);
+		p = NULL;
+	}
+
+	inline ParticleData::ParticleData ()
+	{
+		v = NSv = NULL;
+		a = VXSPH = NULL;
+		h = Mass = Density = Pressure = NULL;
+		Mu = RefDensity = FPMassC = TIInitDist = TIKernel = NULL;
+		MatID = NULL;
+		Mat = NULL;
+		dDensity = ZWab = SumDen = S = NULL;
+		CC = Material = NULL;
+		IsFree = NoSlip = ShepardOn = NULL;
+		StrainRate = NULL;
+		Lock = NULL;
+		Generation = NULL;
+		Stale = true;
+		Size = 0;
+		Capacity = 0;
+	}
+
+	inline ParticleData::~ParticleData ()
+	{
+		Free();
+	}
+
+	inline void ParticleData::Free ()
+	{
+		if (Capacity == 0) return;
+
+		for (size_t i=0; i<Capacity; i++) omp_destroy_lock(&Lock[i]);
+
+		AlignedDelete(v);	AlignedDelete(NSv);
+		AlignedDelete(h);	AlignedDelete(Mass);	AlignedDelete(Density);	AlignedDelete(Pressure);
+		AlignedDelete(CC);	AlignedDelete(Material);
+		AlignedDelete(IsFree);	AlignedDelete(NoSlip);	AlignedDelete(ShepardOn);
+
+		AlignedDelete(MatID);	AlignedDelete(Mu);	AlignedDelete(RefDensity);	AlignedDelete(FPMassC);
+		AlignedDelete(TIInitDist);	AlignedDelete(TIKernel);
+
+		AlignedDelete(a);	AlignedDelete(VXSPH);	AlignedDelete(dDensity);
+		AlignedDelete(ZWab);	AlignedDelete(SumDen);	AlignedDelete(S);	AlignedDelete(StrainRate);
+
+		AlignedDelete(Lock);	AlignedDelete(Generation);
+		Capacity = 0;
+	}
+
+	inline void ParticleData::Resize (size_t N, size_t Nproc)
+	{
+		Size = N;
+		if (N <= Capacity) return;
+
+		// Grow with some margin to absorb inflow particles without reallocating every step
+		size_t NewCap = N + N/4 + 16;
+		Free();
+
+		v	= AlignedNew<Real_t>(3*NewCap);	NSv	= AlignedNew<Real_t>(3*NewCap);
+		h	= AlignedNew<Real_t>(NewCap);	Mass	= AlignedNew<Real_t>(NewCap);
+		Density	= AlignedNew<Real_t>(NewCap);	Pressure= AlignedNew<Real_t>(NewCap);
+		CC	= AlignedNew<int>(3*NewCap);	Material= AlignedNew<int>(NewCap);
+		IsFree	= AlignedNew<bool>(NewCap);	NoSlip	= AlignedNew<bool>(NewCap);	ShepardOn = AlignedNew<bool>(NewCap);
+
+		MatID	= AlignedNew<size_t>(NewCap);	Mu	= AlignedNew<Real_t>(NewCap);
+		RefDensity = AlignedNew<Real_t>(NewCap);	FPMassC	= AlignedNew<Real_t>(NewCap);
+		TIInitDist = AlignedNew<Real_t>(NewCap);	TIKernel = AlignedNew<Real_t>(NewCap);
+
+		a	= AlignedNew<Vec3_t>(NewCap);	VXSPH	= AlignedNew<Vec3_t>(NewCap);
+		dDensity= AlignedNew<double>(NewCap);	ZWab	= AlignedNew<double>(NewCap);
+		SumDen	= AlignedNew<double>(NewCap);	S	= AlignedNew<double>(NewCap);
+		StrainRate = AlignedNew<Sym3_t>(NewCap);
+
+		Generation = AlignedNew<size_t>(NewCap);
+		Stale	= true;
+
+		// The arrays are touched first by the static loops of Pack, also the locks
+		Lock	= AlignedNew<omp_lock_t>(NewCap);
+		#pragma omp parallel for schedule (static) num_threads(Nproc)
+		for (size_t i=0; i<NewCap; i++) omp_init_lock(&Lock[i]);
+
+		Capacity = NewCap;
+	}
+
+	inline void ParticleData::Pack (Array<Particle*> const & Particles, Array<MaterialProps> const & Materials, size_t Nproc)
+	{
+		Resize(Particles.Size(), Nproc);
+		Mat = Materials.GetPtr();
+		bool Cold = Stale;
+
+		#pragma omp parallel for schedule (static) num_threads(Nproc)
+		for (size_t i=0; i<Size; i++)
+		{
+			Particle * P	= Particles[i];
+
+			v[3*i  ]	= P->v(0);
+			v[3*i+1]	= P->v(1);
+			v[3*i+2]	= P->v(2);
+			NSv[3*i  ]	= P->NSv(0);
+			NSv[3*i+1]	= P->NSv(1);
+			NSv[3*i+2]	= P->NSv(2);
+			h[i]		= P->h;
+			Mass[i]		= P->Mass;
+			Density[i]	= P->Density;
+			Pressure[i]	= P->Pressure;
+			CC[3*i  ]	= P->CC[0];
+			CC[3*i+1]	= P->CC[1];
+			CC[3*i+2]	= P->CC[2];
+			IsFree[i]	= P->IsFree;
+			ShepardOn[i]	= P->Shepard && (P->ShepardCounter == P->ShepardStep);
+			Mu[i]		= P->Mu;
+			RefDensity[i]	= P->RefDensity;
+
+			// New, deleted, reordered, migrated or touched particles change the generation at an index
+			if (Cold || Generation[i] != P->Generation)
+			{
+				Material[i]	= P->Material;
+				NoSlip[i]	= P->NoSlip;
+				MatID[i]	= P->MatID;
+				FPMassC[i]	= P->FPMassC;
+				TIInitDist[i]	= P->TIInitDist;
+				Generation[i]	= P->Generation;
+			}
+
+			a[i]		= P->a;
+			VXSPH[i]	= P->VXSPH;
+			dDensity[i]	= P->dDensity;
+			ZWab[i]		= P->ZWab;
+			SumDen[i]	= P->SumDen;
+			S[i]		= P->S;
+			StrainRate[i]	= P->StrainRate;
+		}
+		Stale = false;
+	}
+
+	inline void ParticleData::Unpack (Array<Particle*> & Particles, size_t Nproc)
+	{
+		// Only fluid particles are computed on the packed arrays, the others are left untouched
+		#pragma omp parallel for schedule (static) num_threads(Nproc)
+		for (size_t i=0; i<Size; i++)
+		{
+			if (Material[i] != 1) continue;
+
+			Particle * P	= Particles[i];
+
+			P->a		= a[i];
+			P->VXSPH	= VXSPH[i];
+			P->dDensity	= dDensity[i];
+			P->ZWab		= ZWab[i];
+			P->SumDen	= SumDen[i];
+			P->S		= S[i];
+			P->StrainRate	= StrainRate[i];
+		}
+	}
+
+}; // namespace SPH
@@ -0,0 +1,102 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#ifndef SPH_PARTICLE_DATA_H
+#define SPH_PARTICLE_DATA_H
+
+#include <stdlib.h>   // for posix_memalign
+#include <new>        // for placement new
+
+#include <omp.h>
+
+#include "Particle.h"
+#include "Precision.h"
+
+namespace SPH {
+
+	// Packing cache of the particle fields used by the same material pair loops (structure of arrays).
+	// Domain::Particles stays the master storage of every particle: the hot fields below are copied from it
+	// by Pack at every step and the accumulators of the fluid particles are copied back by Unpack. Move,
+	// StartAcceleration and the mixed material pairs still work on the particles.
+	// The packed state is stored as Real_t (float with USE_MIXED_PRECISION), the accumulators are double.
+	class ParticleData
+	{
+	public:
+		// Hot state (read by every pair)
+		Real_t	* v;		///< Velocity (3 per particle)
+		Real_t	* NSv;		///< Velocity of the fixed particle for no-slip BC (3 per particle)
+		Real_t	* h;		///< Smoothing length
+		Real_t	* Mass;		///< Mass
+		Real_t	* Density;	///< Density
+		Real_t	* Pressure;	///< Pressure
+		int	* CC;		///< Current cell No (3 per particle) for the periodic correction
+		bool	* IsFree;	///< Free or fixed particle
+		bool	* ShepardOn;	///< Shepard filter is applied at this step
+		Real_t	* Mu;		///< Dynamic viscosity (non-Newtonian fluids change it every step)
+		Real_t	* RefDensity;	///< Reference density (changed by the seepage of soil particles)
+
+		// Cold state, only packed again if the generation of the particle at the index changed or after Invalidate.
+		// The generation changes when a particle is created or touched (Particle::Touch), so the functions which
+		// change these fields in place must touch the particle: AllocateState, Refine and the user functions.
+		// The material constants are read from the material table by MatID.
+		int	* Material;	///< Material type
+		bool	* NoSlip;	///< No-Slip BC
+		size_t	* MatID;	///< Index of the material in Mat
+		Real_t	* FPMassC;	///< Mass coefficient for fixed particles
+		Real_t	* TIInitDist;	///< Initial distance of particles for tensile instability
+		Real_t	* TIKernel;	///< Kernel at the initial distance, filled by Domain::PairForces
+		size_t	* Generation;	///< Generation of the particle packed at each index
+		bool	Stale;		///< All of the cold state is packed at the next Pack
+
+		MaterialProps const * Mat;	///< Material table (Domain::Materials) of the packed particles
+
+		// Accumulators (written by the pair loops)
+		Vec3_t	* a;		///< Acceleration
+		Vec3_t	* VXSPH;	///< XSPH velocity correction
+		double	* dDensity;	///< Rate of density change
+		double	* ZWab;		///< Summation of mb/db*Wab (Shepard filter)
+		double	* SumDen;	///< Summation of mb*Wab (Shepard filter)
+		double	* S;		///< Velocity derivative for surface erosion
+		Sym3_t	* StrainRate;	///< Strain rate tensor
+
+		omp_lock_t * Lock;	///< Open MP lock of each particle
+
+		size_t	Size;		///< No of packed particles
+		size_t	Capacity;	///< No of allocated entries, it only grows
+
+		// Constructor & Destructor
+		ParticleData		();
+		~ParticleData		();
+
+		// Methods
+		Vec3_t	Velocity	(size_t i) const { return Vec3_t(v[3*i], v[3*i+1], v[3*i+2]); }		///< Velocity in double
+		Vec3_t	NSVelocity	(size_t i) const { return Vec3_t(NSv[3*i], NSv[3*i+1], NSv[3*i+2]); }	///< No-slip velocity in double
+		MaterialProps const & Props	(size_t i) const { return Mat[MatID[i]]; }				///< Material constants of particle i
+		void Resize		(size_t N, size_t Nproc);			///< Set the size, reallocate only if the capacity is exceeded
+		void Pack		(Array<Particle*> const & Particles, Array<MaterialProps> const & Materials, size_t Nproc);	///< Copy the particles into the arrays
+		void Unpack		(Array<Particle*> & Particles, size_t Nproc);		///< Copy the accumulators of fluid particles back
+		void Invalidate		() { Stale = true; }				///< The cold state of all of the particles is packed at the next Pack (material setup)
+		void Free		();						///< Release the arrays, the next Pack allocates them again
+	};
+}; // namespace SPH
+
+#include "Particle_Data.cpp"
+
+#endif // SPH_PARTICLE_DATA_H
@@ -0,0 +1,37 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#ifndef SPH_PRECISION_H
+#define SPH_PRECISION_H
+
+namespace SPH {
+
+	// Floating point type of the packed particle state (ParticleData) and of the pair geometry cache (PairGeom).
+	// Domain::Particles and the sums of the interaction loops are always double, USE_MIXED_PRECISION stores
+	// the data read by the pair loops in float to halve their memory traffic.
+#ifdef USE_MIXED_PRECISION
+	typedef float	Real_t;
+#else
+	typedef double	Real_t;
+#endif
+
+}; // namespace SPH
+
+#endif // SPH_PRECISION_H
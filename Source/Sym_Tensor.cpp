@@ -0,0 +1,160 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#include "Sym_Tensor.h"
+
+namespace SPH {
+
+	inline Sym3_t::Sym3_t (Mat3_t const & M)
+	{
+		c[0] = M(0,0);
+		c[1] = M(1,1);
+		c[2] = M(2,2);
+		c[3] = 0.5*(M(0,1)+M(1,0));
+		c[4] = 0.5*(M(0,2)+M(2,0));
+		c[5] = 0.5*(M(1,2)+M(2,1));
+	}
+
+	inline Sym3_t & Sym3_t::operator+= (Sym3_t const & B)
+	{
+		for (size_t k=0; k<6; k++) c[k] += B.c[k];
+		return *this;
+	}
+
+	inline Sym3_t & Sym3_t::operator-= (Sym3_t const & B)
+	{
+		for (size_t k=0; k<6; k++) c[k] -= B.c[k];
+		return *this;
+	}
+
+	inline Sym3_t & Sym3_t::operator*= (double a)
+	{
+		for (size_t k=0; k<6; k++) c[k] *= a;
+		return *this;
+	}
+
+	inline Sym3_t operator+ (Sym3_t const & A, Sym3_t const & B)
+	{
+		Sym3_t S;
+		for (size_t k=0; k<6; k++) S.c[k] = A.c[k] + B.c[k];
+		return S;
+	}
+
+	inline Sym3_t operator- (Sym3_t const & A, Sym3_t const & B)
+	{
+		Sym3_t S;
+		for (size_t k=0; k<6; k++) S.c[k] = A.c[k] - B.c[k];
+		return S;
+	}
+
+	inline Sym3_t operator- (Sym3_t const & A)
+	{
+		Sym3_t S;
+		for (size_t k=0; k<6; k++) S.c[k] = -A.c[k];
+		return S;
+	}
+
+	inline Sym3_t operator* (double a, Sym3_t const & A)
+	{
+		Sym3_t S;
+		for (size_t k=0; k<6; k++) S.c[k] = a*A.c[k];
+		return S;
+	}
+
+	inline void set_to_zero (Sym3_t & S)
+	{
+		for (size_t k=0; k<6; k++) S.c[k] = 0.0;
+	}
+
+	inline Sym3_t Iso (double a)
+	{
+		Sym3_t S;
+		S.c[0] = S.c[1] = S.c[2] = a;
+		S.c[3] = S.c[4] = S.c[5] = 0.0;
+		return S;
+	}
+
+	inline Sym3_t SymDyad (Vec3_t const & a, Vec3_t const & b)
+	{
+		Sym3_t S;
+		S.c[0] = 2.0*a(0)*b(0);
+		S.c[1] = 2.0*a(1)*b(1);
+		S.c[2] = 2.0*a(2)*b(2);
+		S.c[3] = a(0)*b(1) + a(1)*b(0);
+		S.c[4] = a(0)*b(2) + a(2)*b(0);
+		S.c[5] = a(1)*b(2) + a(2)*b(1);
+		return S;
+	}
+
+	inline double Trace (Sym3_t const & S)
+	{
+		return S.c[0] + S.c[1] + S.c[2];
+	}
+
+	inline double DoubleDot (Sym3_t const & A, Sym3_t const & B)
+	{
+		return A.c[0]*B.c[0] + A.c[1]*B.c[1] + A.c[2]*B.c[2] + 2.0*(A.c[3]*B.c[3] + A.c[4]*B.c[4] + A.c[5]*B.c[5]);
+	}
+
+	inline Sym3_t Deviator (Sym3_t const & S)
+	{
+		double p = (S.c[0] + S.c[1] + S.c[2])/3.0;
+		Sym3_t D = S;
+		D.c[0] -= p;
+		D.c[1] -= p;
+		D.c[2] -= p;
+		return D;
+	}
+
+	inline double J2Invariant (Sym3_t const & S)
+	{
+		// 0.5*dev(S):dev(S) without forming the deviator
+		double d01 = S.c[0] - S.c[1];
+		double d12 = S.c[1] - S.c[2];
+		double d20 = S.c[2] - S.c[0];
+		return (d01*d01 + d12*d12 + d20*d20)/6.0 + S.c[3]*S.c[3] + S.c[4]*S.c[4] + S.c[5]*S.c[5];
+	}
+
+	inline Sym3_t Jaumann (Sym3_t const & S, Mat3_t const & W)
+	{
+		// S*W^T is the transpose of W*S, so only the 6 components of W*S + (W*S)^T are computed
+		double WS[3][3];
+		for (size_t i=0; i<3; i++)
+		for (size_t j=0; j<3; j++)
+			WS[i][j] = W(i,0)*S(0,j) + W(i,1)*S(1,j) + W(i,2)*S(2,j);
+
+		Sym3_t J;
+		J.c[0] = 2.0*WS[0][0];
+		J.c[1] = 2.0*WS[1][1];
+		J.c[2] = 2.0*WS[2][2];
+		J.c[3] = WS[0][1] + WS[1][0];
+		J.c[4] = WS[0][2] + WS[2][0];
+		J.c[5] = WS[1][2] + WS[2][1];
+		return J;
+	}
+
+	inline void Mult (Vec3_t const & a, Sym3_t const & S, Vec3_t & b)
+	{
+		b(0) = a(0)*S.c[0] + a(1)*S.c[3] + a(2)*S.c[4];
+		b(1) = a(0)*S.c[3] + a(1)*S.c[1] + a(2)*S.c[5];
+		b(2) = a(0)*S.c[4] + a(1)*S.c[5] + a(2)*S.c[2];
+	}
+
+}; // namespace SPH
@@ -0,0 +1,76 @@
+/***********************************************************************************
+* PersianSPH - A C++ library to simulate Mechanical Systems (solids, fluids        *
+*             and soils) using Smoothed Particle Hydrodynamics method              *
+* Copyright (C) 2013 Maziar Gholami Korzani and Sergio Galindo-Torres              *
+*                                                                                  *
+* This file is part of PersianSPH                                                  *
+*                                                                                  *
+* This is free software; you can redistribute it and/or modify it under the        *
+* terms of the GNU General Public License as published by the Free Software        *
+* Foundation; either version 3 of the License, or (at your option) any later       *
+* version.                                                                         *
+*                                                                                  *
+* This program is distributed in the hope that it will be useful, but WITHOUT ANY  *
+* WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A  *
+* PARTICULAR PURPOSE. See the GNU General Public License for more details.         *
+*                                                                                  *
+* You should have received a copy of the GNU General Public License along with     *
+* PersianSPH; if not, see <http://www.gnu.org/licenses/>                           *
+************************************************************************************/
+
+#ifndef SPH_SYM_TENSOR_H
+#define SPH_SYM_TENSOR_H
+
+#include "matvec.h"
+
+namespace SPH {
+
+	// Symmetric 3x3 tensor stored as its 6 independent components, used for the stress, strain and
+	// strain rate fields of the particles. S(i,j) and S(j,i) address the same component.
+	class Sym3_t
+	{
+	public:
+		// Constructors
+		Sym3_t () {}
+		explicit Sym3_t (Mat3_t const & M);	///< Symmetric part of a full matrix
+
+		// Data
+		double	c[6];	///< Components (0,0), (1,1), (2,2), (0,1), (0,2), (1,2)
+
+		// Access
+		double & operator()	(size_t i, size_t j)		{ return c[i==j ? i : 2+i+j]; }
+		double   operator()	(size_t i, size_t j) const	{ return c[i==j ? i : 2+i+j]; }
+
+		// Operators
+		Sym3_t & operator+=	(Sym3_t const & B);
+		Sym3_t & operator-=	(Sym3_t const & B);
+		Sym3_t & operator*=	(double a);
+	};
+
+	// The Mat3_t/Vec3_t overloads of matvec.h are global, keep them visible next to the ones below
+	using ::operator+;
+	using ::operator-;
+	using ::operator*;
+	using ::set_to_zero;
+	using ::Mult;
+
+	Sym3_t operator+	(Sym3_t const & A, Sym3_t const & B);
+	Sym3_t operator-	(Sym3_t const & A, Sym3_t const & B);
+	Sym3_t operator-	(Sym3_t const & A);
+	Sym3_t operator*	(double a, Sym3_t const & A);
+
+	void   set_to_zero	(Sym3_t & S);
+	Sym3_t Iso		(double a);					///< a*I
+	Sym3_t SymDyad		(Vec3_t const & a, Vec3_t const & b);		///< a*b^T + b*a^T
+	double Trace		(Sym3_t const & S);
+	double DoubleDot	(Sym3_t const & A, Sym3_t const & B);		///< A:B
+	Sym3_t Deviator		(Sym3_t const & S);				///< S - tr(S)/3*I
+	double J2Invariant	(Sym3_t const & S);				///< Second invariant of the deviatoric part of S
+	Sym3_t Jaumann		(Sym3_t const & S, Mat3_t const & W);		///< S*W^T + W*S, the rotation terms of the Jaumann rate
+	void   Mult		(Vec3_t const & a, Sym3_t const & S, Vec3_t & b);	///< b = a*S
+
+}; // namespace SPH
+
+#include "Sym_Tensor.cpp"
+
+#endif // SPH_SYM_TENSOR_H